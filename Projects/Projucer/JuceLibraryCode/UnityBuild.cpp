@@ -13,15 +13,27 @@
 #include "../../Source/Core/Audio/BuiltIn/BuiltInSynthPiano.cpp"
 #include "../../Source/Core/Audio/BuiltIn/InternalPluginFormat.cpp"
 #include "../../Source/Core/Audio/Instruments/Instrument.cpp"
+#include "../../Source/Core/Audio/Instruments/MidiPreviewQueue.cpp"
 #include "../../Source/Core/Audio/Instruments/OrchestraPit.cpp"
 #include "../../Source/Core/Audio/Instruments/PluginScanner.cpp"
 #include "../../Source/Core/Audio/Instruments/SerializablePluginDescription.cpp"
+#include "../../Source/Core/Audio/Monitoring/AudioLoadStats.cpp"
 #include "../../Source/Core/Audio/Monitoring/AudioMonitor.cpp"
+#include "../../Source/Core/Audio/Monitoring/LoudnessMeter.cpp"
 #include "../../Source/Core/Audio/Monitoring/SpectrumAnalyzer.cpp"
+#include "../../Source/Core/Audio/Transport/FrozenAudio.cpp"
+#include "../../Source/Core/Audio/Transport/NoteIntervalIndex.cpp"
+#include "../../Source/Core/Audio/Transport/PlaybackCacheBenchmark.cpp"
+#include "../../Source/Core/Audio/Transport/PlaybackTimeline.cpp"
 #include "../../Source/Core/Audio/Transport/PlayerThread.cpp"
+#include "../../Source/Core/Audio/Transport/ProjectSequencesCache.cpp"
 #include "../../Source/Core/Audio/Transport/RendererThread.cpp"
+#include "../../Source/Core/Audio/Transport/TempoMap.cpp"
+#include "../../Source/Core/Audio/Transport/TimelineBenchmark.cpp"
+#include "../../Source/Core/Audio/Transport/TimelineDispatcher.cpp"
 #include "../../Source/Core/Audio/Transport/Transport.cpp"
 #include "../../Source/Core/Audio/AudioCore.cpp"
+#include "../../Source/Core/Audio/AudioMixer.cpp"
 #include "../../Source/Core/Configuration/Models/Arpeggiator.cpp"
 #include "../../Source/Core/Configuration/Models/Chord.cpp"
 #include "../../Source/Core/Configuration/Models/ColourScheme.cpp"
@@ -64,9 +76,12 @@
 #include "../../Source/Core/Network/Services/SessionService.cpp"
 #include "../../Source/Core/Network/Network.cpp"
 #include "../../Source/Core/Serialization/Autosaver.cpp"
+#include "../../Source/Core/Serialization/ChunkedSerializer.cpp"
+#include "../../Source/Core/Serialization/ColumnarSerializer.cpp"
 #include "../../Source/Core/Serialization/Document.cpp"
 #include "../../Source/Core/Serialization/DocumentHelpers.cpp"
 #include "../../Source/Core/Serialization/BinarySerializer.cpp"
+#include "../../Source/Core/Serialization/JsonParserBenchmark.cpp"
 #include "../../Source/Core/Serialization/JsonSerializer.cpp"
 #include "../../Source/Core/Serialization/LegacySerializer.cpp"
 #include "../../Source/Core/Serialization/XmlSerializer.cpp"
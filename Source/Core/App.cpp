@@ -35,6 +35,9 @@
 #include "Workspace.h"
 #include "RootNode.h"
 #include "SerializablePluginDescription.h"
+#include "TimelineBenchmark.h"
+#include "PlaybackCacheBenchmark.h"
+#include "JsonParserBenchmark.h"
 
 //===----------------------------------------------------------------------===//
 // Window
@@ -530,16 +533,31 @@ void App::setTitleBarComponent(WeakReference<Component> component)
 void App::initialise(const String &commandLine)
 {
     this->runMode = App::NORMAL;
-    if (commandLine.isNotEmpty() &&
-        DocumentHelpers::getTempSlot(commandLine).existsAsFile())
+    const auto commandLineArguments = JUCEApplicationBase::getCommandLineParameterArray();
+    if (commandLineArguments.size() == 3 &&
+        commandLineArguments[0] == PluginScanner::checkerArgument)
     {
         this->runMode = App::PLUGIN_CHECK;
     }
+    else if (commandLineArguments.size() == 2 &&
+        (commandLineArguments[0] == TimelineBenchmark::argument ||
+         commandLineArguments[0] == PlaybackCacheBenchmark::argument ||
+         commandLineArguments[0] == JsonParserBenchmark::argument))
+    {
+        this->runMode = App::BENCHMARK;
+    }
 
     if (this->runMode == App::NORMAL)
     {
         DBG("Helio v" + App::getAppReadableVersion());
 
+        const int reportArgumentIndex = commandLineArguments.indexOf(AudioCore::loadReportArgument);
+        if (reportArgumentIndex >= 0 && reportArgumentIndex + 1 < commandLineArguments.size())
+        {
+            this->audioLoadReportFile = File::getCurrentWorkingDirectory()
+                .getChildFile(commandLineArguments[reportArgumentIndex + 1].unquoted());
+        }
+
         const auto album = Desktop::rotatedClockwise + Desktop::rotatedAntiClockwise;
         Desktop::getInstance().setOrientationsEnabled(album);
         
@@ -589,7 +607,13 @@ void App::initialise(const String &commandLine)
     }
     else if (this->runMode == App::PLUGIN_CHECK)
     {
-        this->checkPlugin(commandLine);
+        this->checkPlugin(commandLineArguments[1].unquoted(), File(commandLineArguments[2].unquoted()));
+        this->quit();
+    }
+    else if (this->runMode == App::BENCHMARK)
+    {
+        this->runBenchmark(commandLineArguments[0], File::getCurrentWorkingDirectory()
+            .getChildFile(commandLineArguments[1].unquoted()));
         this->quit();
     }
 }
@@ -606,6 +630,12 @@ void App::shutdown()
 
         this->network = nullptr;
 
+        if (this->audioLoadReportFile != File() && this->workspace->isInitialized())
+        {
+            const auto report = this->workspace->getAudioCore().getLoadReport();
+            this->audioLoadReportFile.replaceWithText(JSON::toString(report));
+        }
+
         this->workspace->shutdown();
         this->workspace = nullptr;
 
@@ -632,6 +662,10 @@ const String App::getApplicationName()
     {
         return "Helio Plugin Check";
     }
+    else if (this->runMode == App::BENCHMARK)
+    {
+        return "Helio Benchmark";
+    }
 
     return "Helio";
 }
@@ -704,49 +738,37 @@ void App::resumed()
 // Private
 //===----------------------------------------------------------------------===//
 
-void App::checkPlugin(const String &markerFile)
+void App::checkPlugin(const String &pluginPath, const File &resultFile)
 {
 #if JUCE_MAC
     Process::setDockIconVisible(false);
 #endif
 
-    const File tempFile(DocumentHelpers::getTempSlot(markerFile));
-
     try
     {
-        if (tempFile.existsAsFile() && tempFile.getSize() < 32768)
-        {
-            const String pluginPath = tempFile.loadFileAsString();
+        KnownPluginList pluginList;
+        OwnedArray<PluginDescription> typesFound;
 
-            // delete the file immediately so that host will know if we crashed
-            tempFile.deleteFile();
+        AudioPluginFormatManager formatManager;
+        AudioCore::initAudioFormats(formatManager);
 
-            KnownPluginList pluginList;
-            OwnedArray<PluginDescription> typesFound;
-
-            AudioPluginFormatManager formatManager;
-            AudioCore::initAudioFormats(formatManager);
-
-            for (int i = 0; i < formatManager.getNumFormats(); ++i)
-            {
-                const auto format = formatManager.getFormat(i);
-                pluginList.scanAndAddFile(pluginPath, false, typesFound, *format);
-            }
-
-            // let host know if we haven't crashed at the moment
-            if (typesFound.size() != 0)
-            {
-                ValueTree typesNode(Serialization::Core::instrumentsList);
+        for (int i = 0; i < formatManager.getNumFormats(); ++i)
+        {
+            const auto format = formatManager.getFormat(i);
+            pluginList.scanAndAddFile(pluginPath, false, typesFound, *format);
+        }
 
-                for (const auto *description : typesFound)
-                {
-                    const SerializablePluginDescription sd(*description);
-                    typesNode.appendChild(sd.serialize(), nullptr);
-                }
+        // let host know if we haven't crashed at the moment,
+        // even if nothing was found, so that the file is checked again later
+        ValueTree typesNode(Serialization::Core::instrumentsList);
 
-                DocumentHelpers::save<XmlSerializer>(tempFile, typesNode);
-            }
+        for (const auto *description : typesFound)
+        {
+            const SerializablePluginDescription sd(*description);
+            typesNode.appendChild(sd.serialize(), nullptr);
         }
+
+        DocumentHelpers::save<XmlSerializer>(resultFile, typesNode);
     }
     catch (...)
     {
@@ -754,6 +776,34 @@ void App::checkPlugin(const String &markerFile)
     }
 }
 
+// Benchmarks run the real code on the synthetic data, and write their reports
+// as JSON, so that the runs on different machines and builds could be compared
+void App::runBenchmark(const String &benchmarkArgument, const File &reportFile)
+{
+#if JUCE_MAC
+    Process::setDockIconVisible(false);
+#endif
+
+    var report;
+    if (benchmarkArgument == TimelineBenchmark::argument)
+    {
+        report = TimelineBenchmark::run();
+    }
+    else if (benchmarkArgument == PlaybackCacheBenchmark::argument)
+    {
+        report = PlaybackCacheBenchmark::run();
+    }
+    else if (benchmarkArgument == JsonParserBenchmark::argument)
+    {
+        report = JsonParserBenchmark::run();
+    }
+
+    if (!reportFile.replaceWithText(JSON::toString(report)))
+    {
+        Logger::writeToLog("Failed to write the benchmark report to " + reportFile.getFullPathName());
+    }
+}
+
 void App::handleAsyncUpdate()
 {
     this->quit();
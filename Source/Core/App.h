@@ -114,16 +114,21 @@ private:
 
 private:
     
-    void checkPlugin(const String &markerFile);
+    void checkPlugin(const String &pluginPath, const File &resultFile);
+    void runBenchmark(const String &benchmarkArgument, const File &reportFile);
     void changeListenerCallback(ChangeBroadcaster *source) override;
 
     enum RunMode
     {
         NORMAL,
-        PLUGIN_CHECK
+        PLUGIN_CHECK,
+        BENCHMARK
     };
 
     App::RunMode runMode;
+
+    // if set on the command line, the audio load report is written there on exit
+    File audioLoadReportFile;
     
     void handleAsyncUpdate() override;
 };
@@ -24,6 +24,10 @@
 #include "Instrument.h"
 #include "SerializationKeys.h"
 #include "AudioMonitor.h"
+#include "TimelineDispatcher.h"
+#include "AudioMixer.h"
+
+const String AudioCore::loadReportArgument = "--audio-load-report";
 
 void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
 {
@@ -34,6 +38,15 @@ void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
 
 AudioCore::AudioCore()
 {
+    // timeline dispatcher should always stay the first device callback,
+    // so that it schedules playback events before instruments process the block
+    this->timelineDispatcher.reset(new TimelineDispatcher());
+    this->deviceManager.addAudioCallback(this->timelineDispatcher.get());
+
+    // all instruments are processed within the mixer's callback
+    this->audioMixer.reset(new AudioMixer());
+    this->deviceManager.addAudioCallback(this->audioMixer.get());
+
     this->audioMonitor.reset(new AudioMonitor());
     this->deviceManager.addAudioCallback(this->audioMonitor.get());
     AudioCore::initAudioFormats(this->formatManager);
@@ -43,54 +56,40 @@ AudioCore::~AudioCore()
 {
     this->deviceManager.removeAudioCallback(this->audioMonitor.get());
     this->audioMonitor = nullptr;
+    this->deviceManager.removeAudioCallback(this->audioMixer.get());
+    this->audioMixer = nullptr;
+    this->deviceManager.removeAudioCallback(this->timelineDispatcher.get());
+    this->timelineDispatcher = nullptr;
     this->deviceManager.closeAudioDevice();
 }
 
 bool AudioCore::canSleepNow() noexcept
 {
-    // SleepTimer is used to disconnect all callbacks after some delay (i.e. sleep mode),
+    // SleepTimer is used to disconnect the audio monitor after some delay (i.e. sleep mode),
     // but first we make sure the device is not making any sound, otherwise we'll wait more:
     return this->deviceManager.getOutputLevelGetter()->getCurrentLevel() == 0.0;
 }
 
+// Instruments are not disconnected here: each of them stops processing
+// its graph by itself, when it's silent, and wakes up right on the next message,
+// so that previewing notes after a while doesn't have to reconnect anything
 void AudioCore::sleepNow()
-{
-    Logger::writeToLog("Audio core sleeps");
-    this->disconnectAllAudioCallbacks();
-}
-
-void AudioCore::awakeNow()
-{
-    this->reconnectAllAudioCallbacks();
-}
-
-void AudioCore::disconnectAllAudioCallbacks()
 {
     if (!this->isMuted.get())
     {
+        Logger::writeToLog("Audio core sleeps");
         this->isMuted = true;
 
         // Audio monitor is especially CPU-hungry, as it does FFT all the time:
         this->deviceManager.removeAudioCallback(this->audioMonitor.get());
-
-        for (auto instrument : this->instruments)
-        {
-            this->removeInstrumentFromDevice(instrument);
-        }
     }
 }
 
-void AudioCore::reconnectAllAudioCallbacks()
+void AudioCore::awakeNow()
 {
     if (this->isMuted.get())
     {
-        for (auto instrument : this->instruments)
-        {
-            this->addInstrumentToDevice(instrument);
-        }
-
         this->deviceManager.addAudioCallback(this->audioMonitor.get());
-
         this->isMuted = false;
     }
 }
@@ -110,6 +109,11 @@ AudioMonitor *AudioCore::getMonitor() const noexcept
     return this->audioMonitor.get();
 }
 
+TimelineDispatcher &AudioCore::getTimelineDispatcher() const noexcept
+{
+    return *this->timelineDispatcher;
+}
+
 //===----------------------------------------------------------------------===//
 // Instruments
 //===----------------------------------------------------------------------===//
@@ -141,13 +145,13 @@ void AudioCore::removeInstrument(Instrument *instrument)
 
 void AudioCore::addInstrumentToDevice(Instrument *instrument)
 {
-    this->deviceManager.addAudioCallback(&instrument->getProcessorPlayer());
+    this->audioMixer->addCallback(&instrument->getProcessorPlayer());
     this->deviceManager.addMidiInputCallback({}, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
 void AudioCore::removeInstrumentFromDevice(Instrument *instrument)
 {
-    this->deviceManager.removeAudioCallback(&instrument->getProcessorPlayer());
+    this->audioMixer->removeCallback(&instrument->getProcessorPlayer());
     this->deviceManager.removeMidiInputCallback({}, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
@@ -200,6 +204,71 @@ void AudioCore::initDefaultInstrument()
     this->addInstrument(desc, "Helio Piano", [](Instrument *) {});
 }
 
+float AudioCore::getInstrumentCpuLoad(Instrument *instrument) const
+{
+    return this->audioMixer->getCpuLoad(&instrument->getProcessorPlayer());
+}
+
+float AudioCore::getInstrumentPeak(Instrument *instrument) const
+{
+    return this->audioMixer->getPeak(&instrument->getProcessorPlayer());
+}
+
+float AudioCore::getInstrumentRootMeanSquare(Instrument *instrument) const
+{
+    return this->audioMixer->getRootMeanSquare(&instrument->getProcessorPlayer());
+}
+
+//===----------------------------------------------------------------------===//
+// Load statistics
+//===----------------------------------------------------------------------===//
+
+AudioLoadStats::Summary AudioCore::getLoadSummary() const
+{
+    return this->audioMixer->getLoadSummary();
+}
+
+int AudioCore::getNumXRuns() const
+{
+    const auto *device = this->deviceManager.getCurrentAudioDevice();
+    return device != nullptr ? device->getXRunCount() : -1;
+}
+
+var AudioCore::getLoadReport() const
+{
+    using namespace Serialization::Audio;
+
+    DynamicObject::Ptr device(new DynamicObject());
+    if (const auto *currentDevice = this->deviceManager.getCurrentAudioDevice())
+    {
+        device->setProperty(audioDeviceType, currentDevice->getTypeName());
+        device->setProperty(audioOutputDeviceName, currentDevice->getName());
+        device->setProperty(audioDeviceRate, currentDevice->getCurrentSampleRate());
+        device->setProperty(audioDeviceBufferSize, currentDevice->getCurrentBufferSizeSamples());
+    }
+
+    device->setProperty(loadDeviceXRuns, this->getNumXRuns());
+    device->setProperty(loadDeviceCpuUsage, this->deviceManager.getCpuUsage());
+    device->setProperty(loadBlockDurationMs, this->audioMixer->getBlockDurationMs());
+
+    Array<var> instrumentsLoad;
+    for (auto *instrument : this->instruments)
+    {
+        const auto summary = this->audioMixer->getLoadSummary(&instrument->getProcessorPlayer());
+        var instrumentLoad(summary.toVar());
+        instrumentLoad.getDynamicObject()->setProperty(instrumentId, instrument->getIdAndHash());
+        instrumentLoad.getDynamicObject()->setProperty(instrumentName, instrument->getName());
+        instrumentsLoad.add(instrumentLoad);
+    }
+
+    DynamicObject::Ptr report(new DynamicObject());
+    report->setProperty(loadDevice, var(device.get()));
+    report->setProperty(loadMixer, this->audioMixer->getLoadSummary().toVar());
+    report->setProperty(loadMonitor, this->audioMonitor->getLoadSummary().toVar());
+    report->setProperty(loadInstruments, instrumentsLoad);
+    return var(report.get());
+}
+
 //===----------------------------------------------------------------------===//
 // Setup
 //===----------------------------------------------------------------------===//
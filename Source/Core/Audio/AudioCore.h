@@ -18,9 +18,12 @@
 #pragma once
 
 class AudioMonitor;
+class AudioMixer;
+class TimelineDispatcher;
 
 #include "Instrument.h"
 #include "OrchestraPit.h"
+#include "AudioLoadStats.h"
 
 class SleepTimer : private Timer
 {
@@ -78,6 +81,10 @@ public:
 
     static void initAudioFormats(AudioPluginFormatManager &formatManager);
 
+    // The app, started with this argument followed by a file path,
+    // writes the audio load report there as json on exit
+    static const String loadReportArgument;
+
     AudioCore();
     ~AudioCore() override;
     
@@ -97,6 +104,27 @@ public:
     Instrument *findInstrumentById(const String &id) const override;
     void initDefaultInstrument();
 
+    // the share of the audio block duration spent processing the instrument
+    float getInstrumentCpuLoad(Instrument *instrument) const;
+
+    // the instrument's output levels in the last audio block, across all channels
+    float getInstrumentPeak(Instrument *instrument) const;
+    float getInstrumentRootMeanSquare(Instrument *instrument) const;
+
+    //===------------------------------------------------------------------===//
+    // Load statistics
+    //===------------------------------------------------------------------===//
+
+    // how long all instruments take to process the device's blocks
+    AudioLoadStats::Summary getLoadSummary() const;
+
+    // the device's buffer under- and overruns, or -1 if it doesn't report them
+    int getNumXRuns() const;
+
+    // all of the above, along with each instrument's and the monitor's statistics,
+    // as a json-friendly object; collected since the device has started
+    var getLoadReport() const;
+
     //===------------------------------------------------------------------===//
     // Setup
     //===------------------------------------------------------------------===//
@@ -106,6 +134,7 @@ public:
     AudioDeviceManager &getDevice() noexcept;
     AudioPluginFormatManager &getFormatManager() noexcept;
     AudioMonitor *getMonitor() const noexcept;
+    TimelineDispatcher &getTimelineDispatcher() const noexcept;
 
     //===------------------------------------------------------------------===//
     // Serializable
@@ -135,6 +164,35 @@ public:
         return fastLog2(val) / fastLog2(10.f);
     }
 
+    inline static float getPeak(const float *data, int numSamples) noexcept
+    {
+        const auto range = FloatVectorOperations::findMinAndMax(data, numSamples);
+        return jmax(-range.getStart(), range.getEnd());
+    }
+
+    inline static float getRootMeanSquare(const float *data, int numSamples) noexcept
+    {
+        // independent accumulators, so that the compiler could vectorize the loop
+        float sums[4] = { 0.f, 0.f, 0.f, 0.f };
+
+        int i = 0;
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            sums[0] += data[i] * data[i];
+            sums[1] += data[i + 1] * data[i + 1];
+            sums[2] += data[i + 2] * data[i + 2];
+            sums[3] += data[i + 3] * data[i + 3];
+        }
+
+        float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+        for (; i < numSamples; ++i)
+        {
+            sum += data[i] * data[i];
+        }
+
+        return numSamples > 0 ? sqrtf(sum / numSamples) : 0.f;
+    }
+
     inline static float iecLevel(float dB)
     {
         float fDef = 1.f;
@@ -163,8 +221,6 @@ private:
     bool canSleepNow() noexcept override;
     void sleepNow() override;
     void awakeNow() override;
-    void disconnectAllAudioCallbacks();
-    void reconnectAllAudioCallbacks();
 
     void addInstrumentToDevice(Instrument *instrument);
     void removeInstrumentFromDevice(Instrument *instrument);
@@ -174,6 +230,8 @@ private:
 
     OwnedArray<Instrument> instruments;
     UniquePointer<AudioMonitor> audioMonitor;
+    UniquePointer<TimelineDispatcher> timelineDispatcher;
+    UniquePointer<AudioMixer> audioMixer;
 
     AudioPluginFormatManager formatManager;
     AudioDeviceManager deviceManager;
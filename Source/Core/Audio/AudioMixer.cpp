@@ -0,0 +1,416 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "AudioMixer.h"
+#include "AudioCore.h"
+
+// The number of realtime workers, not counting the audio thread itself
+#define AUDIO_MIXER_MAX_WORKERS 7
+
+// The dispatch state packs the number of jobs in the current block
+// and the index of the next job to be taken into a single atomic int
+#define AUDIO_MIXER_JOB_BITS 16
+#define AUDIO_MIXER_JOB_MASK ((1 << AUDIO_MIXER_JOB_BITS) - 1)
+
+#define AUDIO_MIXER_CPU_LOAD_SMOOTHING 0.9f
+
+// The audio thread spins this many times waiting for the workers to finish their jobs,
+// which is usually enough, and then sleeps until the last one wakes it up
+#define AUDIO_MIXER_BARRIER_SPINS 2048
+#define AUDIO_MIXER_BARRIER_WAIT_MS 1
+
+class AudioMixer::Worker final : public Thread
+{
+public:
+
+    explicit Worker(AudioMixer &mixer) :
+        Thread("AudioMixer"), mixer(mixer) {}
+
+    ~Worker() override
+    {
+        this->signalThreadShouldExit();
+        this->wakeUp.signal();
+        this->stopThread(1000);
+    }
+
+    void notify() noexcept
+    {
+        this->wakeUp.signal();
+    }
+
+private:
+
+    void run() override
+    {
+        while (!this->threadShouldExit())
+        {
+            this->wakeUp.wait();
+
+            if (this->threadShouldExit())
+            {
+                return;
+            }
+
+            this->mixer.processJobs();
+        }
+    }
+
+    AudioMixer &mixer;
+    WaitableEvent wakeUp;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+AudioMixer::AudioMixer()
+{
+    const int numWorkers = jlimit(0, AUDIO_MIXER_MAX_WORKERS, SystemStats::getNumCpus() - 1);
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto *worker = this->workers.add(new Worker(*this));
+        worker->startThread(10);
+    }
+}
+
+AudioMixer::~AudioMixer()
+{
+    this->workers.clear();
+}
+
+void AudioMixer::addCallback(Instrument::AudioCallback *callback)
+{
+    jassert(callback != nullptr);
+
+    const ScopedLock dl(this->deviceLock);
+
+    {
+        const ScopedLock sl(this->lock);
+        for (const auto *job : this->jobs)
+        {
+            if (job->callback == callback)
+            {
+                return;
+            }
+        }
+    }
+
+    UniquePointer<Job> job(new Job());
+    job->callback = callback;
+    job->meters = new Meters();
+    job->meters->callback = callback;
+
+    {
+        const SpinLock::ScopedLockType ml(this->metersLock);
+        this->meters.add(job->meters);
+    }
+
+    if (this->device != nullptr)
+    {
+        callback->audioDeviceAboutToStart(this->device);
+    }
+
+    this->prepareJob(*job);
+
+    const ScopedLock sl(this->lock);
+    this->jobs.add(job.release());
+}
+
+void AudioMixer::removeCallback(Instrument::AudioCallback *callback)
+{
+    {
+        const SpinLock::ScopedLockType ml(this->metersLock);
+        for (int i = 0; i < this->meters.size(); ++i)
+        {
+            if (this->meters.getUnchecked(i)->callback == callback)
+            {
+                this->meters.remove(i);
+                break;
+            }
+        }
+    }
+
+    const ScopedLock dl(this->deviceLock);
+    UniquePointer<Job> removedJob;
+
+    {
+        const ScopedLock sl(this->lock);
+        for (int i = 0; i < this->jobs.size(); ++i)
+        {
+            if (this->jobs.getUnchecked(i)->callback == callback)
+            {
+                removedJob.reset(this->jobs.removeAndReturn(i));
+                break;
+            }
+        }
+    }
+
+    if (removedJob != nullptr && this->device != nullptr)
+    {
+        callback->audioDeviceStopped();
+    }
+}
+
+float AudioMixer::getCpuLoad(const Instrument::AudioCallback *callback) const
+{
+    const auto jobMeters = this->findMeters(callback);
+    return jobMeters != nullptr ? jobMeters->cpuLoad.get() : 0.f;
+}
+
+float AudioMixer::getPeak(const Instrument::AudioCallback *callback) const
+{
+    const auto jobMeters = this->findMeters(callback);
+    return jobMeters != nullptr ? jobMeters->peak.get() : 0.f;
+}
+
+float AudioMixer::getRootMeanSquare(const Instrument::AudioCallback *callback) const
+{
+    const auto jobMeters = this->findMeters(callback);
+    return jobMeters != nullptr ? jobMeters->rms.get() : 0.f;
+}
+
+AudioLoadStats::Summary AudioMixer::getLoadSummary(const Instrument::AudioCallback *callback) const
+{
+    const auto jobMeters = this->findMeters(callback);
+    return jobMeters != nullptr ? jobMeters->loadStats.getSummary() : AudioLoadStats::Summary();
+}
+
+AudioLoadStats::Summary AudioMixer::getLoadSummary() const
+{
+    return this->loadStats.getSummary();
+}
+
+double AudioMixer::getBlockDurationMs() const noexcept
+{
+    return this->blockDurationMs.get();
+}
+
+//===----------------------------------------------------------------------===//
+// AudioIODeviceCallback
+//===----------------------------------------------------------------------===//
+
+void AudioMixer::audioDeviceIOCallback(const float **inputChannelData,
+    int numInputChannels, float **outputChannelData,
+    int numOutputChannels, int numSamples)
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+    const ScopedLock sl(this->lock);
+
+    this->numJobs = jmin(this->jobs.size(), int(AUDIO_MIXER_JOB_MASK));
+    if (this->numJobs == 0)
+    {
+        for (int i = 0; i < numOutputChannels; ++i)
+        {
+            FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < this->numJobs; ++i)
+    {
+        // won't reallocate unless the device gives more samples than it has promised
+        this->jobs.getUnchecked(i)->outputBuffer.setSize(numOutputChannels, numSamples, false, false, true);
+    }
+
+    this->inputChannelData = inputChannelData;
+    this->numInputChannels = numInputChannels;
+    this->numOutputChannels = numOutputChannels;
+    this->numSamples = numSamples;
+    this->blockDurationTicks = double(numSamples) / jmax(1.0, this->sampleRate) *
+        double(Time::getHighResolutionTicksPerSecond());
+    this->blockDurationMs = double(numSamples) * 1000.0 / jmax(1.0, this->sampleRate);
+
+    // publish the new block to the workers
+    this->jobsDone.reset();
+    this->numJobsDone = 0;
+    this->dispatchState = this->numJobs << AUDIO_MIXER_JOB_BITS;
+
+    // sleeping instruments take no time, so there's no need to wake the workers for them
+    int numAwakeJobs = 0;
+    for (int i = 0; i < this->numJobs; ++i)
+    {
+        numAwakeJobs += this->jobs.getUnchecked(i)->isSleeping ? 0 : 1;
+    }
+
+    const int numWorkersToWake = jmin(this->workers.size(), numAwakeJobs - 1);
+    for (int i = 0; i < numWorkersToWake; ++i)
+    {
+        this->workers.getUnchecked(i)->notify();
+    }
+
+    // the audio thread takes the jobs as well, and then waits for the others to finish
+    this->processJobs();
+
+    // the remaining jobs are in progress on the workers, so this won't spin for long,
+    // and if some plugin is that slow, the audio thread lets the others have the core;
+    // a late signal from the previous block only makes it check the counter once again
+    for (int i = 0; this->numJobsDone.get() < this->numJobs; ++i)
+    {
+        if (i >= AUDIO_MIXER_BARRIER_SPINS)
+        {
+            this->jobsDone.wait(AUDIO_MIXER_BARRIER_WAIT_MS);
+        }
+    }
+
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        float *output = outputChannelData[i];
+        FloatVectorOperations::clear(output, numSamples);
+
+        for (int j = 0; j < this->numJobs; ++j)
+        {
+            const auto *job = this->jobs.getUnchecked(j);
+            if (job->hasOutput)
+            {
+                FloatVectorOperations::add(output, job->outputBuffer.getReadPointer(i), numSamples);
+            }
+        }
+    }
+
+    this->loadStats.addBlock(double(Time::getHighResolutionTicks() - startTicks),
+        this->blockDurationTicks);
+}
+
+// the device is not running here, so the callback lock is not contended
+void AudioMixer::audioDeviceAboutToStart(AudioIODevice *newDevice)
+{
+    const ScopedLock dl(this->deviceLock);
+    const ScopedLock sl(this->lock);
+
+    this->device = newDevice;
+    this->sampleRate = newDevice->getCurrentSampleRate();
+    this->maxBlockSize = newDevice->getCurrentBufferSizeSamples();
+    this->maxNumOutputChannels = newDevice->getActiveOutputChannels().countNumberOfSetBits();
+
+    for (auto *job : this->jobs)
+    {
+        job->callback->audioDeviceAboutToStart(newDevice);
+        this->prepareJob(*job);
+    }
+
+    this->loadStats.reset();
+}
+
+void AudioMixer::audioDeviceStopped()
+{
+    const ScopedLock dl(this->deviceLock);
+    const ScopedLock sl(this->lock);
+
+    for (auto *job : this->jobs)
+    {
+        job->callback->audioDeviceStopped();
+        job->meters->cpuLoad = 0.f;
+        job->meters->peak = 0.f;
+        job->meters->rms = 0.f;
+    }
+
+    this->device = nullptr;
+}
+
+//===----------------------------------------------------------------------===//
+// Jobs
+//===----------------------------------------------------------------------===//
+
+// Called from the audio thread and the workers at the same time:
+// each job is taken with a compare-and-swap on the dispatch state,
+// so a worker that wakes up late, when the block is done,
+// will just see that there's nothing left to take
+void AudioMixer::processJobs() noexcept
+{
+    for (;;)
+    {
+        const int state = this->dispatchState.get();
+        const int jobIndex = state & AUDIO_MIXER_JOB_MASK;
+        const int numJobsInBlock = state >> AUDIO_MIXER_JOB_BITS;
+
+        if (jobIndex >= numJobsInBlock)
+        {
+            return;
+        }
+
+        if (this->dispatchState.compareAndSetBool(state + 1, state))
+        {
+            this->processJob(*this->jobs.getUnchecked(jobIndex));
+
+            if (++this->numJobsDone == numJobsInBlock)
+            {
+                this->jobsDone.signal();
+            }
+        }
+    }
+}
+
+void AudioMixer::processJob(Job &job) noexcept
+{
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    job.callback->audioDeviceIOCallback(this->inputChannelData, this->numInputChannels,
+        job.outputBuffer.getArrayOfWritePointers(), this->numOutputChannels, this->numSamples);
+
+    auto &meters = *job.meters;
+    const double elapsedTicks = double(Time::getHighResolutionTicks() - startTicks);
+    meters.loadStats.addBlock(elapsedTicks, this->blockDurationTicks,
+        job.callback->getNumQueuedMessages());
+
+    const float load = float(elapsedTicks / this->blockDurationTicks);
+    meters.cpuLoad = meters.cpuLoad.get() * AUDIO_MIXER_CPU_LOAD_SMOOTHING +
+        load * (1.f - AUDIO_MIXER_CPU_LOAD_SMOOTHING);
+
+    // metering is cheap enough to be done here, while the output is still in cache,
+    // and in parallel with the other instruments, not delaying the device callback
+    float peak = 0.f;
+    float rms = 0.f;
+    job.isSleeping = job.callback->isSleeping();
+    job.hasOutput = !job.isSleeping || job.callback->hasMixedFrozenAudio();
+
+    if (job.hasOutput)
+    {
+        for (int i = 0; i < this->numOutputChannels; ++i)
+        {
+            const float *output = job.outputBuffer.getReadPointer(i);
+            peak = jmax(peak, AudioCore::getPeak(output, this->numSamples));
+            rms = jmax(rms, AudioCore::getRootMeanSquare(output, this->numSamples));
+        }
+    }
+
+    meters.peak = peak;
+    meters.rms = rms;
+}
+
+void AudioMixer::prepareJob(Job &job)
+{
+    job.outputBuffer.setSize(jmax(1, this->maxNumOutputChannels), jmax(1, this->maxBlockSize));
+    job.meters->loadStats.reset();
+}
+
+// The meters are looked up under their own lock, and the summary is then
+// collected outside of it, so the reader never blocks the audio thread,
+// and the meters of a removed instrument are kept alive until the reader is done
+AudioMixer::Meters::Ptr AudioMixer::findMeters(const Instrument::AudioCallback *callback) const
+{
+    const SpinLock::ScopedLockType ml(this->metersLock);
+
+    for (auto *jobMeters : this->meters)
+    {
+        if (jobMeters->callback == callback)
+        {
+            return jobMeters;
+        }
+    }
+
+    return nullptr;
+}
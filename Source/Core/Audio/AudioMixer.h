@@ -0,0 +1,131 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Instrument.h"
+#include "AudioLoadStats.h"
+
+// Processes all instruments within a single device callback: AudioDeviceManager
+// would call each instrument's callback in turn on the one audio thread,
+// but here the instruments are split between the audio thread and a set of
+// realtime workers, which grab them one by one from a shared lock-free counter;
+// when all of them are done, their outputs are summed into the device buffers.
+
+class AudioMixer final : public AudioIODeviceCallback
+{
+public:
+
+    AudioMixer();
+    ~AudioMixer() override;
+
+    void addCallback(Instrument::AudioCallback *callback);
+    void removeCallback(Instrument::AudioCallback *callback);
+
+    // The ratio of the instrument's processing time to the block duration,
+    // smoothed over the recent blocks; may be called from any thread,
+    // and, like the other meters, never waits for the audio callback
+    float getCpuLoad(const Instrument::AudioCallback *callback) const;
+
+    // The instrument's output levels in the last block, measured by the thread
+    // that has processed it, and taken across all channels; may be called from any thread
+    float getPeak(const Instrument::AudioCallback *callback) const;
+    float getRootMeanSquare(const Instrument::AudioCallback *callback) const;
+
+    // The instrument's processing time histogram and MIDI queue depths,
+    // and the same for the whole mixer callback, i.e. all instruments together;
+    // collected since the device has started, may be called from any thread
+    AudioLoadStats::Summary getLoadSummary(const Instrument::AudioCallback *callback) const;
+    AudioLoadStats::Summary getLoadSummary() const;
+    double getBlockDurationMs() const noexcept;
+
+    //===------------------------------------------------------------------===//
+    // AudioIODeviceCallback
+    //===------------------------------------------------------------------===//
+
+    void audioDeviceIOCallback(const float **inputChannelData, int numInputChannels,
+        float **outputChannelData, int numOutputChannels, int numSamples) override;
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+    void audioDeviceStopped() override;
+
+private:
+
+    // Written by the thread processing the job, and read by the UI
+    // under the meters lock, which the audio thread never takes
+    struct Meters final : public ReferenceCountedObject
+    {
+        using Ptr = ReferenceCountedObjectPtr<Meters>;
+
+        const Instrument::AudioCallback *callback = nullptr;
+        Atomic<float> cpuLoad = 0.f;
+        Atomic<float> peak = 0.f;
+        Atomic<float> rms = 0.f;
+        AudioLoadStats loadStats;
+    };
+
+    struct Job final
+    {
+        Instrument::AudioCallback *callback = nullptr;
+        AudioBuffer<float> outputBuffer;
+        Meters::Ptr meters;
+
+        // set by the thread processing the job, read by the audio thread after the barrier:
+        // sleeping instruments only have the frozen audio in their output, if any
+        bool isSleeping = false;
+        bool hasOutput = true;
+    };
+
+    class Worker;
+
+    void processJobs() noexcept;
+    void processJob(Job &job) noexcept;
+    void prepareJob(Job &job);
+    Meters::Ptr findMeters(const Instrument::AudioCallback *callback) const;
+
+    // the callback lock is only held for adding and removing the prepared jobs,
+    // while the device lock keeps the device settings from changing meanwhile,
+    // so that the audio thread never waits for the plugins to be prepared
+    CriticalSection lock;
+    CriticalSection deviceLock;
+    OwnedArray<Job> jobs;
+    OwnedArray<Worker> workers;
+
+    SpinLock metersLock;
+    ReferenceCountedArray<Meters> meters;
+
+    // the current block's parameters, published to the workers before they're woken up
+    const float **inputChannelData = nullptr;
+    int numInputChannels = 0;
+    int numOutputChannels = 0;
+    int numSamples = 0;
+    double blockDurationTicks = 0.0;
+    Atomic<double> blockDurationMs = 0.0;
+    AudioLoadStats loadStats;
+
+    // job dispatch and the barrier
+    Atomic<int> dispatchState = 0;
+    Atomic<int> numJobsDone = 0;
+    int numJobs = 0;
+    WaitableEvent jobsDone;
+
+    AudioIODevice *device = nullptr;
+    double sampleRate = 0.0;
+    int maxNumOutputChannels = 0;
+    int maxBlockSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioMixer)
+};
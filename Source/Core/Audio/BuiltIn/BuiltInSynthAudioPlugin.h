@@ -19,6 +19,20 @@
 
 #define BUILTIN_SYNTH_NUM_VOICES 32
 
+// Lets the plugins replace all the sounds at once, e.g. the ones loaded in background,
+// instead of adding them one by one and contending with the audio thread for the lock
+class BuiltInSynthesiser final : public Synthesiser
+{
+public:
+
+    // doesn't allocate or free anything, only to be called from the audio thread
+    void swapSoundsWith(ReferenceCountedArray<SynthesiserSound> &otherSounds) noexcept
+    {
+        const ScopedLock sl(this->lock);
+        this->sounds.swapWith(otherSounds);
+    }
+};
+
 class BuiltInSynthAudioPlugin : public AudioPluginInstance
 {
 public:
@@ -71,6 +85,6 @@ protected:
     virtual void initVoices() = 0;
     virtual void initSampler() = 0;
 
-    Synthesiser synth;
+    BuiltInSynthesiser synth;
 
 };
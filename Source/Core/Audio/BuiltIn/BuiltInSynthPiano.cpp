@@ -22,6 +22,7 @@
 #define ATTACK_TIME (0.0)
 #define RELEASE_TIME (0.5)
 #define MAX_PLAY_TIME (4.5)
+#define PIANO_SAMPLES_WAIT_TIMEOUT_MS 5000
 
 struct PianoSample final
 {
@@ -59,9 +60,129 @@ struct PianoSample final
     JUCE_LEAK_DETECTOR(PianoSample)
 };
 
+// Decoded samples are shared by all piano instances, they are decoded
+// on a background thread as soon as any piano is prepared to play,
+// and each instance adds them to its synth once they are ready
+class PianoSamplesPool final : public ChangeBroadcaster, private Thread
+{
+public:
+
+    PianoSamplesPool() : Thread("PianoSamplesLoader") {}
+
+    ~PianoSamplesPool() override
+    {
+        this->stopThread(5000);
+    }
+
+    void preload()
+    {
+        const SpinLock::ScopedLockType sl(this->loaderLock);
+        if (!this->hasStartedLoading)
+        {
+            this->hasStartedLoading = true;
+            this->startThread(3);
+        }
+    }
+
+    bool isLoaded() const noexcept
+    {
+        return this->loaded.get();
+    }
+
+    bool waitUntilLoaded(int timeoutMs) const
+    {
+        return this->isLoaded() || this->loadedEvent.wait(timeoutMs);
+    }
+
+    // only valid to be called after isLoaded() returns true
+    const ReferenceCountedArray<SynthesiserSound> &getSounds() const noexcept
+    {
+        jassert(this->isLoaded());
+        return this->sounds;
+    }
+
+private:
+
+    void run() override
+    {
+        Array<PianoSample> samples;
+
+        samples.add({ 26, 39, 36, BinaryData::C2v9_flac, BinaryData::C2v9_flacSize });
+        samples.add({ 40, 45, 42, BinaryData::F2v9_flac, BinaryData::F2v9_flacSize });
+
+        samples.add({ 46, 51, 48, BinaryData::C3v9_flac, BinaryData::C3v9_flacSize });
+        samples.add({ 52, 57, 54, BinaryData::F3v9_flac, BinaryData::F3v9_flacSize });
+
+        samples.add({ 58, 63, 60, BinaryData::C4v9_flac, BinaryData::C4v9_flacSize });
+        samples.add({ 64, 69, 66, BinaryData::F4v9_flac, BinaryData::F4v9_flacSize });
+
+        samples.add({ 70, 75, 72, BinaryData::C5v9_flac, BinaryData::C5v9_flacSize });
+        samples.add({ 76, 81, 78, BinaryData::F5v9_flac, BinaryData::F5v9_flacSize });
+
+        samples.add({ 82, 87, 84, BinaryData::C6v9_flac, BinaryData::C6v9_flacSize });
+        samples.add({ 88, 100, 90, BinaryData::F6v9_flac, BinaryData::F6v9_flacSize });
+
+        // each sample is decoded in its own job, the slots are filled in parallel
+        Array<SynthesiserSound::Ptr> decoded;
+        decoded.resize(samples.size());
+
+        {
+            ThreadPool decoders(jlimit(1, samples.size(), SystemStats::getNumCpus()));
+
+            for (int i = 0; i < samples.size(); ++i)
+            {
+                decoders.addJob([&samples, &decoded, i]()
+                {
+                    auto &s = samples.getReference(i);
+                    UniquePointer<AudioFormatReader> reader(s.createReader());
+                    decoded.getReference(i) = new SamplerSound({}, *reader,
+                        s.midiNotes, s.midiNoteForNormalPitch,
+                        ATTACK_TIME, RELEASE_TIME, MAX_PLAY_TIME);
+                });
+            }
+
+            while (decoders.getNumJobs() > 0)
+            {
+                if (this->threadShouldExit())
+                {
+                    decoders.removeAllJobs(true, 5000);
+                    return;
+                }
+
+                this->wait(5);
+            }
+        }
+
+        for (const auto &sound : decoded)
+        {
+            this->sounds.add(sound);
+        }
+
+        this->loaded = true;
+        this->loadedEvent.signal();
+        this->sendChangeMessage();
+    }
+
+    ReferenceCountedArray<SynthesiserSound> sounds;
+    Atomic<bool> loaded = false;
+    WaitableEvent loadedEvent { true };
+
+    SpinLock loaderLock;
+    bool hasStartedLoading = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PianoSamplesPool)
+};
+
 BuiltInSynthPiano::BuiltInSynthPiano()
 {
     this->setPlayConfigDetails(0, 2, this->getSampleRate(), this->getBlockSize());
+    this->initVoices();
+    this->samplesPool->addChangeListener(this);
+}
+
+BuiltInSynthPiano::~BuiltInSynthPiano()
+{
+    this->samplesPool->removeChangeListener(this);
 }
 
 const String BuiltInSynthPiano::getName() const
@@ -79,49 +200,68 @@ void BuiltInSynthPiano::initVoices()
 
 void BuiltInSynthPiano::processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages)
 {
-    if (this->synth.getNumSounds() == 0 && midiMessages.getNumEvents() > 0)
+    if (this->soundsState.get() == pendingSounds)
     {
-        // Initialization takes about 400ms (i.e. slows app loading way down),
-        // and consumes a lot of RAM (though user might never use the built-in piano).
-        // So let's do a lazy initialization on first use - i.e. here in processBlock
-        this->initVoices();
-        this->initSampler();
+        this->synth.swapSoundsWith(this->pendingSoundsSet);
+        this->soundsState = hasSounds;
     }
-    
+
     BuiltInSynthAudioPlugin::processBlock(buffer, midiMessages);
 }
 
-void BuiltInSynthPiano::reset()
+void BuiltInSynthPiano::prepareToPlay(double sampleRate, int estimatedSamplesPerBlock)
 {
-    this->synth.allNotesOff(0, true);
+    BuiltInSynthAudioPlugin::prepareToPlay(sampleRate, estimatedSamplesPerBlock);
+
+    // Decoding takes about 400ms and consumes a lot of RAM, and user might never
+    // use the built-in piano, so the samples are loaded, once for all instances,
+    // only when some piano is going to play, and never on the audio thread
+    if (this->samplesPool->isLoaded())
+    {
+        this->initSampler();
+    }
+    else
+    {
+        this->samplesPool->preload();
+    }
 }
 
-void BuiltInSynthPiano::initSampler()
+// the renderer doesn't start until the samples are there,
+// otherwise the beginning of the render would be silent
+void BuiltInSynthPiano::setNonRealtime(bool isNonRealtime) noexcept
 {
-    this->synth.clearSounds();
-
-    Array<PianoSample> samples;
+    BuiltInSynthAudioPlugin::setNonRealtime(isNonRealtime);
 
-    samples.add({ 26, 39, 36, BinaryData::C2v9_flac, BinaryData::C2v9_flacSize });
-    samples.add({ 40, 45, 42, BinaryData::F2v9_flac, BinaryData::F2v9_flacSize });
-
-    samples.add({ 46, 51, 48, BinaryData::C3v9_flac, BinaryData::C3v9_flacSize });
-    samples.add({ 52, 57, 54, BinaryData::F3v9_flac, BinaryData::F3v9_flacSize });
-
-    samples.add({ 58, 63, 60, BinaryData::C4v9_flac, BinaryData::C4v9_flacSize });
-    samples.add({ 64, 69, 66, BinaryData::F4v9_flac, BinaryData::F4v9_flacSize });
-
-    samples.add({ 70, 75, 72, BinaryData::C5v9_flac, BinaryData::C5v9_flacSize });
-    samples.add({ 76, 81, 78, BinaryData::F5v9_flac, BinaryData::F5v9_flacSize });
+    if (isNonRealtime)
+    {
+        this->samplesPool->preload();
+        this->samplesPool->waitUntilLoaded(PIANO_SAMPLES_WAIT_TIMEOUT_MS);
+        this->initSampler();
+    }
+}
 
-    samples.add({ 82, 87, 84, BinaryData::C6v9_flac, BinaryData::C6v9_flacSize });
-    samples.add({ 88, 100, 90, BinaryData::F6v9_flac, BinaryData::F6v9_flacSize });
+void BuiltInSynthPiano::reset()
+{
+    this->synth.allNotesOff(0, true);
+}
 
-    for (auto &s : samples)
+// may be called from the message thread and the renderer thread,
+// so only one of them collects the sounds, and neither touches the synth
+void BuiltInSynthPiano::initSampler()
+{
+    if (this->samplesPool->isLoaded() &&
+        this->soundsState.compareAndSetBool(collectingSounds, noSounds))
     {
-        UniquePointer<AudioFormatReader> reader(s.createReader());
-        this->synth.addSound(new SamplerSound({}, *reader,
-            s.midiNotes, s.midiNoteForNormalPitch,
-            ATTACK_TIME, RELEASE_TIME, MAX_PLAY_TIME));
+        for (auto *sound : this->samplesPool->getSounds())
+        {
+            this->pendingSoundsSet.add(sound);
+        }
+
+        this->soundsState = pendingSounds;
     }
 }
+
+void BuiltInSynthPiano::changeListenerCallback(ChangeBroadcaster *)
+{
+    this->initSampler();
+}
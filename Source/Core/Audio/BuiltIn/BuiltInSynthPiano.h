@@ -19,19 +19,24 @@
 
 #include "BuiltInSynthAudioPlugin.h"
 
+class PianoSamplesPool;
+
 // A lightweight piano sampler with the only purpose of providing a default instrument
 // that doesn't sound too much crappy when user opens the app at the very first time,
 // and doesn't have any custom instruments added yet.
 // So it's as simple and small as possible.
 
-class BuiltInSynthPiano : public BuiltInSynthAudioPlugin
+class BuiltInSynthPiano : public BuiltInSynthAudioPlugin, private ChangeListener
 {
 public:
 
     explicit BuiltInSynthPiano();
+    ~BuiltInSynthPiano() override;
 
     const String getName() const override;
     void processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages) override;
+    void prepareToPlay(double sampleRate, int estimatedSamplesPerBlock) override;
+    void setNonRealtime(bool isNonRealtime) noexcept override;
     void reset() override;
 
 protected:
@@ -39,5 +44,17 @@ protected:
     void initVoices() override;
     void initSampler() override;
 
+private:
+
+    void changeListenerCallback(ChangeBroadcaster *source) override;
+
+    SharedResourcePointer<PianoSamplesPool> samplesPool;
+
+    // the shared sounds are collected aside, and then the audio thread
+    // swaps them into the synth at the start of the next block
+    enum SoundsState { noSounds, collectingSounds, pendingSounds, hasSounds };
+    Atomic<int> soundsState = noSounds;
+    ReferenceCountedArray<SynthesiserSound> pendingSoundsSet;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthPiano)
 };
@@ -53,6 +53,41 @@ void Instrument::setName(const String &name)
     this->instrumentName = name;
 }
 
+bool Instrument::canSleepWhenSilent() const noexcept
+{
+    return this->sleepsWhenSilent;
+}
+
+void Instrument::setCanSleepWhenSilent(bool canSleep)
+{
+    if (this->sleepsWhenSilent != canSleep)
+    {
+        this->sleepsWhenSilent = canSleep;
+        this->updateSleepingPolicy();
+        this->sendChangeMessage();
+    }
+}
+
+// MIDI effects, like arpeggiators, keep producing notes with no messages
+// coming in, so the graphs having them are never put to sleep
+void Instrument::updateSleepingPolicy()
+{
+    bool hasMidiEffects = false;
+
+    for (const auto &node : this->findMidiProducers())
+    {
+        const auto *processor = node->getProcessor();
+        if (!this->isNodeStandardIOProcessor(node) &&
+            (processor->isMidiEffect() || processor->getTotalNumOutputChannels() == 0))
+        {
+            hasMidiEffects = true;
+            break;
+        }
+    }
+
+    this->audioCallback.setCanSleep(this->sleepsWhenSilent && !hasMidiEffects);
+}
+
 String Instrument::getInstrumentId() const
 {
     return this->instrumentId.toString();
@@ -77,6 +112,54 @@ String Instrument::getIdAndHash() const
     return this->getInstrumentId() + this->getInstrumentHash();
 }
 
+int Instrument::getStateVersion() const noexcept
+{
+    return this->stateVersion.get();
+}
+
+uint32 Instrument::getStateHash() const
+{
+    MemoryOutputStream state;
+    MemoryBlock nodeState;
+
+    for (int i = 0; i < this->processorGraph->getNumNodes(); ++i)
+    {
+        const auto node = this->processorGraph->getNode(i);
+        state.writeInt(static_cast<int>(node->nodeID.uid));
+
+        nodeState.reset();
+        node->getProcessor()->getStateInformation(nodeState);
+        state.write(nodeState.getData(), nodeState.getSize());
+    }
+
+    for (const auto &c : this->processorGraph->getConnections())
+    {
+        state.writeInt(static_cast<int>(c.source.nodeID.uid));
+        state.writeInt(c.source.channelIndex);
+        state.writeInt(static_cast<int>(c.destination.nodeID.uid));
+        state.writeInt(c.destination.channelIndex);
+    }
+
+    uint32 hash = fnv1a_32_val;
+    const auto *data = static_cast<const uint8 *>(state.getData());
+    for (size_t i = 0; i < state.getDataSize(); ++i)
+    {
+        hash = uint32(hash ^ data[i]) * fnv1a_32_prime;
+    }
+
+    return hash;
+}
+
+void Instrument::audioProcessorParameterChanged(AudioProcessor *, int, float)
+{
+    ++this->stateVersion;
+}
+
+void Instrument::audioProcessorChanged(AudioProcessor *)
+{
+    ++this->stateVersion;
+}
+
 bool Instrument::isValid() const noexcept
 {
     return this->instrumentName.isNotEmpty();
@@ -85,6 +168,7 @@ bool Instrument::isValid() const noexcept
 void Instrument::initializeFrom(const PluginDescription &pluginDescription, InitializationCallback initCallback)
 {
     this->processorGraph->clear();
+    ++this->stateVersion;
 
     this->addNodeAsync(pluginDescription, 0.5f, 0.5f, 
         [initCallback, this](AudioProcessorGraph::Node::Ptr instrument)
@@ -189,12 +273,15 @@ void Instrument::removeNode(AudioProcessorGraph::NodeID id)
 {
     PluginWindow::closeCurrentlyOpenWindowsFor(id);
     this->processorGraph->removeNode(id);
+    ++this->stateVersion;
+    this->updateSleepingPolicy();
     this->sendChangeMessage();
 }
 
 void Instrument::disconnectNode(AudioProcessorGraph::NodeID id)
 {
     this->processorGraph->disconnectNode(id);
+    ++this->stateVersion;
     this->sendChangeMessage();
 }
 
@@ -212,6 +299,7 @@ void Instrument::removeAllConnectionsForNode(AudioProcessorGraph::Node::Ptr node
 void Instrument::removeIllegalConnections()
 {
     this->processorGraph->removeIllegalConnections();
+    ++this->stateVersion;
     this->sendChangeMessage();
 }
 
@@ -392,6 +480,7 @@ bool Instrument::addConnection(AudioProcessorGraph::NodeID sourceID, int sourceC
     AudioProcessorGraph::Connection c(source, destination);
     if (this->processorGraph->addConnection(c))
     {
+        ++this->stateVersion;
         this->sendChangeMessage();
         return true;
     }
@@ -402,14 +491,19 @@ bool Instrument::addConnection(AudioProcessorGraph::NodeID sourceID, int sourceC
 void Instrument::removeConnection(AudioProcessorGraph::Connection connection)
 {
     this->processorGraph->removeConnection(connection);
+    ++this->stateVersion;
     this->sendChangeMessage();
 }
 
 void Instrument::reset()
 {
+    this->restoreGeneration++;
     PluginWindow::closeAllCurrentlyOpenWindows();
     this->processorGraph->clear();
+    ++this->stateVersion;
     this->instrumentName.clear();
+    this->sleepsWhenSilent = true;
+    this->updateSleepingPolicy();
     this->sendChangeMessage();
 }
 
@@ -425,6 +519,11 @@ ValueTree Instrument::serialize() const
     tree.setProperty(Audio::instrumentId, this->instrumentId.toString(), nullptr);
     tree.setProperty(Audio::instrumentName, this->instrumentName, nullptr);
 
+    if (!this->sleepsWhenSilent)
+    {
+        tree.setProperty(Audio::instrumentCanSleep, false, nullptr);
+    }
+
     const int numNodes = this->processorGraph->getNumNodes();
     for (int i = 0; i < numNodes; ++i)
     {
@@ -471,6 +570,26 @@ ValueTree Instrument::serializeNode(AudioProcessorGraph::Node::Ptr node) const
     return {};
 }
 
+struct Instrument::NodesRestoreProgress final : public ReferenceCountedObject
+{
+    using Ptr = ReferenceCountedObjectPtr<NodesRestoreProgress>;
+
+    struct Connection final
+    {
+        uint32 sourceNodeId;
+        uint32 destinationNodeId;
+        int sourceChannel;
+        int destinationChannel;
+    };
+
+    // the connections which still miss one of their nodes
+    Array<Connection> pendingConnections;
+
+    int numPendingNodes = 0;
+    int generation = 0;
+    double startTimeMs = 0.0;
+};
+
 void Instrument::deserialize(const ValueTree &tree)
 {
     this->reset();
@@ -483,26 +602,20 @@ void Instrument::deserialize(const ValueTree &tree)
 
     this->instrumentId = root.getProperty(Audio::instrumentId, this->instrumentId.toString());
     this->instrumentName = root.getProperty(Audio::instrumentName, this->instrumentName);
+    this->sleepsWhenSilent = root.getProperty(Audio::instrumentCanSleep, true);
+    this->updateSleepingPolicy();
+
+    // Plugins may be instantiated asynchronously (e.g. AUv3 plugins),
+    // so the connections are restored as soon as both their nodes are there
+    NodesRestoreProgress::Ptr progress(new NodesRestoreProgress());
+    progress->generation = this->restoreGeneration;
+    progress->startTimeMs = Time::getMillisecondCounterHiRes();
 
-    // Well this hack of an incredible ugliness
-    // is here to handle loading of async-loaded AUv3 plugins
-    
-    // Fill up the connections info for further processing
-    struct ConnectionDescription final
-    {
-        const uint32 sourceNodeId;
-        const uint32 destinationNodeId;
-        const int sourceChannel;
-        const int destinationChannel;
-    };
-    
-    Array<ConnectionDescription> connectionDescriptions;
-    
     forEachValueTreeChildWithType(root, e, Audio::connection)
     {
         const uint32 sourceNodeId = static_cast<int>(e.getProperty(Audio::sourceNodeId));
         const uint32 destinationNodeId = static_cast<int>(e.getProperty(Audio::destinationNodeId));
-        connectionDescriptions.add({
+        progress->pendingConnections.add({
             sourceNodeId,
             destinationNodeId,
             e.getProperty(Audio::sourceChannel),
@@ -517,47 +630,103 @@ void Instrument::deserialize(const ValueTree &tree)
         nodesToDeserialize.add(e);
     }
 
-    this->deserializeNodesAsync(nodesToDeserialize, [this, connectionDescriptions]()
-    {
-        for (const auto &connectionInfo : connectionDescriptions)
-        {
-            this->addConnection(AudioProcessorGraph::NodeID(connectionInfo.sourceNodeId),
-                connectionInfo.sourceChannel,
-                AudioProcessorGraph::NodeID(connectionInfo.destinationNodeId),
-                connectionInfo.destinationChannel);
-        }
-
-        this->processorGraph->removeIllegalConnections();
-        this->sendChangeMessage();
-    });
+    this->restoreNodesAsync(progress, nodesToDeserialize);
 }
 
-void Instrument::deserializeNodesAsync(Array<ValueTree> nodesToDeserialize, DeserializeNodesCallback allDoneCallback)
+void Instrument::restoreNodesAsync(NodesRestoreProgress::Ptr progress, const Array<ValueTree> &nodes)
 {
-    using namespace Serialization;
-    if (nodesToDeserialize.isEmpty())
+    if (nodes.isEmpty())
     {
-        allDoneCallback();
+        this->sendChangeMessage();
         return;
     }
 
-    const auto tree = nodesToDeserialize.removeAndReturn(0);
+    progress->numPendingNodes = nodes.size();
 
-    SerializablePluginDescription pd;
-    for (const auto &e : tree)
+    // Not waiting for each plugin before requesting the next one: the formats which
+    // instantiate their plugins asynchronously can then do it all concurrently,
+    // and the others will just load one by one, each in its own message loop callback,
+    // so that the nodes that are ready can already be played in the meantime
+    WeakReference<Instrument> weakThis(this);
+
+    for (const auto &tree : nodes)
     {
-        pd.deserialize(e);
-        if (pd.isValid()) { break; }
+        SerializablePluginDescription pd;
+        for (const auto &e : tree)
+        {
+            pd.deserialize(e);
+            if (pd.isValid()) { break; }
+        }
+
+        // the synchronous formats are instantiated here instead of inside
+        // createPluginInstanceAsync, so that each one is timed by itself,
+        // not including the ones queued before it
+        if (!this->canInstantiateAsynchronously(pd))
+        {
+            MessageManager::callAsync([weakThis, progress, tree, pd]()
+            {
+                if (weakThis == nullptr || weakThis->restoreGeneration != progress->generation)
+                {
+                    return;
+                }
+
+                String error;
+                const double startTimeMs = Time::getMillisecondCounterHiRes();
+                auto instance = weakThis->formatManager.createPluginInstance(pd,
+                    weakThis->processorGraph->getSampleRate(),
+                    weakThis->processorGraph->getBlockSize(), error);
+
+                const double instantiateTimeMs = Time::getMillisecondCounterHiRes() - startTimeMs;
+                weakThis->restoreNode(*progress, tree, std::move(instance), instantiateTimeMs);
+            });
+
+            continue;
+        }
+
+        // these are instantiated concurrently, so each one's time is its own
+        const double requestTimeMs = Time::getMillisecondCounterHiRes();
+        const auto callback = [weakThis, progress, tree, requestTimeMs]
+        (UniquePointer<AudioPluginInstance> instance, const String &error)
+        {
+            if (weakThis == nullptr || weakThis->restoreGeneration != progress->generation)
+            {
+                return;
+            }
+
+            const double instantiateTimeMs = Time::getMillisecondCounterHiRes() - requestTimeMs;
+            weakThis->restoreNode(*progress, tree, std::move(instance), instantiateTimeMs);
+        };
+
+        this->formatManager.createPluginInstanceAsync(pd,
+            this->processorGraph->getSampleRate(),
+            this->processorGraph->getBlockSize(),
+            callback);
     }
-    
-    const auto callback = [this, nodesToDeserialize, tree, allDoneCallback]
-    (UniquePointer<AudioPluginInstance> instance, const String &error)
+}
+
+bool Instrument::canInstantiateAsynchronously(const PluginDescription &pd)
+{
+    for (int i = 0; i < this->formatManager.getNumFormats(); ++i)
     {
-        if (instance == nullptr)
+        const auto *format = this->formatManager.getFormat(i);
+        if (format->getName() == pd.pluginFormatName)
         {
-            this->deserializeNodesAsync(nodesToDeserialize, allDoneCallback);
-            return;
+            return format->requiresUnblockedMessageThreadDuringCreation(pd);
         }
+    }
+
+    return false;
+}
+
+void Instrument::restoreNode(NodesRestoreProgress &progress, const ValueTree &tree,
+    UniquePointer<AudioPluginInstance> instance, double instantiateTimeMs)
+{
+    using namespace Serialization;
+
+    if (instance != nullptr)
+    {
+        const double restoreStartTimeMs = Time::getMillisecondCounterHiRes();
+        const String pluginName = instance->getName();
 
         MemoryBlock nodeStateBlock;
         const String state = tree.getProperty(Audio::pluginState);
@@ -574,26 +743,61 @@ void Instrument::deserializeNodesAsync(Array<ValueTree> nodesToDeserialize, Dese
         AudioProcessorGraph::NodeID nodeId(nodeUid);
         AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(std::move(instance), nodeId));
 
-        if (nodeStateBlock.getSize() > 0)
+        if (node != nullptr)
         {
-            node->getProcessor()->
-                setStateInformation(nodeStateBlock.getData(),
-                    static_cast<int>(nodeStateBlock.getSize()));
+            if (nodeStateBlock.getSize() > 0)
+            {
+                node->getProcessor()->
+                    setStateInformation(nodeStateBlock.getData(),
+                        static_cast<int>(nodeStateBlock.getSize()));
+            }
+
+            Uuid fallbackRandomHash;
+            const auto hash = nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString();
+            node->properties.set(Audio::nodeHash, hash);
+            node->properties.set(UI::positionX, nodeX);
+            node->properties.set(UI::positionY, nodeY);
+            node->getProcessor()->addListener(this);
+            ++this->stateVersion;
+
+            this->updateSleepingPolicy();
+            this->restorePendingConnections(progress);
         }
 
-        Uuid fallbackRandomHash;
-        const auto hash = nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString();
-        node->properties.set(Audio::nodeHash, hash);
-        node->properties.set(UI::positionX, nodeX);
-        node->properties.set(UI::positionY, nodeY);
+        Logger::writeToLog("Restored " + pluginName + ": instantiated in " + String(instantiateTimeMs, 1) +
+            " ms, state restored in " + String(Time::getMillisecondCounterHiRes() - restoreStartTimeMs, 1) + " ms");
+    }
+    else
+    {
+        Logger::writeToLog("Failed to instantiate a plugin for " + this->instrumentName +
+            " in " + String(instantiateTimeMs, 1) + " ms");
+    }
 
-        this->deserializeNodesAsync(nodesToDeserialize, allDoneCallback);
-    };
+    if (--progress.numPendingNodes == 0)
+    {
+        this->processorGraph->removeIllegalConnections();
+        this->sendChangeMessage();
 
-    formatManager.createPluginInstanceAsync(pd,
-        this->processorGraph->getSampleRate(),
-        this->processorGraph->getBlockSize(),
-        callback);
+        Logger::writeToLog("Restored " + this->instrumentName + " in " +
+            String(Time::getMillisecondCounterHiRes() - progress.startTimeMs, 1) + " ms");
+    }
+}
+
+void Instrument::restorePendingConnections(NodesRestoreProgress &progress)
+{
+    for (int i = progress.pendingConnections.size(); --i >= 0;)
+    {
+        const auto &c = progress.pendingConnections.getReference(i);
+        const AudioProcessorGraph::NodeID sourceNodeId(c.sourceNodeId);
+        const AudioProcessorGraph::NodeID destinationNodeId(c.destinationNodeId);
+
+        if (this->processorGraph->getNodeForId(sourceNodeId) != nullptr &&
+            this->processorGraph->getNodeForId(destinationNodeId) != nullptr)
+        {
+            this->addConnection(sourceNodeId, c.sourceChannel, destinationNodeId, c.destinationChannel);
+            progress.pendingConnections.remove(i);
+        }
+    }
 }
 
 AudioProcessorGraph::Node::Ptr Instrument::addNode(const PluginDescription &desc, double x, double y)
@@ -614,6 +818,7 @@ AudioProcessorGraph::Node::Ptr Instrument::addNode(const PluginDescription &desc
     if (node != nullptr)
     {
         this->configureNode(node, desc, x, y);
+        this->updateSleepingPolicy();
         this->sendChangeMessage();
         return node;
     }
@@ -638,6 +843,10 @@ void Instrument::configureNode(AudioProcessorGraph::Node::Ptr node,
     node->properties.set(Serialization::Audio::nodeHash, nodeHash);
     node->properties.set(Serialization::UI::positionX, x);
     node->properties.set(Serialization::UI::positionY, y);
+
+    // the processors' listeners go away with them, so they are never removed
+    node->getProcessor()->addListener(this);
+    ++this->stateVersion;
 }
 
 void Instrument::AudioCallback::setProcessor(AudioProcessor *const newOne)
@@ -667,6 +876,67 @@ void Instrument::AudioCallback::setProcessor(AudioProcessor *const newOne)
     }
 }
 
+void Instrument::AudioCallback::setSuspended(bool shouldBeSuspended)
+{
+    if (shouldBeSuspended)
+    {
+        const ScopedLock sl(this->lock);
+        this->suspended = true;
+        return;
+    }
+
+    // the device might restart while the processor is being prepared,
+    // in which case it is prepared once again for the new settings
+    for (;;)
+    {
+        int generation = 0;
+
+        {
+            const ScopedLock sl(this->lock);
+            generation = this->deviceGeneration;
+        }
+
+        this->prepareProcessor();
+
+        const ScopedLock sl(this->lock);
+        if (generation == this->deviceGeneration)
+        {
+            this->suspended = false;
+            return;
+        }
+    }
+}
+
+// Does nothing, if the device is not running,
+// since the processor will be prepared when it starts
+void Instrument::AudioCallback::prepareProcessor()
+{
+    AudioProcessor *processorToPrepare = nullptr;
+    double currentSampleRate = 0.0;
+    int currentBlockSize = 0;
+    int numIns = 0;
+    int numOuts = 0;
+
+    {
+        const ScopedLock sl(this->lock);
+        if (this->isPrepared && this->sampleRate > 0 && this->blockSize > 0)
+        {
+            processorToPrepare = this->processor;
+            currentSampleRate = this->sampleRate;
+            currentBlockSize = this->blockSize;
+            numIns = this->numInputChans;
+            numOuts = this->numOutputChans;
+        }
+    }
+
+    if (processorToPrepare != nullptr)
+    {
+        processorToPrepare->setPlayConfigDetails(numIns, numOuts, currentSampleRate, currentBlockSize);
+        processorToPrepare->setProcessingPrecision(AudioProcessor::singlePrecision);
+        processorToPrepare->prepareToPlay(currentSampleRate, currentBlockSize);
+    }
+}
+
 void Instrument::AudioCallback::audioDeviceIOCallback(const float** const inputChannelData,
     const int numInputChannels, float **const outputChannelData,
     const int numOutputChannels, const int numSamples)
@@ -675,6 +945,43 @@ void Instrument::AudioCallback::audioDeviceIOCallback(const float** const inputC
 
     this->incomingMidi.clear();
     this->messageCollector.removeNextBlockOfMessages(this->incomingMidi, numSamples);
+    this->previewQueue.popAll(this->incomingMidi);
+    this->numQueuedMessages = this->incomingMidi.getNumEvents();
+    this->incomingMidi.addEvents(this->timelineMidi, 0, numSamples, 0);
+    this->timelineMidi.clear();
+
+    // the renderer is using the processor, and the messages are dropped,
+    // but the frozen tracks still play
+    if (this->suspended.get())
+    {
+        for (int i = 0; i < numOutputChannels; ++i)
+        {
+            FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        }
+
+        this->mixFrozenAudio(outputChannelData, numOutputChannels, numSamples);
+        return;
+    }
+
+    if (this->sleeping)
+    {
+        if (!this->shouldWakeUp(inputChannelData, numInputChannels, numSamples))
+        {
+            for (int i = 0; i < numOutputChannels; ++i)
+            {
+                FloatVectorOperations::clear(outputChannelData[i], numSamples);
+            }
+
+            this->mixFrozenAudio(outputChannelData, numOutputChannels, numSamples);
+            return;
+        }
+
+        this->sleeping = false;
+        this->numSilentBlocks = 0;
+    }
+
+    this->updateHeldNotes();
+
     int totalNumChans = 0;
 
     if (numInputChannels > numOutputChannels)
@@ -713,26 +1020,165 @@ void Instrument::AudioCallback::audioDeviceIOCallback(const float** const inputC
     }
 
     AudioBuffer<float> buffer(this->channels, totalNumChans, numSamples);
+    bool hasProcessed = false;
+
+    const bool shouldBypassGraph = this->canBypassGraph &&
+        this->numFrozenAudioRegions > 0 && this->incomingMidi.isEmpty();
 
+    if (!shouldBypassGraph)
     {
         const ScopedLock sl(lock);
 
-        if (this->processor != nullptr)
+        // checked once again under the lock, which the renderer takes to suspend it
+        if (this->processor != nullptr && !this->suspended.get())
         {
             const ScopedLock sl2(this->processor->getCallbackLock());
 
             if (!this->processor->isSuspended())
             {
                 this->processor->processBlock(buffer, this->incomingMidi);
-                return;
+                hasProcessed = true;
             }
         }
     }
 
+    if (hasProcessed)
+    {
+        this->updateSleepingState(outputChannelData, numOutputChannels, numSamples);
+    }
+    else
+    {
+        for (int i = 0; i < numOutputChannels; ++i)
+        {
+            FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        }
+    }
+
+    this->mixFrozenAudio(outputChannelData, numOutputChannels, numSamples);
+}
+
+// Any message wakes the instrument up, as well as any signal at the input,
+// since some graphs might have effects processing the audio input
+bool Instrument::AudioCallback::shouldWakeUp(const float **inputChannelData,
+    int numInputChannels, int numSamples) noexcept
+{
+    if (!this->incomingMidi.isEmpty() || !this->canSleep.get())
+    {
+        return true;
+    }
+
+    for (int i = 0; i < numInputChannels; ++i)
+    {
+        const auto range = FloatVectorOperations::findMinAndMax(inputChannelData[i], numSamples);
+        if (jmax(-range.getStart(), range.getEnd()) > INSTRUMENT_SILENCE_THRESHOLD)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Notes held for a long time might be silent at some point, like the ones
+// with a slow attack, so the instrument is never put to sleep while they're on
+void Instrument::AudioCallback::updateHeldNotes() noexcept
+{
+    MidiBuffer::Iterator it(this->incomingMidi);
+    MidiMessage message;
+    int samplePosition;
+
+    while (it.getNextEvent(message, samplePosition))
+    {
+        if (message.isNoteOn())
+        {
+            this->numHeldNotes++;
+        }
+        else if (message.isNoteOff())
+        {
+            this->numHeldNotes = jmax(0, this->numHeldNotes - 1);
+        }
+        else if (message.isAllNotesOff() || message.isAllSoundOff() || message.isMidiStop())
+        {
+            this->numHeldNotes = 0;
+        }
+    }
+}
+
+void Instrument::AudioCallback::updateSleepingState(float **outputChannelData,
+    int numOutputChannels, int numSamples) noexcept
+{
+    if (this->numHeldNotes > 0 || !this->canSleep.get())
+    {
+        this->numSilentBlocks = 0;
+        return;
+    }
+
     for (int i = 0; i < numOutputChannels; ++i)
     {
-        FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        const auto range = FloatVectorOperations::findMinAndMax(outputChannelData[i], numSamples);
+        if (jmax(-range.getStart(), range.getEnd()) > INSTRUMENT_SILENCE_THRESHOLD)
+        {
+            this->numSilentBlocks = 0;
+            return;
+        }
     }
+
+    this->numSilentBlocks++;
+    this->sleeping = this->numSilentBlocks >= this->numSilentBlocksToSleep;
+}
+
+void Instrument::AudioCallback::addFrozenAudio(FrozenAudio *audio,
+    int64 sourcePosition, int sampleOffset, int numSamples, bool canBypassGraph) noexcept
+{
+    this->canBypassGraph = this->canBypassGraph && canBypassGraph;
+
+    if (this->numFrozenAudioRegions < INSTRUMENT_MAX_FROZEN_AUDIO_REGIONS)
+    {
+        auto &region = this->frozenAudioRegions[this->numFrozenAudioRegions++];
+        region.audio = audio;
+        region.sourcePosition = sourcePosition;
+        region.sampleOffset = sampleOffset;
+        region.numSamples = numSamples;
+    }
+}
+
+// The regions hold the references to the frozen audio only for the duration of the block,
+// and the transport keeps its own references until nobody else needs them,
+// so the audio thread never has to release the memory-mapped files
+void Instrument::AudioCallback::mixFrozenAudio(float **outputChannelData,
+    int numOutputChannels, int numSamples) noexcept
+{
+    this->mixedFrozenAudio = (this->numFrozenAudioRegions > 0);
+    if (this->numFrozenAudioRegions == 0)
+    {
+        return;
+    }
+
+    // won't reallocate unless the device gives more samples than it has promised
+    this->frozenAudioBuffer.setSize(jmax(1, numOutputChannels), numSamples, false, false, true);
+
+    for (int r = 0; r < this->numFrozenAudioRegions; ++r)
+    {
+        auto &region = this->frozenAudioRegions[r];
+        const int numRegionSamples = jmin(region.numSamples, numSamples - region.sampleOffset);
+
+        if (numRegionSamples > 0)
+        {
+            region.audio->readSamples(this->frozenAudioBuffer.getArrayOfWritePointers(),
+                numOutputChannels, region.sampleOffset, numRegionSamples, region.sourcePosition);
+
+            for (int i = 0; i < numOutputChannels; ++i)
+            {
+                FloatVectorOperations::add(outputChannelData[i] + region.sampleOffset,
+                    this->frozenAudioBuffer.getReadPointer(i, region.sampleOffset), numRegionSamples);
+            }
+        }
+
+        region.audio = nullptr;
+    }
+
+    this->numFrozenAudioRegions = 0;
+    this->canBypassGraph = true;
 }
 
 void Instrument::AudioCallback::audioDeviceAboutToStart(AudioIODevice* const device)
@@ -748,9 +1194,25 @@ void Instrument::AudioCallback::audioDeviceAboutToStart(AudioIODevice* const dev
     this->blockSize = newBlockSize;
     this->numInputChans = numChansIn;
     this->numOutputChans = numChansOut;
+    this->deviceGeneration++;
+
+    this->sleeping = false;
+    this->numSilentBlocks = 0;
+    this->numSilentBlocksToSleep = jmax(1, int(newSampleRate *
+        INSTRUMENT_SLEEP_AFTER_SILENCE_MS / 1000 / jmax(1, newBlockSize)));
 
     this->messageCollector.reset(sampleRate);
+    this->previewQueue.start();
+    this->timelineMidi.ensureSize(2048);
     this->channels.calloc(jmax(numChansIn, numChansOut) + 2);
+    this->frozenAudioBuffer.setSize(jmax(1, numChansOut), jmax(1, newBlockSize));
+
+    // the renderer will prepare the processor when done
+    if (this->suspended.get())
+    {
+        this->isPrepared = (this->processor != nullptr);
+        return;
+    }
 
     if (this->processor != nullptr)
     {
@@ -769,11 +1231,13 @@ void Instrument::AudioCallback::audioDeviceStopped()
 {
     const ScopedLock sl(this->lock);
 
-    if (this->processor != nullptr && this->isPrepared)
+    if (this->processor != nullptr && this->isPrepared && !this->suspended.get())
     {
         this->processor->releaseResources();
     }
 
+    this->previewQueue.stop();
+    this->deviceGeneration++;
     this->sampleRate = 0.0;
     this->blockSize = 0;
     this->isPrepared = false;
@@ -17,13 +17,26 @@
 
 #pragma once
 
+#include "FrozenAudio.h"
+#include "MidiPreviewQueue.h"
+
+// Several frozen tracks may use the same instrument, and each of them
+// may be split into a couple of regions within a block, when the playback loops
+#define INSTRUMENT_MAX_FROZEN_AUDIO_REGIONS 32
+
+// An instrument which has been silent for this long, with no notes held,
+// stops processing its graph, until it gets some messages or input again
+#define INSTRUMENT_SLEEP_AFTER_SILENCE_MS 1000
+#define INSTRUMENT_SILENCE_THRESHOLD 0.0001f
+
 class AudioCore;
 class FilterInGraph;
 class Instrument;
 
 class Instrument final :
     public Serializable,
-    public ChangeBroadcaster // notifies InstrumentEditorPanel
+    public ChangeBroadcaster, // notifies InstrumentEditorPanel
+    private AudioProcessorListener
 {
 public:
 
@@ -37,11 +50,23 @@ public:
     String getIdAndHash() const;
     bool isValid() const noexcept;
 
+    // The version is bumped whenever the graph changes, or any plugin reports
+    // a parameter change, so it's cheap to check from anywhere; the hash also
+    // includes all the plugins' states, and is only taken on the message thread
+    int getStateVersion() const noexcept;
+    uint32 getStateHash() const;
+
     using InitializationCallback = Function<void(Instrument *)>;
 
     void initializeFrom(const PluginDescription &pluginDescription, InitializationCallback initCallback);
     void addNodeToFreeSpace(const PluginDescription &pluginDescription, InitializationCallback initCallback);
 
+    // Instruments stop processing their graphs after a while of silence,
+    // which can be disabled for the plugins sounding on their own, like the
+    // internally clocked ones; the graphs with MIDI effects never sleep anyway
+    bool canSleepWhenSilent() const noexcept;
+    void setCanSleepWhenSilent(bool canSleep);
+
     class AudioCallback final : public AudioIODeviceCallback, public MidiInputCallback
     {
     public:
@@ -49,8 +74,49 @@ public:
         AudioCallback() = default;
 
         void setProcessor(AudioProcessor *processor);
+
+        // The renderer takes the processor over while rendering or freezing:
+        // suspending waits for the block in progress, if any, and after that
+        // the callback only outputs the frozen audio, not touching the processor;
+        // resuming prepares the processor again for the current device settings
+        void setSuspended(bool shouldBeSuspended);
+
+        // Disabled for the graphs which might start sounding by themselves
+        void setCanSleep(bool shouldSleep) noexcept
+        { this->canSleep = shouldSleep; }
+
         MidiMessageCollector &getMidiMessageCollector() noexcept { return messageCollector; }
 
+        // The previewed messages are played at the start of the next block, see Transport
+        MidiPreviewQueue &getMidiPreviewQueue() noexcept { return previewQueue; }
+
+        // Only to be called from the audio thread, before this callback is processed,
+        // see TimelineDispatcher, which schedules the playback events for each block
+        void addTimelineMessage(const MidiMessage &message, int sampleOffset)
+        { this->timelineMidi.addEvent(message, sampleOffset); }
+
+        // Only to be called from the audio thread, like addTimelineMessage:
+        // the frozen tracks' audio is added to the output after the graph is processed;
+        // if all the tracks using this instrument are frozen, and there are no other
+        // incoming messages (like previewed notes), the graph is not processed at all
+        void addFrozenAudio(FrozenAudio *audio, int64 sourcePosition,
+            int sampleOffset, int numSamples, bool canBypassGraph) noexcept;
+
+        // The number of messages taken from the preview queue and the collector's queue
+        // in the last block, i.e. the previewed notes and the MIDI input;
+        // only to be called from the audio thread
+        int getNumQueuedMessages() const noexcept
+        { return this->numQueuedMessages; }
+
+        // Whether the graph has been skipped in the last block because of the silence,
+        // only to be called from the audio thread, see AudioMixer
+        bool isSleeping() const noexcept
+        { return this->sleeping || this->suspended.get(); }
+
+        // Whether any frozen audio has been added to the output in the last block
+        bool hasMixedFrozenAudio() const noexcept
+        { return this->mixedFrozenAudio; }
+
         void audioDeviceIOCallback(const float **, int, float **, int, int) override;
         void audioDeviceAboutToStart(AudioIODevice *) override;
         void audioDeviceStopped() override;
@@ -64,13 +130,52 @@ public:
         int blockSize = 0;
         bool isPrepared = false;
 
+        // these are only changed under the lock,
+        // the generation is bumped each time the device starts or stops
+        Atomic<bool> suspended = false;
+        int deviceGeneration = 0;
+
+        void prepareProcessor();
+
         int numInputChans = 0;
         int numOutputChans = 0;
         HeapBlock<float *> channels;
         AudioBuffer<float> tempBuffer;
 
         MidiBuffer incomingMidi;
+        MidiBuffer timelineMidi;
         MidiMessageCollector messageCollector;
+        MidiPreviewQueue previewQueue;
+        int numQueuedMessages = 0;
+
+        // the sleeping state is only accessed by the audio thread, as well as the
+        // number of sounding notes, which is tracked by the incoming note-ons and offs
+        bool sleeping = false;
+        int numSilentBlocks = 0;
+        int numSilentBlocksToSleep = 0;
+        int numHeldNotes = 0;
+        Atomic<bool> canSleep = true;
+
+        bool shouldWakeUp(const float **inputChannelData, int numInputChannels, int numSamples) noexcept;
+        void updateHeldNotes() noexcept;
+        void updateSleepingState(float **outputChannelData, int numOutputChannels, int numSamples) noexcept;
+
+        struct FrozenAudioRegion final
+        {
+            FrozenAudio::Ptr audio;
+            int64 sourcePosition;
+            int sampleOffset;
+            int numSamples;
+        };
+
+        void mixFrozenAudio(float **outputChannelData,
+            int numOutputChannels, int numSamples) noexcept;
+
+        FrozenAudioRegion frozenAudioRegions[INSTRUMENT_MAX_FROZEN_AUDIO_REGIONS];
+        int numFrozenAudioRegions = 0;
+        bool canBypassGraph = true;
+        bool mixedFrozenAudio = false;
+        AudioBuffer<float> frozenAudioBuffer;
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioCallback)
     };
@@ -149,6 +254,7 @@ private:
     String getInstrumentHash() const; // should be the same on all platforms
     
     AudioProcessorGraph::Node::Ptr addNode(const PluginDescription &, double x, double y);
+    void updateSleepingPolicy();
     void configureNode(AudioProcessorGraph::Node::Ptr, const PluginDescription &, double x, double y);
 
     friend class Transport;
@@ -159,11 +265,26 @@ private:
     AudioPluginFormatManager &formatManager;
     Instrument::AudioCallback audioCallback;
     UniquePointer<AudioProcessorGraph> processorGraph;
+    bool sleepsWhenSilent = true;
+
+    Atomic<int> stateVersion = 0;
+    void audioProcessorParameterChanged(AudioProcessor *, int, float) override;
+    void audioProcessorChanged(AudioProcessor *) override;
 
     ValueTree serializeNode(AudioProcessorGraph::Node::Ptr node) const;
 
-    using DeserializeNodesCallback = Function<void()>;
-    void deserializeNodesAsync(Array<ValueTree> nodesToDeserialize, DeserializeNodesCallback f);
+    // All nodes are requested at once, and each one is added as soon as
+    // its plugin is instantiated, along with the connections it completes
+    struct NodesRestoreProgress;
+    void restoreNodesAsync(ReferenceCountedObjectPtr<NodesRestoreProgress> progress, const Array<ValueTree> &nodes);
+    bool canInstantiateAsynchronously(const PluginDescription &pd);
+    void restoreNode(NodesRestoreProgress &progress, const ValueTree &tree,
+        UniquePointer<AudioPluginInstance> instance, double instantiateTimeMs);
+    void restorePendingConnections(NodesRestoreProgress &progress);
+
+    // incremented on each reset, so that the plugins instantiated
+    // for the previous state don't make it into the graph
+    int restoreGeneration = 0;
 
 private:
 
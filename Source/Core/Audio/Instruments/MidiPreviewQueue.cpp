@@ -0,0 +1,142 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiPreviewQueue.h"
+
+bool MidiPreviewQueue::push(const MidiMessage &message) noexcept
+{
+    const SpinLock::ScopedLockType lock(this->writeLock);
+
+    // nothing to play it anyway
+    if (!this->running.get())
+    {
+        return true;
+    }
+
+    return this->pushUnlocked(message, false);
+}
+
+bool MidiPreviewQueue::pushStopSound(int channel) noexcept
+{
+    const SpinLock::ScopedLockType lock(this->writeLock);
+
+    if (!this->running.get())
+    {
+        return true;
+    }
+
+    // only the audio thread reads, so the free space can only grow meanwhile
+    if (this->fifo.getFreeSpace() < 3)
+    {
+        this->cancelsAllPendingNotes = true;
+        return false;
+    }
+
+    this->pushUnlocked(MidiMessage::allNotesOff(channel), true);
+    this->pushUnlocked(MidiMessage::allControllersOff(channel), false);
+    this->pushUnlocked(MidiMessage::allSoundOff(channel), false);
+    return true;
+}
+
+void MidiPreviewQueue::start() noexcept
+{
+    const SpinLock::ScopedLockType lock(this->writeLock);
+    this->fifo.reset();
+    this->cancelsAllPendingNotes = false;
+    this->running = true;
+}
+
+void MidiPreviewQueue::stop() noexcept
+{
+    const SpinLock::ScopedLockType lock(this->writeLock);
+    this->running = false;
+}
+
+bool MidiPreviewQueue::pushUnlocked(const MidiMessage &message, bool cancelsPendingNotes) noexcept
+{
+    const auto size = message.getRawDataSize();
+    if (size <= 0 || size > 3 || message.isSysEx())
+    {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 < 1)
+    {
+        return false;
+    }
+
+    auto &slot = this->messages[size1 > 0 ? start1 : start2];
+    memcpy(slot.data, message.getRawData(), size_t(size));
+    slot.size = uint8(size);
+    slot.cancelsPendingNotes = cancelsPendingNotes;
+
+    this->fifo.finishedWrite(1);
+    return true;
+}
+
+int MidiPreviewQueue::popAll(MidiBuffer &destination) noexcept
+{
+    // checked before reading, so that it covers all the messages
+    // which have been queued before the stop messages didn't fit
+    const bool cancelsAll = this->cancelsAllPendingNotes.get() &&
+        this->cancelsAllPendingNotes.exchange(false);
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToRead(this->fifo.getNumReady(), start1, size1, start2, size2);
+
+    const int numReady = size1 + size2;
+    if (numReady == 0)
+    {
+        return 0;
+    }
+
+    const auto getMessage = [&](int i) -> const Message &
+    {
+        return this->messages[i < size1 ? start1 + i : start2 + i - size1];
+    };
+
+    // the note-ons sent before the sound was stopped are not played at all
+    int lastCancellation = cancelsAll ? numReady : -1;
+    for (int i = 0; i < numReady; ++i)
+    {
+        if (getMessage(i).cancelsPendingNotes)
+        {
+            lastCancellation = i;
+        }
+    }
+
+    int numAdded = 0;
+    for (int i = 0; i < numReady; ++i)
+    {
+        const auto &message = getMessage(i);
+        const bool isNoteOn = (message.data[0] & 0xf0) == 0x90 && message.size == 3 && message.data[2] != 0;
+        if (i < lastCancellation && isNoteOn)
+        {
+            continue;
+        }
+
+        // events with equal positions are kept in the order they were added
+        destination.addEvent(message.data, message.size, 0);
+        numAdded++;
+    }
+
+    this->fifo.finishedRead(numReady);
+    return numAdded;
+}
@@ -0,0 +1,76 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define MIDI_PREVIEW_QUEUE_SIZE 1024
+
+// A lock-free queue of the messages previewed on the fly, like the notes being
+// dragged around in the piano roll, or the chords being auditioned, which the audio
+// callback drains at the start of each block, so that the preview latency is one buffer.
+// Some plugins (e.g. Kontakt) tend to process play/stop messages out of order when they
+// come from the MidiMessageCollector with close timestamps, so here all the messages
+// are put at the start of the block in the very order they were sent; stopping the sound
+// goes through the same queue and drops the note-ons still pending in front of it.
+// Senders are serialized with a spin lock, since the player thread may also stop the sound;
+// the audio thread never locks. While the device is stopped, the messages are dropped
+// instead of piling up and bursting out when it starts again.
+class MidiPreviewQueue final
+{
+public:
+
+    MidiPreviewQueue() = default;
+
+    // Only short messages can be queued, returns false for the others,
+    // or if the queue is full, so that they could be sent some other way
+    bool push(const MidiMessage &message) noexcept;
+
+    // Adds all-notes-off, all-controllers-off and all-sound-off messages,
+    // and cancels the note-ons which are still waiting in the queue;
+    // if they don't fit, all the pending note-ons are cancelled anyway,
+    // and it returns false, so that the stop messages could be sent some other way
+    bool pushStopSound(int channel) noexcept;
+
+    // Called by the audio callback when the device starts and stops,
+    // starting drops whatever has been left in the queue
+    void start() noexcept;
+    void stop() noexcept;
+
+    // Only to be called from the audio thread, adds the pending messages
+    // to the buffer at the zero offset, and returns the number of messages added
+    int popAll(MidiBuffer &destination) noexcept;
+
+private:
+
+    struct Message final
+    {
+        uint8 data[3];
+        uint8 size;
+        bool cancelsPendingNotes;
+    };
+
+    bool pushUnlocked(const MidiMessage &message, bool cancelsPendingNotes) noexcept;
+
+    AbstractFifo fifo { MIDI_PREVIEW_QUEUE_SIZE };
+    Message messages[MIDI_PREVIEW_QUEUE_SIZE];
+
+    SpinLock writeLock;
+    Atomic<bool> running = false;
+    Atomic<bool> cancelsAllPendingNotes = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiPreviewQueue)
+};
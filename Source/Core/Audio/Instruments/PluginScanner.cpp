@@ -33,6 +33,18 @@
 #   define SAFE_SCAN 0
 #endif
 
+// Checker processes are independent, so a few of them can run at once;
+// unsafe scanning is done in-process, so it stays sequential
+#if SAFE_SCAN
+#   define PLUGIN_SCAN_MAX_CHECKERS 8
+#else
+#   define PLUGIN_SCAN_MAX_CHECKERS 1
+#endif
+
+#define PLUGIN_CHECK_TIMEOUT_MS 5000
+
+const String PluginScanner::checkerArgument = "--check-plugin";
+
 PluginScanner::PluginScanner() :
     Thread("Plugin Scanner")
 {
@@ -201,88 +213,44 @@ void PluginScanner::run()
 
         try
         {
-            const auto myPath(File::getSpecialLocation(File::currentExecutableFile).getFullPathName());
+            ThreadPool checkers(jlimit(1, PLUGIN_SCAN_MAX_CHECKERS, SystemStats::getNumCpus()));
 
             for (const auto &pluginPath : this->filesToScan)
             {
-                if (this->cancelled.get())
-                {
-                    DBG("Plugin scanning canceled");
-                    break;
-                }
-
-#if SAFE_SCAN
-                DBG("Safe scanning: " + pluginPath);
-
-                const Uuid tempFileName;
-                const File tempFile(DocumentHelpers::getTempSlot(tempFileName.toString()));
-                tempFile.appendText(pluginPath, false, false);
-
-                Thread::sleep(50);
-
-                ChildProcess checkerProcess;
-                const String commandLine(myPath + " " + tempFileName.toString());
-                checkerProcess.start(commandLine);
-                    
-                // FIXME! (#60): skips some valid plugins sometimes
-                if (!checkerProcess.waitForProcessToFinish(5000))
+                Array<PluginDescription> cachedTypes;
+                if (this->findScanResults(pluginPath, cachedTypes))
                 {
-                    checkerProcess.kill();
-                }
-                else
-                {
-                    Thread::sleep(50);
-
-                    if (tempFile.existsAsFile())
+                    for (const auto &type : cachedTypes)
                     {
-                        try
-                        {
-                            const auto tree(DocumentHelpers::load<XmlSerializer>(tempFile));
-                            if (tree.isValid())
-                            {
-                                forEachValueTreeChildWithType(tree, e, Serialization::Audio::plugin)
-                                {
-                                    SerializablePluginDescription pluginDescription;
-                                    pluginDescription.deserialize(e);
-                                    this->pluginsList.addType(pluginDescription);
-                                }
-                                    
-                                this->sendChangeMessage();
-                            }
-                        }
-                        catch (...) {}
+                        this->pluginsList.addType(type);
                     }
-                }
 
-                tempFile.deleteFile();
-#else
-                DBG("Unsafe scanning: " + pluginPath);
+                    continue;
+                }
 
-                KnownPluginList knownPluginList;
-                OwnedArray<PluginDescription> typesFound;
-                    
-                try
+                checkers.addJob([this, pluginPath, &formatManager]()
                 {
-                    for (int j = 0; j < formatManager.getNumFormats(); ++j)
+                    if (!this->cancelled.get())
                     {
-                        AudioPluginFormat *format = formatManager.getFormat(j);
-                        knownPluginList.scanAndAddFile(pluginPath, false, typesFound, *format);
+                        this->checkPlugin(pluginPath, formatManager);
                     }
-                }
-                catch (...) {}
-                    
-                // at this point we are still alive and plugin haven't crashed the app
-                if (typesFound.size() != 0)
+                });
+            }
+
+            // cached results are added at once:
+            this->sendChangeMessage();
+
+            // and the checked ones are streamed to the list as each check finishes
+            while (checkers.getNumJobs() > 0)
+            {
+                if (this->cancelled.get() || this->threadShouldExit())
                 {
-                    for (auto *type : typesFound)
-                    {
-                        this->pluginsList.addType(*type);
-                    }
+                    DBG("Plugin scanning canceled");
+                    checkers.removeAllJobs(false, PLUGIN_CHECK_TIMEOUT_MS * 2);
+                    break;
                 }
-                    
-                this->sendChangeMessage();
-                Thread::sleep(150);
-#endif
+
+                Thread::sleep(50);
             }
         }
         catch (...) {}
@@ -299,6 +267,150 @@ void PluginScanner::run()
     }
 }
 
+void PluginScanner::checkPlugin(const String &pluginPath, AudioPluginFormatManager &formatManager)
+{
+    Array<PluginDescription> typesFound;
+
+#if SAFE_SCAN
+    DBG("Safe scanning: " + pluginPath);
+    ignoreUnused(formatManager);
+
+    if (!this->checkPluginInChildProcess(pluginPath, typesFound))
+    {
+        // crashed or timed out, might be a busy system, so let's not cache that
+        return;
+    }
+#else
+    DBG("Unsafe scanning: " + pluginPath);
+
+    KnownPluginList knownPluginList;
+    OwnedArray<PluginDescription> types;
+
+    try
+    {
+        for (int j = 0; j < formatManager.getNumFormats(); ++j)
+        {
+            AudioPluginFormat *format = formatManager.getFormat(j);
+            knownPluginList.scanAndAddFile(pluginPath, false, types, *format);
+        }
+    }
+    catch (...) {}
+
+    // at this point we are still alive and plugin haven't crashed the app
+    for (const auto *type : types)
+    {
+        typesFound.add(*type);
+    }
+#endif
+
+    this->addScanResults(pluginPath, typesFound);
+}
+
+// The checker process writes the descriptions into a temp file, and not to its stdout,
+// which the plugins might print anything to, and which would need to be read
+// while waiting for the process; the file is replaced as a whole when written,
+// so it only exists, if the checker has completed the check
+bool PluginScanner::checkPluginInChildProcess(const String &pluginPath,
+    Array<PluginDescription> &typesFound)
+{
+    const Uuid resultFileName;
+    const File resultFile(DocumentHelpers::getTempSlot(resultFileName.toString()));
+
+    StringArray commandLine;
+    commandLine.add(File::getSpecialLocation(File::currentExecutableFile).getFullPathName());
+    commandLine.add(PluginScanner::checkerArgument);
+    commandLine.add(pluginPath);
+    commandLine.add(resultFile.getFullPathName());
+
+    // not piping its output, since nobody reads it
+    ChildProcess checkerProcess;
+    if (!checkerProcess.start(commandLine, 0))
+    {
+        return false;
+    }
+
+    if (!checkerProcess.waitForProcessToFinish(PLUGIN_CHECK_TIMEOUT_MS))
+    {
+        checkerProcess.kill();
+        resultFile.deleteFile();
+        return false;
+    }
+
+    // if the checker has crashed, there's no reply, which is not the same as no plugins
+    const auto tree(DocumentHelpers::load<XmlSerializer>(resultFile));
+    resultFile.deleteFile();
+
+    if (!tree.hasType(Serialization::Core::instrumentsList))
+    {
+        return false;
+    }
+
+    forEachValueTreeChildWithType(tree, e, Serialization::Audio::plugin)
+    {
+        SerializablePluginDescription pluginDescription;
+        pluginDescription.deserialize(e);
+        if (pluginDescription.isValid())
+        {
+            typesFound.add(pluginDescription);
+        }
+    }
+
+    return true;
+}
+
+void PluginScanner::addScanResults(const String &pluginPath,
+    const Array<PluginDescription> &typesFound)
+{
+    for (const auto &type : typesFound)
+    {
+        this->pluginsList.addType(type);
+    }
+
+    const File file(pluginPath);
+    if (file.exists() && !typesFound.isEmpty())
+    {
+        ScannedFile scannedFile;
+        scannedFile.modificationTime = file.getLastModificationTime().toMilliseconds();
+        scannedFile.size = file.getSize();
+        scannedFile.types = typesFound;
+
+        const ScopedLock sl(this->scanCacheLock);
+        this->scanCache[pluginPath] = scannedFile;
+    }
+    else
+    {
+        // the outdated results, if any
+        const ScopedLock sl(this->scanCacheLock);
+        this->scanCache.erase(pluginPath);
+    }
+
+    this->sendChangeMessage();
+}
+
+bool PluginScanner::findScanResults(const String &pluginPath,
+    Array<PluginDescription> &typesOut) const
+{
+    // built-in and other non-file plugins are always checked
+    const File file(pluginPath);
+    if (!file.exists())
+    {
+        return false;
+    }
+
+    const ScopedLock sl(this->scanCacheLock);
+
+    const auto found = this->scanCache.find(pluginPath);
+    if (found == this->scanCache.end() ||
+        found->second.modificationTime != file.getLastModificationTime().toMilliseconds() ||
+        found->second.size != file.getSize())
+    {
+        return false;
+    }
+
+    typesOut = found->second.types;
+    return true;
+}
+
 FileSearchPath PluginScanner::getTypicalFolders()
 {
     FileSearchPath folders;
@@ -376,6 +488,28 @@ ValueTree PluginScanner::serialize() const
         tree.appendChild(pd.serialize(), nullptr);
     }
 
+    ValueTree cacheNode(Serialization::Audio::pluginsScanCache);
+
+    {
+        const ScopedLock sl(this->scanCacheLock);
+        for (const auto &it : this->scanCache)
+        {
+            ValueTree fileNode(Serialization::Audio::scannedFile);
+            fileNode.setProperty(Serialization::Audio::scannedFilePath, it.first, nullptr);
+            fileNode.setProperty(Serialization::Audio::pluginFileModTime, it.second.modificationTime, nullptr);
+            fileNode.setProperty(Serialization::Audio::scannedFileSize, it.second.size, nullptr);
+
+            for (const auto &type : it.second.types)
+            {
+                const SerializablePluginDescription pd(type);
+                fileNode.appendChild(pd.serialize(), nullptr);
+            }
+
+            cacheNode.appendChild(fileNode, nullptr);
+        }
+    }
+
+    tree.appendChild(cacheNode, nullptr);
     return tree;
 }
 
@@ -388,7 +522,7 @@ void PluginScanner::deserialize(const ValueTree &tree)
 
     if (!root.isValid()) { return; }
     
-    for (const auto &child : root)
+    forEachValueTreeChildWithType(root, child, Serialization::Audio::plugin)
     {
         SerializablePluginDescription pluginDescription;
         pluginDescription.deserialize(child);
@@ -398,11 +532,43 @@ void PluginScanner::deserialize(const ValueTree &tree)
         }
     }
 
+    const ScopedLock sl(this->scanCacheLock);
+    const auto cacheNode = root.getChildWithName(Serialization::Audio::pluginsScanCache);
+    forEachValueTreeChildWithType(cacheNode, fileNode, Serialization::Audio::scannedFile)
+    {
+        ScannedFile scannedFile;
+        scannedFile.modificationTime = fileNode.getProperty(Serialization::Audio::pluginFileModTime);
+        scannedFile.size = fileNode.getProperty(Serialization::Audio::scannedFileSize);
+
+        forEachValueTreeChildWithType(fileNode, child, Serialization::Audio::plugin)
+        {
+            SerializablePluginDescription pluginDescription;
+            pluginDescription.deserialize(child);
+            if (pluginDescription.isValid())
+            {
+                scannedFile.types.add(pluginDescription);
+            }
+        }
+
+        // the empty results might have been saved by the older versions
+        const String path = fileNode.getProperty(Serialization::Audio::scannedFilePath);
+        if (!scannedFile.types.isEmpty())
+        {
+            this->scanCache[path] = scannedFile;
+        }
+    }
+
     this->sendChangeMessage();
 }
 
 void PluginScanner::reset()
 {
     this->pluginsList.clear();
+
+    {
+        const ScopedLock sl(this->scanCacheLock);
+        this->scanCache.clear();
+    }
+
     this->sendChangeMessage();
 }
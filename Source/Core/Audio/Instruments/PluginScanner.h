@@ -49,6 +49,10 @@ public:
     void scanFolderAndAddResults(const File &dir);
     void cancelRunningScan();
 
+    // The app, started with this argument followed by a plugin path and a file path,
+    // checks the plugin and writes the found descriptions into that file
+    static const String checkerArgument;
+
     //===------------------------------------------------------------------===//
     // Serializable
     //===------------------------------------------------------------------===//
@@ -65,7 +69,26 @@ private:
 
     void run() override;
 
+    void checkPlugin(const String &pluginPath, AudioPluginFormatManager &formatManager);
+    bool checkPluginInChildProcess(const String &pluginPath, Array<PluginDescription> &typesFound);
+    void addScanResults(const String &pluginPath, const Array<PluginDescription> &typesFound);
+
     KnownPluginList pluginsList;
+
+    // Scan results for plugin files: unchanged binaries are not checked again,
+    // but only if some plugins have been found there; the files which had none,
+    // or have crashed or hung the checker, are checked again with the next scan
+    struct ScannedFile final
+    {
+        int64 modificationTime = 0;
+        int64 size = 0;
+        Array<PluginDescription> types;
+    };
+
+    bool findScanResults(const String &pluginPath, Array<PluginDescription> &typesOut) const;
+
+    FlatHashMap<String, ScannedFile, StringHash> scanCache;
+    CriticalSection scanCacheLock;
     
     Atomic<bool> working = false;
     Atomic<bool> cancelled = false;
@@ -0,0 +1,158 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "AudioLoadStats.h"
+#include "SerializationKeys.h"
+
+AudioLoadStats::AudioLoadStats()
+{
+    this->clear();
+}
+
+void AudioLoadStats::addBlock(double elapsedTicks,
+    double blockDurationTicks, int numMidiMessages) noexcept
+{
+    if (this->resetRequested.compareAndSetBool(false, true))
+    {
+        this->clear();
+    }
+
+    if (blockDurationTicks <= 0.0)
+    {
+        return;
+    }
+
+    const float load = float(elapsedTicks / blockDurationTicks);
+    const int bin = jlimit(0, AUDIO_LOAD_STATS_NUM_BINS - 1,
+        int(load * AUDIO_LOAD_STATS_BINS_PER_BLOCK));
+
+    // there's only one writer at a time, so no read-modify-write operations are needed,
+    // and the reader doesn't care if the counters are a block behind each other
+    auto &binCounter = this->histogram[bin];
+    binCounter = binCounter.get() + 1;
+
+    this->numBlocks = this->numBlocks.get() + 1;
+    this->totalLoad = this->totalLoad.get() + double(load);
+    this->maxLoad = jmax(this->maxLoad.get(), load);
+
+    if (load > 1.f)
+    {
+        this->numOverruns = this->numOverruns.get() + 1;
+    }
+
+    this->totalMidiMessages = this->totalMidiMessages.get() + numMidiMessages;
+    this->maxMidiMessages = jmax(this->maxMidiMessages.get(), numMidiMessages);
+}
+
+void AudioLoadStats::reset() noexcept
+{
+    this->resetRequested = true;
+}
+
+void AudioLoadStats::clear() noexcept
+{
+    for (auto &binCounter : this->histogram)
+    {
+        binCounter = 0;
+    }
+
+    this->numBlocks = 0;
+    this->numOverruns = 0;
+    this->totalLoad = 0.0;
+    this->maxLoad = 0.f;
+    this->totalMidiMessages = 0;
+    this->maxMidiMessages = 0;
+}
+
+AudioLoadStats::Summary AudioLoadStats::getSummary() const
+{
+    Summary summary;
+    summary.numBlocks = this->numBlocks.get();
+    summary.numOverruns = this->numOverruns.get();
+    summary.maxLoad = this->maxLoad.get();
+    summary.maxMidiQueueDepth = this->maxMidiMessages.get();
+
+    if (summary.numBlocks > 0)
+    {
+        summary.meanLoad = float(this->totalLoad.get() / double(summary.numBlocks));
+        summary.meanMidiQueueDepth = float(double(this->totalMidiMessages.get()) / double(summary.numBlocks));
+    }
+
+    summary.histogram.ensureStorageAllocated(AUDIO_LOAD_STATS_NUM_BINS);
+    for (const auto &binCounter : this->histogram)
+    {
+        summary.histogram.add(binCounter.get());
+    }
+
+    return summary;
+}
+
+float AudioLoadStats::Summary::getLoadPercentile(float percentile) const noexcept
+{
+    int64 total = 0;
+    for (const auto count : this->histogram)
+    {
+        total += count;
+    }
+
+    if (total == 0)
+    {
+        return 0.f;
+    }
+
+    const int64 threshold = int64(ceil(double(total) * jlimit(0.f, 1.f, percentile)));
+
+    int64 accumulated = 0;
+    for (int i = 0; i < this->histogram.size(); ++i)
+    {
+        accumulated += this->histogram.getUnchecked(i);
+        if (accumulated >= threshold)
+        {
+            // the overflow bin has no upper edge
+            return (i == AUDIO_LOAD_STATS_NUM_BINS - 1) ? this->maxLoad :
+                float(i + 1) / float(AUDIO_LOAD_STATS_BINS_PER_BLOCK);
+        }
+    }
+
+    return this->maxLoad;
+}
+
+var AudioLoadStats::Summary::toVar() const
+{
+    using namespace Serialization::Audio;
+
+    DynamicObject::Ptr result(new DynamicObject());
+    result->setProperty(loadNumBlocks, this->numBlocks);
+    result->setProperty(loadNumOverruns, this->numOverruns);
+    result->setProperty(loadMean, this->meanLoad);
+    result->setProperty(loadMedian, this->getLoadPercentile(0.5f));
+    result->setProperty(load95thPercentile, this->getLoadPercentile(0.95f));
+    result->setProperty(load99thPercentile, this->getLoadPercentile(0.99f));
+    result->setProperty(loadMax, this->maxLoad);
+    result->setProperty(loadMeanMidiQueueDepth, this->meanMidiQueueDepth);
+    result->setProperty(loadMaxMidiQueueDepth, this->maxMidiQueueDepth);
+
+    Array<var> bins;
+    for (const auto count : this->histogram)
+    {
+        bins.add(count);
+    }
+
+    result->setProperty(loadHistogram, bins);
+    return var(result.get());
+}
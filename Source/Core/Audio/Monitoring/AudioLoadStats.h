@@ -0,0 +1,83 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// The load histogram has a bin for each 1/32 of the block duration,
+// and the last bin collects everything that took twice as long or more
+#define AUDIO_LOAD_STATS_BINS_PER_BLOCK 32
+#define AUDIO_LOAD_STATS_NUM_BINS (AUDIO_LOAD_STATS_BINS_PER_BLOCK * 2 + 1)
+
+// How long something takes on the audio thread, relative to the duration
+// of the audio block it processes, and how many MIDI messages it gets per block.
+// Written by one thread at a time without any locks or allocations, just with
+// the atomic loads and stores, and aggregated by the reader on any other thread.
+
+class AudioLoadStats final
+{
+public:
+
+    AudioLoadStats();
+
+    // Only to be called from the audio thread (or from a single thread at a time);
+    // the load is the elapsed time divided by the block duration,
+    // and anything above 1 means that the device callback has missed its deadline
+    void addBlock(double elapsedTicks, double blockDurationTicks,
+        int numMidiMessages = 0) noexcept;
+
+    // May be called from any thread: the counters are cleared by the writer
+    void reset() noexcept;
+
+    struct Summary final
+    {
+        int64 numBlocks = 0;
+        int64 numOverruns = 0;
+
+        float meanLoad = 0.f;
+        float maxLoad = 0.f;
+
+        // estimated from the histogram, i.e. rounded up to the bin size
+        float getLoadPercentile(float percentile) const noexcept;
+
+        float meanMidiQueueDepth = 0.f;
+        int maxMidiQueueDepth = 0;
+
+        Array<int64> histogram;
+
+        var toVar() const;
+    };
+
+    Summary getSummary() const;
+
+private:
+
+    void clear() noexcept;
+
+    Atomic<int64> histogram[AUDIO_LOAD_STATS_NUM_BINS];
+
+    Atomic<int64> numBlocks;
+    Atomic<int64> numOverruns;
+    Atomic<double> totalLoad;
+    Atomic<float> maxLoad;
+
+    Atomic<int64> totalMidiMessages;
+    Atomic<int> maxMidiMessages;
+
+    Atomic<bool> resetRequested = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioLoadStats)
+};
@@ -59,13 +59,32 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OversaturationWarningAsyncCallback)
 };
 
+// The spectrum is updated at about the UI refresh rate
+#define AUDIO_MONITOR_ANALYSIS_INTERVAL_MS 30
+
 AudioMonitor::AudioMonitor() :
+    Thread("AudioMonitor"),
     fft(),
+    ringBufferFifo(AUDIO_MONITOR_RING_BUFFER_SIZE),
+    ringBuffer(AUDIO_MONITOR_NUM_CHANNELS, AUDIO_MONITOR_RING_BUFFER_SIZE),
+    history(AUDIO_MONITOR_NUM_CHANNELS, AUDIO_MONITOR_FFT_SIZE),
     spectrumSize(AUDIO_MONITOR_SPECTRUM_SIZE),
-    sampleRate(AUDIO_MONITOR_NUM_CHANNELS)
+    sampleRate(AUDIO_MONITOR_SAMPLE_RATE),
+    numChannels(AUDIO_MONITOR_NUM_CHANNELS)
 {
     this->asyncClippingWarning.reset(new ClippingWarningAsyncCallback(*this));
     this->asyncOversaturationWarning.reset(new OversaturationWarningAsyncCallback(*this));
+
+    this->history.clear();
+    this->fftInput.calloc(AUDIO_MONITOR_FFT_SIZE);
+    zeromem(this->spectrum, sizeof(this->spectrum));
+
+    this->startThread(2);
+}
+
+AudioMonitor::~AudioMonitor()
+{
+    this->stopThread(1000);
 }
 
 //===----------------------------------------------------------------------===//
@@ -75,6 +94,9 @@ AudioMonitor::AudioMonitor() :
 void AudioMonitor::audioDeviceAboutToStart(AudioIODevice *device)
 {
     this->sampleRate = device->getCurrentSampleRate();
+    this->numChannels = jlimit(1, AUDIO_MONITOR_NUM_CHANNELS,
+        device->getActiveOutputChannels().countNumberOfSetBits());
+    this->loadStats.reset();
 }
 
 void AudioMonitor::audioDeviceIOCallback(const float **inputChannelData,
@@ -84,26 +106,32 @@ void AudioMonitor::audioDeviceIOCallback(const float **inputChannelData,
                                          int numSamples)
 {
     const int numChannels = jmin(AUDIO_MONITOR_NUM_CHANNELS, numOutputChannels);
-    
-    for (int channel = 0; channel < numChannels; ++channel)
+    if (numChannels == 0 || numSamples == 0)
     {
-        this->fft.computeSpectrum(outputChannelData[channel], 0, numSamples,
-            this->spectrum[channel], this->spectrumSize.get(),
-            channel, numOutputChannels);
+        return;
     }
-    
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    // pass the samples to the analysis thread, or drop them, if it lags behind
+    int start1, size1, start2, size2;
+    this->ringBufferFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < AUDIO_MONITOR_NUM_CHANNELS; ++channel)
+    {
+        const float *source = outputChannelData[jmin(channel, numChannels - 1)];
+        this->ringBuffer.copyFrom(channel, start1, source, size1);
+        this->ringBuffer.copyFrom(channel, start2, source + size1, size2);
+    }
+
+    this->ringBufferFifo.finishedWrite(size1 + size2);
+
     for (int channel = 0; channel < numChannels; ++channel)
     {
-        float pcmSquaresSum = 0.f;
-        float pcmPeak = 0.f;
-        for (int samplePosition = 0; samplePosition < numSamples; ++samplePosition)
-        {
-            const float &pcmData = outputChannelData[channel][samplePosition];
-            pcmSquaresSum += (pcmData * pcmData);
-            pcmPeak = jmax(pcmPeak, pcmData);
-        }
-        
-        const float rootMeanSquare = sqrtf(pcmSquaresSum / numSamples);
+        const float *pcmData = outputChannelData[channel];
+        const float pcmPeak = AudioCore::getPeak(pcmData, numSamples);
+        const float rootMeanSquare = AudioCore::getRootMeanSquare(pcmData, numSamples);
+
         this->rms[channel] = rootMeanSquare;
         this->peak[channel] = pcmPeak;
         
@@ -123,10 +151,104 @@ void AudioMonitor::audioDeviceIOCallback(const float **inputChannelData,
     {
         FloatVectorOperations::clear(outputChannelData[i], numSamples);
     }
+
+    const double blockDurationTicks = double(numSamples) / jmax(1.0, this->sampleRate.get()) *
+        double(Time::getHighResolutionTicksPerSecond());
+    this->loadStats.addBlock(double(Time::getHighResolutionTicks() - startTicks), blockDurationTicks);
 }
 
 void AudioMonitor::audioDeviceStopped() {}
 
+//===----------------------------------------------------------------------===//
+// Thread
+//===----------------------------------------------------------------------===//
+
+void AudioMonitor::run()
+{
+    while (!this->threadShouldExit())
+    {
+        this->wait(AUDIO_MONITOR_ANALYSIS_INTERVAL_MS);
+
+        const double currentSampleRate = this->sampleRate.get();
+        if (this->loudnessMeter.getSampleRate() != currentSampleRate)
+        {
+            this->loudnessMeter.prepare(currentSampleRate, this->numChannels.get());
+        }
+        else if (this->loudnessResetRequested.compareAndSetBool(false, true))
+        {
+            this->loudnessMeter.reset();
+        }
+
+        if (!this->readRingBuffer())
+        {
+            continue;
+        }
+
+        this->momentaryLoudness = this->loudnessMeter.getMomentaryLoudness();
+        this->shortTermLoudness = this->loudnessMeter.getShortTermLoudness();
+        this->integratedLoudness = this->loudnessMeter.getIntegratedLoudness();
+        for (int channel = 0; channel < AUDIO_MONITOR_NUM_CHANNELS; ++channel)
+        {
+            this->truePeak[channel] = this->loudnessMeter.getTruePeak(channel);
+        }
+
+        const int backFrame = 1 - this->frontSpectrumFrame.get();
+
+        for (int channel = 0; channel < AUDIO_MONITOR_NUM_CHANNELS; ++channel)
+        {
+            // unwrap the history, starting from the oldest sample
+            const float *channelHistory = this->history.getReadPointer(channel);
+            const int numOldest = AUDIO_MONITOR_FFT_SIZE - this->historyPosition;
+            FloatVectorOperations::copy(this->fftInput, channelHistory + this->historyPosition, numOldest);
+            FloatVectorOperations::copy(this->fftInput + numOldest, channelHistory, this->historyPosition);
+
+            this->fft.computeSpectrum(this->fftInput, this->spectrum[backFrame][channel], AUDIO_MONITOR_FFT_SIZE);
+        }
+
+        this->frontSpectrumFrame = backFrame;
+    }
+}
+
+bool AudioMonitor::readRingBuffer()
+{
+    const int numReady = this->ringBufferFifo.getNumReady();
+    if (numReady == 0)
+    {
+        return false;
+    }
+
+    const auto appendToHistory = [this](int start, int numSamples)
+    {
+        // every sample counts for the loudness
+        this->loudnessMeter.process(this->ringBuffer, start, numSamples);
+
+        // only the last fft-size samples are needed
+        const int numSkipped = jmax(0, numSamples - AUDIO_MONITOR_FFT_SIZE);
+        start += numSkipped;
+        numSamples -= numSkipped;
+
+        while (numSamples > 0)
+        {
+            const int numToCopy = jmin(numSamples, AUDIO_MONITOR_FFT_SIZE - this->historyPosition);
+            for (int channel = 0; channel < AUDIO_MONITOR_NUM_CHANNELS; ++channel)
+            {
+                this->history.copyFrom(channel, this->historyPosition, this->ringBuffer, channel, start, numToCopy);
+            }
+
+            this->historyPosition = (this->historyPosition + numToCopy) % AUDIO_MONITOR_FFT_SIZE;
+            start += numToCopy;
+            numSamples -= numToCopy;
+        }
+    };
+
+    int start1, size1, start2, size2;
+    this->ringBufferFifo.prepareToRead(numReady, start1, size1, start2, size2);
+    appendToHistory(start1, size1);
+    appendToHistory(start2, size2);
+    this->ringBufferFifo.finishedRead(size1 + size2);
+    return true;
+}
+
 //===----------------------------------------------------------------------===//
 // Spectrum data
 //===----------------------------------------------------------------------===//
@@ -135,18 +257,19 @@ float AudioMonitor::getInterpolatedSpectrumAtFrequency(float frequency) const
 {
     const float resolution = 
         float(this->sampleRate.get() / 2.f) / float(this->spectrumSize.get());
+
+    const auto &frame = this->spectrum[this->frontSpectrumFrame.get()];
+    const int lastIndex = this->spectrumSize.get() - 1;
     
     const int index1 = roundToInt(frequency / resolution);
-    const int safeIndex1 = jlimit(0, this->spectrumSize.get(), index1);
+    const int safeIndex1 = jlimit(0, lastIndex, index1);
     const float f1 = index1 * resolution;
-    const float y1 = (this->spectrum[0][safeIndex1].get() +
-                      this->spectrum[1][safeIndex1].get()) / 2.f;
+    const float y1 = (frame[0][safeIndex1] + frame[1][safeIndex1]) / 2.f;
     
     const int index2 = index1 + 1;
-    const int safeIndex2 = jlimit(0, this->spectrumSize.get(), index2);
+    const int safeIndex2 = jlimit(0, lastIndex, index2);
     const float f2 = index2 * resolution;
-    const float y2 = (this->spectrum[0][safeIndex2].get() +
-                      this->spectrum[1][safeIndex2].get()) / 2.f;
+    const float y2 = (frame[0][safeIndex2] + frame[1][safeIndex2]) / 2.f;
     
     return y1 + ((AudioCore::fastLog10(frequency) - AudioCore::fastLog10(f1)) /
                  (AudioCore::fastLog10(f2) - AudioCore::fastLog10(f1))) * (y2 - y1);
@@ -184,3 +307,41 @@ float AudioMonitor::getRootMeanSquare(int channel) const
 {
     return this->rms[channel].get();
 }
+
+//===----------------------------------------------------------------------===//
+// Loudness data
+//===----------------------------------------------------------------------===//
+
+float AudioMonitor::getMomentaryLoudness() const noexcept
+{
+    return this->momentaryLoudness.get();
+}
+
+float AudioMonitor::getShortTermLoudness() const noexcept
+{
+    return this->shortTermLoudness.get();
+}
+
+float AudioMonitor::getIntegratedLoudness() const noexcept
+{
+    return this->integratedLoudness.get();
+}
+
+float AudioMonitor::getTruePeak(int channel) const noexcept
+{
+    return this->truePeak[channel].get();
+}
+
+void AudioMonitor::resetLoudness() noexcept
+{
+    this->loudnessResetRequested = true;
+}
+
+//===----------------------------------------------------------------------===//
+// Load data
+//===----------------------------------------------------------------------===//
+
+AudioLoadStats::Summary AudioMonitor::getLoadSummary() const
+{
+    return this->loadStats.getSummary();
+}
@@ -18,20 +18,31 @@
 #pragma once
 
 #include "SpectrumAnalyzer.h"
+#include "LoudnessMeter.h"
+#include "AudioLoadStats.h"
 
 // 256 == we don't need that high resolution on a spectrum
 #define AUDIO_MONITOR_SPECTRUM_SIZE                 256
+#define AUDIO_MONITOR_FFT_SIZE                      (AUDIO_MONITOR_SPECTRUM_SIZE * 2)
+#define AUDIO_MONITOR_RING_BUFFER_SIZE              16384
 #define AUDIO_MONITOR_NUM_CHANNELS                  2
 #define AUDIO_MONITOR_SAMPLE_RATE                   44100
 #define AUDIO_MONITOR_CLIP_THRESHOLD                0.995f
 #define AUDIO_MONITOR_OVERSATURATION_THRESHOLD      0.5f
 #define AUDIO_MONITOR_OVERSATURATION_RATE           4.f
 
-class AudioMonitor final : public AudioIODeviceCallback
+// The audio callback only measures peak and rms levels, and passes the samples
+// to the analysis thread through a lock-free ring buffer; the analysis thread
+// measures the loudness of every sample it gets, computes the spectrum
+// at about the UI refresh rate, and publishes it by flipping
+// the double-buffered spectrum frames.
+
+class AudioMonitor final : public AudioIODeviceCallback, private Thread
 {
 public:
     
     AudioMonitor();
+    ~AudioMonitor() override;
 
     //===------------------------------------------------------------------===//
     // AudioIODeviceCallback
@@ -64,23 +75,77 @@ public:
     
     float getPeak(int channel) const;
     float getRootMeanSquare(int channel) const;
+
+    //===------------------------------------------------------------------===//
+    // Loudness data
+    //===------------------------------------------------------------------===//
+
+    // all in LUFS, updated by the analysis thread every 100ms
+    float getMomentaryLoudness() const noexcept;
+    float getShortTermLoudness() const noexcept;
+    float getIntegratedLoudness() const noexcept;
+
+    // the linear oversampled peak level since the last reset
+    float getTruePeak(int channel) const noexcept;
+
+    // restarts the integrated loudness and true peak measurements
+    void resetLoudness() noexcept;
     
     //===------------------------------------------------------------------===//
     // Spectrum data
     //===------------------------------------------------------------------===//
     
     float getInterpolatedSpectrumAtFrequency(float frequency) const;
+
+    //===------------------------------------------------------------------===//
+    // Load data
+    //===------------------------------------------------------------------===//
+
+    // how long the audio callback takes, relative to the block duration
+    AudioLoadStats::Summary getLoadSummary() const;
     
 private:
 
+    //===------------------------------------------------------------------===//
+    // Thread
+    //===------------------------------------------------------------------===//
+
+    void run() override;
+
+    // drains the ring buffer into the analysis history, returns false if there was nothing new
+    bool readRingBuffer();
+
     SpectrumFFT fft;
 
-    Atomic<float> spectrum[AUDIO_MONITOR_NUM_CHANNELS][AUDIO_MONITOR_SPECTRUM_SIZE];
+    // the audio thread writes here, the analysis thread reads
+    AbstractFifo ringBufferFifo;
+    AudioBuffer<float> ringBuffer;
+
+    // the last samples read by the analysis thread, written circularly
+    AudioBuffer<float> history;
+    int historyPosition = 0;
+    HeapBlock<float> fftInput;
+
+    // the analysis thread fills the back frame and then flips the front frame index
+    float spectrum[2][AUDIO_MONITOR_NUM_CHANNELS][AUDIO_MONITOR_SPECTRUM_SIZE];
+    Atomic<int> frontSpectrumFrame = 0;
+
+    // only used by the analysis thread, which publishes the results to the atomics
+    LoudnessMeter loudnessMeter;
+    Atomic<bool> loudnessResetRequested = false;
+    Atomic<float> momentaryLoudness = LOUDNESS_METER_MIN_LUFS;
+    Atomic<float> shortTermLoudness = LOUDNESS_METER_MIN_LUFS;
+    Atomic<float> integratedLoudness = LOUDNESS_METER_MIN_LUFS;
+    Atomic<float> truePeak[AUDIO_MONITOR_NUM_CHANNELS];
+
     Atomic<float> peak[AUDIO_MONITOR_NUM_CHANNELS];
     Atomic<float> rms[AUDIO_MONITOR_NUM_CHANNELS];
 
     Atomic<int> spectrumSize;
     Atomic<double> sampleRate;
+    Atomic<int> numChannels;
+
+    AudioLoadStats loadStats;
 
     ListenerList<ClippingListener> clippingListeners;
 
@@ -0,0 +1,340 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "LoudnessMeter.h"
+
+#define LOUDNESS_METER_STEP_SEC             0.1
+#define LOUDNESS_METER_NUM_MOMENTARY_STEPS  4
+#define LOUDNESS_METER_ABSOLUTE_GATE        -70.0
+#define LOUDNESS_METER_RELATIVE_GATE        -10.0
+#define LOUDNESS_METER_BINS_PER_LU          10
+
+// The 48-tap interpolation filter from ITU-R BS.1770-4, Annex 2,
+// split into 4 phases, each producing one of the oversampled values
+static const float truePeakCoefficients[4][LOUDNESS_METER_TRUE_PEAK_TAPS] =
+{
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+      -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+       0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+      -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+       0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+      -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+       0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+      -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+       0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+static inline float powerToLoudness(double power) noexcept
+{
+    if (power <= 0.0)
+    {
+        return LOUDNESS_METER_MIN_LUFS;
+    }
+
+    return jmax(LOUDNESS_METER_MIN_LUFS, float(-0.691 + 10.0 * std::log10(power)));
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+    this->reset();
+}
+
+void LoudnessMeter::prepare(double newSampleRate, int newNumChannels)
+{
+    this->sampleRate = newSampleRate;
+    this->numChannels = jlimit(0, LOUDNESS_METER_MAX_CHANNELS, newNumChannels);
+    this->stepSize = jmax(1, roundToInt(newSampleRate * LOUDNESS_METER_STEP_SEC));
+
+    // the K-weighting filter coefficients, recalculated for the given sample rate
+    // as described in the BS.1770 for 48kHz: the high shelf models the head,
+    // and the high pass is the revised low-frequency B-curve
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        const double k = std::tan(MathConstants<double>::pi * f0 / newSampleRate);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        this->highShelf.b0 = (vh + vb * k / q + k * k) / a0;
+        this->highShelf.b1 = 2.0 * (k * k - vh) / a0;
+        this->highShelf.b2 = (vh - vb * k / q + k * k) / a0;
+        this->highShelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        this->highShelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        const double k = std::tan(MathConstants<double>::pi * f0 / newSampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        this->highPass.b0 = 1.0;
+        this->highPass.b1 = -2.0;
+        this->highPass.b2 = 1.0;
+        this->highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        this->highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    this->reset();
+}
+
+void LoudnessMeter::reset()
+{
+    for (auto &channel : this->channels)
+    {
+        channel = {};
+        zeromem(channel.history, sizeof(channel.history));
+    }
+
+    this->stepPosition = 0;
+    this->stepPower = 0.0;
+
+    zeromem(this->recentSteps, sizeof(this->recentSteps));
+    this->recentStepIndex = 0;
+    this->numRecentSteps = 0;
+
+    zeromem(this->histogramCounts, sizeof(this->histogramCounts));
+    zeromem(this->histogramPowers, sizeof(this->histogramPowers));
+
+    this->maxMomentaryLoudness = LOUDNESS_METER_MIN_LUFS;
+    this->maxShortTermLoudness = LOUDNESS_METER_MIN_LUFS;
+}
+
+double LoudnessMeter::getSampleRate() const noexcept
+{
+    return this->sampleRate;
+}
+
+//===----------------------------------------------------------------------===//
+// Processing
+//===----------------------------------------------------------------------===//
+
+void LoudnessMeter::process(const AudioBuffer<float> &buffer, int startSample, int numSamples)
+{
+    const int numChannelsToMeasure = jmin(this->numChannels, buffer.getNumChannels());
+    if (numChannelsToMeasure == 0)
+    {
+        return;
+    }
+
+    while (numSamples > 0)
+    {
+        const int numSamplesInStep = jmin(numSamples, this->stepSize - this->stepPosition);
+
+        for (int i = 0; i < numChannelsToMeasure; ++i)
+        {
+            this->processChannel(this->channels[i],
+                buffer.getReadPointer(i, startSample), numSamplesInStep, this->stepPower);
+        }
+
+        startSample += numSamplesInStep;
+        numSamples -= numSamplesInStep;
+        this->stepPosition += numSamplesInStep;
+
+        if (this->stepPosition == this->stepSize)
+        {
+            this->finishStep();
+        }
+    }
+}
+
+void LoudnessMeter::processChannel(ChannelState &state,
+    const float *data, int numSamples, double &outPower) noexcept
+{
+    const auto &hs = this->highShelf;
+    const auto &hp = this->highPass;
+
+    double power = 0.0;
+    float truePeak = state.truePeak;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float sample = data[i];
+
+        // K-weighting, transposed direct form II
+        const double x = double(sample);
+        const double y1 = hs.b0 * x + state.z1[0];
+        state.z1[0] = hs.b1 * x - hs.a1 * y1 + state.z2[0];
+        state.z2[0] = hs.b2 * x - hs.a2 * y1;
+
+        const double y2 = hp.b0 * y1 + state.z1[1];
+        state.z1[1] = hp.b1 * y1 - hp.a1 * y2 + state.z2[1];
+        state.z2[1] = hp.b2 * y1 - hp.a2 * y2;
+
+        power += y2 * y2;
+
+        // true peak, the taps go from the oldest sample to the newest one
+        state.history[state.historyPosition] = sample;
+        state.history[state.historyPosition + LOUDNESS_METER_TRUE_PEAK_TAPS] = sample;
+        state.historyPosition = (state.historyPosition + 1) % LOUDNESS_METER_TRUE_PEAK_TAPS;
+
+        const float *taps = state.history + state.historyPosition;
+        for (const auto &phase : truePeakCoefficients)
+        {
+            float value = 0.f;
+            for (int k = 0; k < LOUDNESS_METER_TRUE_PEAK_TAPS; ++k)
+            {
+                value += phase[k] * taps[k];
+            }
+
+            truePeak = jmax(truePeak, std::abs(value));
+        }
+    }
+
+    state.truePeak = truePeak;
+    outPower += power;
+}
+
+void LoudnessMeter::finishStep() noexcept
+{
+    this->recentSteps[this->recentStepIndex] = this->stepPower / double(this->stepSize);
+    this->recentStepIndex = (this->recentStepIndex + 1) % LOUDNESS_METER_NUM_SHORT_TERM_STEPS;
+    this->numRecentSteps = jmin(this->numRecentSteps + 1, LOUDNESS_METER_NUM_SHORT_TERM_STEPS);
+
+    this->stepPosition = 0;
+    this->stepPower = 0.0;
+
+    // each step completes a new 400ms gating block, overlapping the previous one by 75%
+    if (this->numRecentSteps >= LOUDNESS_METER_NUM_MOMENTARY_STEPS)
+    {
+        const double blockPower = this->getMeanStepPower(LOUDNESS_METER_NUM_MOMENTARY_STEPS);
+        const float blockLoudness = powerToLoudness(blockPower);
+        this->maxMomentaryLoudness = jmax(this->maxMomentaryLoudness, blockLoudness);
+
+        if (blockLoudness > LOUDNESS_METER_ABSOLUTE_GATE)
+        {
+            const int bin = jlimit(0, LOUDNESS_METER_HISTOGRAM_SIZE - 1,
+                int((blockLoudness - LOUDNESS_METER_ABSOLUTE_GATE) * LOUDNESS_METER_BINS_PER_LU));
+
+            this->histogramCounts[bin]++;
+            this->histogramPowers[bin] += blockPower;
+        }
+    }
+
+    if (this->numRecentSteps == LOUDNESS_METER_NUM_SHORT_TERM_STEPS)
+    {
+        this->maxShortTermLoudness = jmax(this->maxShortTermLoudness, this->getShortTermLoudness());
+    }
+}
+
+double LoudnessMeter::getMeanStepPower(int numStepsToAverage) const noexcept
+{
+    double sum = 0.0;
+    for (int i = 1; i <= numStepsToAverage; ++i)
+    {
+        const int index = (this->recentStepIndex - i + LOUDNESS_METER_NUM_SHORT_TERM_STEPS) %
+            LOUDNESS_METER_NUM_SHORT_TERM_STEPS;
+
+        sum += this->recentSteps[index];
+    }
+
+    return sum / double(numStepsToAverage);
+}
+
+//===----------------------------------------------------------------------===//
+// Results
+//===----------------------------------------------------------------------===//
+
+float LoudnessMeter::getMomentaryLoudness() const noexcept
+{
+    if (this->numRecentSteps < LOUDNESS_METER_NUM_MOMENTARY_STEPS)
+    {
+        return LOUDNESS_METER_MIN_LUFS;
+    }
+
+    return powerToLoudness(this->getMeanStepPower(LOUDNESS_METER_NUM_MOMENTARY_STEPS));
+}
+
+float LoudnessMeter::getShortTermLoudness() const noexcept
+{
+    if (this->numRecentSteps < LOUDNESS_METER_NUM_SHORT_TERM_STEPS)
+    {
+        return LOUDNESS_METER_MIN_LUFS;
+    }
+
+    return powerToLoudness(this->getMeanStepPower(LOUDNESS_METER_NUM_SHORT_TERM_STEPS));
+}
+
+// The blocks above the absolute gate are all in the histogram, so the relative gate
+// is found from their mean power, and then the blocks above the relative gate
+// are averaged again; the gate is applied with the bin precision of 0.1 LU
+float LoudnessMeter::getIntegratedLoudness() const noexcept
+{
+    int64 numBlocks = 0;
+    double powerSum = 0.0;
+
+    for (int i = 0; i < LOUDNESS_METER_HISTOGRAM_SIZE; ++i)
+    {
+        numBlocks += this->histogramCounts[i];
+        powerSum += this->histogramPowers[i];
+    }
+
+    if (numBlocks == 0)
+    {
+        return LOUDNESS_METER_MIN_LUFS;
+    }
+
+    const double relativeGate = powerToLoudness(powerSum / double(numBlocks)) + LOUDNESS_METER_RELATIVE_GATE;
+    const int firstBin = jlimit(0, LOUDNESS_METER_HISTOGRAM_SIZE,
+        int((relativeGate - LOUDNESS_METER_ABSOLUTE_GATE) * LOUDNESS_METER_BINS_PER_LU));
+
+    numBlocks = 0;
+    powerSum = 0.0;
+
+    for (int i = firstBin; i < LOUDNESS_METER_HISTOGRAM_SIZE; ++i)
+    {
+        numBlocks += this->histogramCounts[i];
+        powerSum += this->histogramPowers[i];
+    }
+
+    if (numBlocks == 0)
+    {
+        return LOUDNESS_METER_MIN_LUFS;
+    }
+
+    return powerToLoudness(powerSum / double(numBlocks));
+}
+
+float LoudnessMeter::getTruePeak(int channel) const noexcept
+{
+    jassert(channel >= 0 && channel < LOUDNESS_METER_MAX_CHANNELS);
+    return this->channels[channel].truePeak;
+}
+
+LoudnessMeter::Report LoudnessMeter::getReport() const noexcept
+{
+    float truePeak = 0.f;
+    for (int i = 0; i < this->numChannels; ++i)
+    {
+        truePeak = jmax(truePeak, this->channels[i].truePeak);
+    }
+
+    Report report;
+    report.integratedLoudness = this->getIntegratedLoudness();
+    report.maxShortTermLoudness = this->maxShortTermLoudness;
+    report.maxMomentaryLoudness = this->maxMomentaryLoudness;
+    report.truePeakDecibels = Decibels::gainToDecibels(truePeak, LOUDNESS_METER_MIN_LUFS);
+    return report;
+}
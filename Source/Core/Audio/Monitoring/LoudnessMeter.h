@@ -0,0 +1,125 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define LOUDNESS_METER_MAX_CHANNELS     2
+#define LOUDNESS_METER_MIN_LUFS         -100.f
+
+// 12 taps per each of the 4 phases of the true peak interpolator
+#define LOUDNESS_METER_TRUE_PEAK_TAPS   12
+
+// 3 seconds in 100ms steps
+#define LOUDNESS_METER_NUM_SHORT_TERM_STEPS 30
+
+// 0.1 LU bins from the absolute gate of -70 LUFS up to +10 LUFS
+#define LOUDNESS_METER_HISTOGRAM_SIZE   800
+
+// Measures loudness as per ITU-R BS.1770-4 and EBU R128: the K-weighted
+// mean square power is accumulated in 100ms steps, from which the momentary
+// (400ms) and short-term (3s) loudness are computed, and the gated integrated
+// loudness is kept in a histogram of 400ms blocks, so that the memory usage
+// doesn't grow with the measured duration. The true peak is measured
+// by 4x oversampling with the interpolation filter from the Annex 2.
+//
+// Not thread-safe: it's meant to be fed and polled from a single thread,
+// like the audio monitor's analysis thread, or the renderer thread.
+
+class LoudnessMeter final
+{
+public:
+
+    LoudnessMeter();
+
+    struct Report final
+    {
+        float integratedLoudness = LOUDNESS_METER_MIN_LUFS;
+        float maxShortTermLoudness = LOUDNESS_METER_MIN_LUFS;
+        float maxMomentaryLoudness = LOUDNESS_METER_MIN_LUFS;
+        float truePeakDecibels = LOUDNESS_METER_MIN_LUFS;
+    };
+
+    // only the first LOUDNESS_METER_MAX_CHANNELS channels are measured,
+    // all with the unit weight, as for the left and right channels
+    void prepare(double sampleRate, int numChannels);
+    void reset();
+
+    void process(const AudioBuffer<float> &buffer, int startSample, int numSamples);
+
+    double getSampleRate() const noexcept;
+
+    // all in LUFS, or LOUDNESS_METER_MIN_LUFS, if there's not enough data yet
+    float getMomentaryLoudness() const noexcept;
+    float getShortTermLoudness() const noexcept;
+    float getIntegratedLoudness() const noexcept;
+
+    // the linear oversampled peak level since the last reset
+    float getTruePeak(int channel) const noexcept;
+
+    Report getReport() const noexcept;
+
+private:
+
+    struct Biquad final
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    struct ChannelState final
+    {
+        // the K-weighting filter is two biquads in series
+        double z1[2] = { 0.0, 0.0 };
+        double z2[2] = { 0.0, 0.0 };
+
+        // the interpolator's input history, written twice,
+        // so that the last taps are always contiguous
+        float history[LOUDNESS_METER_TRUE_PEAK_TAPS * 2];
+        int historyPosition = 0;
+
+        float truePeak = 0.f;
+    };
+
+    void processChannel(ChannelState &state, const float *data, int numSamples, double &outPower) noexcept;
+    void finishStep() noexcept;
+    double getMeanStepPower(int numStepsToAverage) const noexcept;
+
+    double sampleRate = 0.0;
+    int numChannels = 0;
+
+    Biquad highShelf;
+    Biquad highPass;
+    ChannelState channels[LOUDNESS_METER_MAX_CHANNELS];
+
+    // the 100ms steps
+    int stepSize = 0;
+    int stepPosition = 0;
+    double stepPower = 0.0;
+
+    double recentSteps[LOUDNESS_METER_NUM_SHORT_TERM_STEPS];
+    int recentStepIndex = 0;
+    int numRecentSteps = 0;
+
+    // the gating blocks histogram: the number of blocks
+    // and the sum of their powers per each 0.1 LU bin
+    int64 histogramCounts[LOUDNESS_METER_HISTOGRAM_SIZE];
+    double histogramPowers[LOUDNESS_METER_HISTOGRAM_SIZE];
+
+    float maxMomentaryLoudness = LOUDNESS_METER_MIN_LUFS;
+    float maxShortTermLoudness = LOUDNESS_METER_MIN_LUFS;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
@@ -157,45 +157,43 @@ inline void SpectrumFFT::process(int bits)
     }
 }
 
-void SpectrumFFT::computeSpectrum(float *pcmbuffer,
-                                  unsigned int pcmposition,
-                                  unsigned int pcmlength,
-                                  Atomic<float> *spectrum,
-                                  int length,
-                                  int channel,
-                                  int numchannels)
+void SpectrumFFT::computeSpectrum(const float *pcmbuffer, float *spectrum, int fftSize)
 {
+    jassert(fftSize <= FFT_MAX_SPECTRUM_SIZE && isPowerOfTwo(fftSize));
+
     int count, bits, bitslength, nyquist;
     
-    bitslength = length;
+    bitslength = fftSize;
     bits = 0;
     while (bitslength > 1)
     {
         bitslength >>= 1;
         bits++;
     }
-    
-    // Apply Hanning window
-    for (count = 0; count < length; count++)
+
+    if (this->windowSize != fftSize)
     {
-        const float percent = static_cast<float>(count) / static_cast<float>(length);
-        const float window = 0.5f * (1.0f  - this->cosine(percent));
-        
-        this->buffer[count].re = pcmbuffer[pcmposition] * window;
-        this->buffer[count].re /= static_cast<float>(length);
-        this->buffer[count].im = 0.00000001f;
-        
-        pcmposition++;
-        if (pcmposition >= pcmlength)
+        this->windowSize = fftSize;
+        for (count = 0; count < fftSize; count++)
         {
-            pcmposition = 0;
+            const float percent = static_cast<float>(count) / static_cast<float>(fftSize);
+            this->window[count] = 0.5f * (1.0f - this->cosine(percent)) / static_cast<float>(fftSize);
         }
     }
+    
+    // Apply Hann window
+    FloatVectorOperations::multiply(this->windowed, pcmbuffer, this->window, fftSize);
+
+    for (count = 0; count < fftSize; count++)
+    {
+        this->buffer[count].re = this->windowed[count];
+        this->buffer[count].im = 0.00000001f;
+    }
 
     this->process(bits);
 
-    nyquist = (length / 2);
-    for (count = 0; count < (nyquist - 1); ++count)
+    nyquist = (fftSize / 2);
+    for (count = 0; count < nyquist; ++count)
     {
         const auto n = this->reverse(count, bits);
         spectrum[count] = jmin(1.0f, 2.5f *
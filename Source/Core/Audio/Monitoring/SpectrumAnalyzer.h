@@ -31,13 +31,8 @@ public:
     
     SpectrumFFT();
     
-    void computeSpectrum(float *pcmbuffer,
-        unsigned int pcmposition,
-        unsigned int pcmlength,
-        Atomic<float> *spectrum,
-        int length,
-        int channel,
-        int numchannels);
+    // Reads fftSize samples of pcm data, and fills fftSize / 2 spectrum values
+    void computeSpectrum(const float *pcmbuffer, float *spectrum, int fftSize);
     
 private:
     
@@ -49,6 +44,11 @@ private:
     
     FftComplex buffer[FFT_MAX_SPECTRUM_SIZE];
     float costab[FFT_COSTABSIZE];
+
+    // the Hann window, scaled by 1 / fftSize, precomputed for the last used size
+    float window[FFT_MAX_SPECTRUM_SIZE];
+    float windowed[FFT_MAX_SPECTRUM_SIZE];
+    int windowSize = 0;
     
     inline const float cosine(float x);
     inline const float sine(float x);
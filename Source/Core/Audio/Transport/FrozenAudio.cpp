@@ -0,0 +1,95 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "FrozenAudio.h"
+
+// Touching every page of the mapped file once, so that the first
+// playback doesn't have to wait for the page faults on the audio thread
+#define FROZEN_AUDIO_PREFETCH_STEP 256
+
+FrozenAudio::FrozenAudio(const File &file) : file(file)
+{
+    WavAudioFormat wavFormat;
+    this->reader.reset(wavFormat.createMemoryMappedReader(file));
+
+    if (this->reader == nullptr ||
+        !this->reader->usesFloatingPointData ||
+        !this->reader->mapEntireFile())
+    {
+        this->reader = nullptr;
+        return;
+    }
+
+    for (int64 i = 0; i < this->reader->lengthInSamples; i += FROZEN_AUDIO_PREFETCH_STEP)
+    {
+        this->reader->touchSample(i);
+    }
+}
+
+FrozenAudio::~FrozenAudio()
+{
+    this->reader = nullptr;
+    this->file.deleteFile();
+}
+
+bool FrozenAudio::isValid() const noexcept
+{
+    return this->reader != nullptr;
+}
+
+double FrozenAudio::getSampleRate() const noexcept
+{
+    return this->reader != nullptr ? this->reader->sampleRate : 0.0;
+}
+
+int64 FrozenAudio::getLengthInSamples() const noexcept
+{
+    return this->reader != nullptr ? this->reader->lengthInSamples : 0;
+}
+
+void FrozenAudio::readSamples(float *const *destChannels, int numDestChannels,
+    int startSample, int numSamples, int64 sourcePosition) const noexcept
+{
+    // the mapped reader only accepts the ranges within the file
+    const Range<int64> requested(sourcePosition, sourcePosition + numSamples);
+    const auto available = requested.getIntersectionWith({ 0, this->getLengthInSamples() });
+
+    if (available.isEmpty())
+    {
+        for (int i = 0; i < numDestChannels; ++i)
+        {
+            FloatVectorOperations::clear(destChannels[i] + startSample, numSamples);
+        }
+
+        return;
+    }
+
+    const int numLeading = int(available.getStart() - requested.getStart());
+    const int numAvailable = int(available.getLength());
+    const int numTrailing = numSamples - numLeading - numAvailable;
+
+    for (int i = 0; i < numDestChannels; ++i)
+    {
+        FloatVectorOperations::clear(destChannels[i] + startSample, numLeading);
+        FloatVectorOperations::clear(destChannels[i] + startSample + numLeading + numAvailable, numTrailing);
+    }
+
+    // float data is read as is, as usual for the readers of the float formats
+    this->reader->readSamples(reinterpret_cast<int **>(const_cast<float **>(destChannels)),
+        numDestChannels, startSample + numLeading, available.getStart(), numAvailable);
+}
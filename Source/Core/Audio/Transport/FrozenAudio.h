@@ -0,0 +1,50 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// The rendered audio of a frozen track: a temporary float wav file,
+// memory-mapped as a whole, so that the audio thread could read it
+// without any allocations or disk access; the file is removed
+// along with this object.
+
+class FrozenAudio final : public ReferenceCountedObject
+{
+public:
+
+    explicit FrozenAudio(const File &file);
+    ~FrozenAudio() override;
+
+    bool isValid() const noexcept;
+    double getSampleRate() const noexcept;
+    int64 getLengthInSamples() const noexcept;
+
+    // Overwrites the destination with the frozen samples starting from the given
+    // source position, filling the part beyond the rendered audio with silence;
+    // never allocates or blocks, so it's safe to call from the audio thread
+    void readSamples(float *const *destChannels, int numDestChannels,
+        int startSample, int numSamples, int64 sourcePosition) const noexcept;
+
+    using Ptr = ReferenceCountedObjectPtr<FrozenAudio>;
+
+private:
+
+    const File file;
+    UniquePointer<MemoryMappedAudioFormatReader> reader;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrozenAudio)
+};
@@ -0,0 +1,157 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteIntervalIndex.h"
+
+void NoteIntervalIndex::clear()
+{
+    this->nodes.clearQuick();
+    this->byStart.clearQuick();
+    this->byEnd.clearQuick();
+}
+
+void NoteIntervalIndex::rebuild(const MidiMessageSequence &sequence)
+{
+    this->clear();
+
+    Array<Interval> intervals;
+    for (int i = 0; i < sequence.getNumEvents(); ++i)
+    {
+        const auto *noteOnHolder = sequence.getEventPointer(i);
+        if (const auto *noteOffHolder = noteOnHolder->noteOffObject)
+        {
+            const double start = noteOnHolder->message.getTimeStamp();
+            const double end = noteOffHolder->message.getTimeStamp();
+            if (end > start)
+            {
+                intervals.add({ start, end, i });
+            }
+        }
+    }
+
+    this->byStart.ensureStorageAllocated(intervals.size());
+    this->byEnd.ensureStorageAllocated(intervals.size());
+    this->buildNode(intervals, 0, intervals.size());
+}
+
+// Returns the index of a new node, or -1, if there are no intervals in the range;
+// the range is reordered in place: the left subtree's intervals go first,
+// then the ones containing the center, then the right subtree's ones
+int NoteIntervalIndex::buildNode(Array<Interval> &intervals, int begin, int end)
+{
+    if (begin >= end)
+    {
+        return -1;
+    }
+
+    auto *data = intervals.getRawDataPointer();
+
+    // the median of interval starts keeps the tree balanced enough
+    const int median = begin + (end - begin) / 2;
+    std::nth_element(data + begin, data + median, data + end,
+        [](const Interval &a, const Interval &b) { return a.start < b.start; });
+
+    const double center = data[median].start;
+
+    auto *leftEnd = std::partition(data + begin, data + end,
+        [center](const Interval &i) { return i.end <= center; });
+
+    auto *centerEnd = std::partition(leftEnd, data + end,
+        [center](const Interval &i) { return i.start <= center; });
+
+    const int leftCount = int(leftEnd - data);
+    const int centerCount = int(centerEnd - data);
+
+    // at least the median interval contains the center, so the recursion ends
+    jassert(centerCount > leftCount);
+
+    std::sort(leftEnd, centerEnd,
+        [](const Interval &a, const Interval &b) { return a.start < b.start; });
+
+    const int nodeIndex = this->nodes.size();
+    Node node;
+    node.center = center;
+    node.begin = this->byStart.size();
+    node.end = node.begin + (centerCount - leftCount);
+    node.left = -1;
+    node.right = -1;
+
+    for (auto *i = leftEnd; i != centerEnd; ++i)
+    {
+        this->byStart.add(*i);
+    }
+
+    std::sort(leftEnd, centerEnd,
+        [](const Interval &a, const Interval &b) { return a.end > b.end; });
+
+    for (auto *i = leftEnd; i != centerEnd; ++i)
+    {
+        this->byEnd.add(*i);
+    }
+
+    this->nodes.add(node);
+
+    const int left = this->buildNode(intervals, begin, leftCount);
+    const int right = this->buildNode(intervals, centerCount, end);
+    this->nodes.getReference(nodeIndex).left = left;
+    this->nodes.getReference(nodeIndex).right = right;
+
+    return nodeIndex;
+}
+
+void NoteIntervalIndex::findSoundingNotesAt(double position, Array<int> &outNoteOnIndices) const
+{
+    int nodeIndex = this->nodes.isEmpty() ? -1 : 0;
+    while (nodeIndex >= 0)
+    {
+        const auto &node = this->nodes.getReference(nodeIndex);
+
+        if (position < node.center)
+        {
+            // all these end after the center, so only check the starts
+            for (int i = node.begin; i < node.end; ++i)
+            {
+                const auto &interval = this->byStart.getReference(i);
+                if (interval.start > position)
+                {
+                    break;
+                }
+
+                outNoteOnIndices.add(interval.noteOnIndex);
+            }
+
+            nodeIndex = node.left;
+        }
+        else
+        {
+            // all these start before the center, so only check the ends
+            for (int i = node.begin; i < node.end; ++i)
+            {
+                const auto &interval = this->byEnd.getReference(i);
+                if (interval.end <= position)
+                {
+                    break;
+                }
+
+                outNoteOnIndices.add(interval.noteOnIndex);
+            }
+
+            nodeIndex = node.right;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A centered interval tree over the notes of a cached midi sequence,
+// which answers "which notes are sounding at this position" in O(log n + k),
+// instead of checking all the note-on's one by one.
+//
+// The tree is stored in flat arrays; it keeps the note-on indices
+// in the sequence it was built for, so the sequence must not change afterwards
+// (copying the sequence is fine, since the order of events is preserved).
+
+class NoteIntervalIndex final
+{
+public:
+
+    NoteIntervalIndex() = default;
+
+    void rebuild(const MidiMessageSequence &sequence);
+    void clear();
+
+    // Collects the indices of note-on events, for which noteOn <= position < noteOff
+    void findSoundingNotesAt(double position, Array<int> &outNoteOnIndices) const;
+
+private:
+
+    struct Interval final
+    {
+        double start;
+        double end;
+        int noteOnIndex;
+    };
+
+    struct Node final
+    {
+        double center;
+
+        // intervals containing the center are stored in two ranges
+        // (of the same size) in the arrays below: sorted by start and by end
+        int begin;
+        int end;
+
+        int left;
+        int right;
+    };
+
+    int buildNode(Array<Interval> &intervals, int begin, int end);
+
+    Array<Node> nodes;
+    Array<Interval> byStart;
+    Array<Interval> byEnd;
+
+    JUCE_LEAK_DETECTOR(NoteIntervalIndex)
+};
@@ -0,0 +1,275 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PlaybackCacheBenchmark.h"
+#include "Transport.h"
+#include "TimelineDispatcher.h"
+#include "PlaybackTimeline.h"
+#include "OrchestraPit.h"
+#include "AudioCore.h"
+#include "PianoSequence.h"
+#include "Pattern.h"
+#include "SerializationKeys.h"
+
+// Each size is split into these numbers of tracks
+#define PLAYBACK_CACHE_BENCHMARK_FEW_TRACKS 20
+#define PLAYBACK_CACHE_BENCHMARK_MANY_TRACKS 200
+
+// Each edit is timed this many times, and the best time is reported
+#define PLAYBACK_CACHE_BENCHMARK_NUM_REPEATS 5
+
+const String PlaybackCacheBenchmark::argument = "--playback-cache-benchmark";
+
+//===----------------------------------------------------------------------===//
+// Project
+//===----------------------------------------------------------------------===//
+
+// Sends the sequences' changes to the transport, like the project does
+class PlaybackCacheBenchmarkDispatcher final : public ProjectEventDispatcher
+{
+public:
+
+    explicit PlaybackCacheBenchmarkDispatcher(Transport &transport) :
+        transport(transport) {}
+
+    void dispatchAddEvent(const MidiEvent &event) override
+    { this->transport.onAddMidiEvent(event); }
+
+    void dispatchChangeEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent) override
+    { this->transport.onChangeMidiEvent(oldEvent, newEvent); }
+
+    void dispatchRemoveEvent(const MidiEvent &event) override
+    { this->transport.onRemoveMidiEvent(event); }
+
+    void dispatchPostRemoveEvent(MidiSequence *const sequence) override
+    { this->transport.onPostRemoveMidiEvent(sequence); }
+
+    void dispatchAddClip(const Clip &clip) override
+    { this->transport.onAddClip(clip); }
+
+    void dispatchChangeClip(const Clip &oldClip, const Clip &newClip) override
+    { this->transport.onChangeClip(oldClip, newClip); }
+
+    void dispatchRemoveClip(const Clip &clip) override
+    { this->transport.onRemoveClip(clip); }
+
+    void dispatchPostRemoveClip(Pattern *const pattern) override
+    { this->transport.onPostRemoveClip(pattern); }
+
+    // the project's beat range is never changed by the benchmark edits
+    void dispatchChangeTrackProperties() override {}
+    void dispatchChangeProjectBeatRange() override {}
+
+private:
+
+    Transport &transport;
+
+    JUCE_DECLARE_NON_COPYABLE(PlaybackCacheBenchmarkDispatcher)
+};
+
+// A piano track with a single clip, like the ones created by default
+class PlaybackCacheBenchmarkTrack final : public MidiTrack
+{
+public:
+
+    PlaybackCacheBenchmarkTrack(ProjectEventDispatcher &dispatcher, int index) :
+        trackId(String(index))
+    {
+        this->sequence.reset(new PianoSequence(*this, dispatcher));
+        this->pattern.reset(new Pattern(*this, dispatcher));
+        this->pattern->silentImport(Clip(this->pattern.get()));
+    }
+
+    const String &getTrackId() const noexcept override { return this->trackId; }
+    int getTrackChannel() const noexcept override { return 1; }
+
+    String getTrackName() const noexcept override { return "Track " + this->trackId; }
+    void setTrackName(const String &, bool) override {}
+
+    Colour getTrackColour() const noexcept override { return Colours::white; }
+    void setTrackColour(const Colour &, bool) override {}
+
+    String getTrackInstrumentId() const noexcept override { return {}; }
+    void setTrackInstrumentId(const String &, bool) override {}
+
+    int getTrackControllerNumber() const noexcept override { return 0; }
+    void setTrackControllerNumber(int, bool) override {}
+
+    MidiSequence *getSequence() const noexcept override { return this->sequence.get(); }
+    Pattern *getPattern() const noexcept override { return this->pattern.get(); }
+
+protected:
+
+    void setTrackId(const String &val) override { this->trackId = val; }
+
+private:
+
+    String trackId;
+    UniquePointer<PianoSequence> sequence;
+    UniquePointer<Pattern> pattern;
+
+    JUCE_DECLARE_NON_COPYABLE(PlaybackCacheBenchmarkTrack)
+};
+
+// All tracks are linked to the only instrument
+class PlaybackCacheBenchmarkOrchestra final : public OrchestraPit
+{
+public:
+
+    explicit PlaybackCacheBenchmarkOrchestra(Instrument &instrument) :
+        instrument(instrument) {}
+
+    Array<Instrument *> getInstruments() const override
+    {
+        Array<Instrument *> instruments;
+        instruments.add(&this->instrument);
+        return instruments;
+    }
+
+    Instrument *findInstrumentById(const String &) const override
+    {
+        return &this->instrument;
+    }
+
+private:
+
+    Instrument &instrument;
+
+    JUCE_DECLARE_NON_COPYABLE(PlaybackCacheBenchmarkOrchestra)
+};
+
+class PlaybackCacheBenchmarkSleepTimer final : public SleepTimer
+{
+protected:
+
+    bool canSleepNow() override { return false; }
+    void sleepNow() override {}
+    void awakeNow() override {}
+};
+
+//===----------------------------------------------------------------------===//
+// Benchmark
+//===----------------------------------------------------------------------===//
+
+var PlaybackCacheBenchmark::run()
+{
+    namespace Keys = Serialization::Benchmarks;
+
+    AudioPluginFormatManager formatManager;
+    Instrument instrument(formatManager, "Playback Cache Benchmark");
+    PlaybackCacheBenchmarkOrchestra orchestra(instrument);
+    PlaybackCacheBenchmarkSleepTimer sleepTimer;
+    TimelineDispatcher timelineDispatcher;
+
+    const auto timeMs = [](const Function<void()> &function) -> double
+    {
+        const auto startTime = Time::getHighResolutionTicks();
+        function();
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1000.0;
+    };
+
+    Array<var> scenarios;
+    for (const int numNotes : { 10000, 100000, 1000000 })
+    {
+        for (const int numTracks : { PLAYBACK_CACHE_BENCHMARK_FEW_TRACKS, PLAYBACK_CACHE_BENCHMARK_MANY_TRACKS })
+        {
+            Transport transport(orchestra, sleepTimer, timelineDispatcher);
+            PlaybackCacheBenchmarkDispatcher dispatcher(transport);
+
+            // sixteenth notes going up and down, loaded like the saved tracks are
+            OwnedArray<PlaybackCacheBenchmarkTrack> tracks;
+            Array<MidiTrack *> projectTracks;
+            const int numNotesPerTrack = numNotes / numTracks;
+            for (int t = 0; t < numTracks; ++t)
+            {
+                auto *track = tracks.add(new PlaybackCacheBenchmarkTrack(dispatcher, t));
+                projectTracks.add(track);
+
+                ValueTree notes(Serialization::Midi::track);
+                for (int i = 0; i < numNotesPerTrack; ++i)
+                {
+                    const int key = MIDDLE_C - 12 + (i + t) % 24;
+                    notes.appendChild(Note(track->getSequence(), key,
+                        float(i) * 0.25f, 0.25f, 0.8f).serialize(), nullptr);
+                }
+
+                track->getSequence()->deserialize(notes);
+            }
+
+            transport.onReloadProjectContent(projectTracks);
+
+            const double loadMs = timeMs([&]() { transport.recacheIfNeeded(); });
+            const double lastBeat = double(numNotesPerTrack) * 0.25;
+
+            // moves one note in the middle track up and down, like dragging it in the editor
+            auto *editedSequence = static_cast<PianoSequence *>(tracks[numTracks / 2]->getSequence());
+            const auto editNote = [editedSequence](int i)
+            {
+                const Note note = *static_cast<Note *>(editedSequence->getUnchecked(editedSequence->size() / 2));
+                editedSequence->change(note, note.withDeltaKey((i % 2 == 0) ? 1 : -1), false);
+            };
+
+            double recacheMs = std::numeric_limits<double>::max();
+            double fullRecacheMs = std::numeric_limits<double>::max();
+            double timelineMs = std::numeric_limits<double>::max();
+
+            for (int i = 0; i < PLAYBACK_CACHE_BENCHMARK_NUM_REPEATS; ++i)
+            {
+                editNote(i);
+                recacheMs = jmin(recacheMs, timeMs([&]() { transport.recacheIfNeeded(); }));
+
+                // the player thread builds the timeline before the first block is played
+                timelineMs = jmin(timelineMs, timeMs([&]()
+                {
+                    auto sequences = transport.getPlaybackCache();
+                    const PlaybackTimeline::Ptr timeline(new PlaybackTimeline(sequences,
+                        transport.getTempoMap(), 0.0, lastBeat, false));
+                }));
+            }
+
+            // the same edits, but with all tracks re-exported
+            for (int i = 0; i < PLAYBACK_CACHE_BENCHMARK_NUM_REPEATS; ++i)
+            {
+                editNote(i);
+                transport.sequencesCache.invalidateAll();
+                fullRecacheMs = jmin(fullRecacheMs, timeMs([&]() { transport.recacheIfNeeded(); }));
+            }
+
+            Logger::writeToLog("Playback cache benchmark: " + String(numNotes) + " notes in " +
+                String(numTracks) + " tracks, load " + String(loadMs, 2) + " ms, edit and recache " +
+                String(recacheMs, 2) + " ms (" + String(fullRecacheMs, 2) + " ms with all tracks re-exported), " +
+                "timeline " + String(timelineMs, 2) + " ms");
+
+            DynamicObject::Ptr scenario(new DynamicObject());
+            scenario->setProperty(Keys::numNotes, numNotes);
+            scenario->setProperty(Keys::numTracks, numTracks);
+            scenario->setProperty(Keys::loadRecacheMs, loadMs);
+            scenario->setProperty(Keys::editRecacheMs, recacheMs);
+            scenario->setProperty(Keys::editFullRecacheMs, fullRecacheMs);
+            scenario->setProperty(Keys::timelineMs, timelineMs);
+            scenarios.add(var(scenario.get()));
+
+            // the tracks are removed before the transport, which keeps pointers to them
+            transport.onReloadProjectContent({});
+        }
+    }
+
+    DynamicObject::Ptr report(new DynamicObject());
+    report->setProperty(Keys::scenarios, scenarios);
+    return var(report.get());
+}
@@ -0,0 +1,39 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Measures how long it takes from editing one note to the playback start,
+// i.e. the transport's recache, and building the playback timeline from it,
+// on the projects of 10k, 100k and 1M notes; the recache with only the edited
+// track re-exported is compared to the full one, which the transport used to do.
+//
+// Runs from the command line, and writes the JSON report into the given file:
+//     Helio --playback-cache-benchmark report.json
+//
+// The real transport and sequences cache are used, with the piano tracks
+// generated in memory, and the edits are sent the same way the project sends them.
+
+class PlaybackCacheBenchmark final
+{
+public:
+
+    static const String argument;
+
+    static var run();
+
+};
@@ -0,0 +1,132 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PlaybackTimeline.h"
+
+PlaybackTimeline::PlaybackTimeline(ProjectSequences &sequences,
+    TempoMap::Ptr tempoMap, double start, double end, bool looped) :
+    tempoMap(tempoMap),
+    startTimeMs(tempoMap->getTimeMsAt(start)),
+    looped(looped)
+{
+    double lastTimeStamp = start;
+
+    sequences.seekToTime(start);
+
+    CachedMidiMessage cached;
+    while (sequences.getNextMessage(cached))
+    {
+        const double timeStamp = cached.message->getTimeStamp();
+        if (looped && timeStamp >= end)
+        {
+            break;
+        }
+
+        lastTimeStamp = timeStamp;
+        const double timeSec = this->getTimeSecAt(timeStamp);
+
+        if (cached.message->isTempoMetaEvent())
+        {
+            this->tempoEvents.add({ timeSec, *cached.message });
+            continue;
+        }
+
+        Track *track = nullptr;
+        for (auto *t : this->tracks)
+        {
+            if (t->instrument == cached.instrument)
+            {
+                track = t;
+                break;
+            }
+        }
+
+        if (track == nullptr)
+        {
+            track = this->tracks.add(new Track());
+            track->instrument = cached.instrument;
+        }
+
+        track->events.add({ timeSec, *cached.message });
+    }
+
+    for (const auto &frozenTrack : sequences.getFrozenTracks())
+    {
+        Track *track = nullptr;
+        for (auto *t : this->tracks)
+        {
+            if (t->instrument == frozenTrack.instrument)
+            {
+                track = t;
+                break;
+            }
+        }
+
+        if (track == nullptr)
+        {
+            track = this->tracks.add(new Track());
+            track->instrument = frozenTrack.instrument;
+        }
+
+        track->frozenAudio.add(frozenTrack.audio);
+    }
+
+    // in looped mode, the playback always wraps at the end position,
+    // otherwise it lasts until the end position or the last event, whichever is later
+    this->lengthSec = this->getTimeSecAt((looped || end > lastTimeStamp) ? end : lastTimeStamp);
+}
+
+const OwnedArray<PlaybackTimeline::Track> &PlaybackTimeline::getTracks() const noexcept
+{
+    return this->tracks;
+}
+
+const Array<PlaybackTimeline::Event> &PlaybackTimeline::getTempoEvents() const noexcept
+{
+    return this->tempoEvents;
+}
+
+double PlaybackTimeline::getLengthSec() const noexcept
+{
+    return this->lengthSec;
+}
+
+double PlaybackTimeline::getStartTimeSec() const noexcept
+{
+    return (this->startTimeMs - this->tempoMap->getTimeMsAt(0.0)) * 0.001;
+}
+
+bool PlaybackTimeline::isLooped() const noexcept
+{
+    return this->looped;
+}
+
+double PlaybackTimeline::getPositionAt(double timeSec) const noexcept
+{
+    return this->tempoMap->getPositionAt(this->startTimeMs + timeSec * 1000.0);
+}
+
+double PlaybackTimeline::getTempoAt(double timeSec) const noexcept
+{
+    return this->tempoMap->getTempoAt(this->getPositionAt(timeSec));
+}
+
+double PlaybackTimeline::getTimeSecAt(double position) const noexcept
+{
+    return (this->tempoMap->getTimeMsAt(position) - this->startTimeMs) * 0.001;
+}
@@ -0,0 +1,84 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "ProjectSequencesWrapper.h"
+#include "TempoMap.h"
+
+// An immutable snapshot of the playback cache, in which all messages are
+// merged once, grouped by instruments and stamped with seconds since the start,
+// so that both the audio thread and the renderer could just stream them
+// linearly and place them at exact sample offsets.
+
+class PlaybackTimeline final : public ReferenceCountedObject
+{
+public:
+
+    // start and end are in the playback cache time units (beats)
+    PlaybackTimeline(ProjectSequences &sequences, TempoMap::Ptr tempoMap,
+        double start, double end, bool looped);
+
+    struct Event final
+    {
+        double timeSec;
+        MidiMessage message;
+    };
+
+    struct Track final
+    {
+        Instrument *instrument;
+        Array<Event> events;
+
+        // the frozen tracks that use this instrument, played along with the events
+        ReferenceCountedArray<FrozenAudio> frozenAudio;
+    };
+
+    const OwnedArray<Track> &getTracks() const noexcept;
+
+    // Tempo events are sent to all instruments
+    const Array<Event> &getTempoEvents() const noexcept;
+
+    double getLengthSec() const noexcept;
+
+    // The time of the start position since the beginning of the project,
+    // i.e. the offset of this timeline within the frozen tracks' audio
+    double getStartTimeSec() const noexcept;
+    bool isLooped() const noexcept;
+
+    // Converts the playback time back to the playback cache time units,
+    // used by the player thread to broadcast seek position to UI
+    double getPositionAt(double timeSec) const noexcept;
+    double getTempoAt(double timeSec) const noexcept;
+
+    using Ptr = ReferenceCountedObjectPtr<PlaybackTimeline>;
+
+private:
+
+    double getTimeSecAt(double position) const noexcept;
+
+    OwnedArray<Track> tracks;
+    Array<Event> tempoEvents;
+
+    const TempoMap::Ptr tempoMap;
+    const double startTimeMs;
+
+    double lengthSec = 0.0;
+    bool looped = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlaybackTimeline)
+};
@@ -18,9 +18,12 @@
 #include "Common.h"
 
 #include "PlayerThread.h"
-#include "Instrument.h"
-#include "MidiSequence.h"
+#include "PlaybackTimeline.h"
+#include "TimelineDispatcher.h"
 
+// The actual timing of events is handled by TimelineDispatcher on the audio thread,
+// so the player thread is only used to keep the UI updated during the playback
+#define PLAYER_THREAD_UPDATE_TIME_MS 25
 #define MINIMUM_STOP_CHECK_TIME_MS 1000
 
 PlayerThread::PlayerThread(Transport &transport) :
@@ -43,131 +46,88 @@ void PlayerThread::startPlayback(double start, double end,
     this->loopedMode = shouldLoop;
     this->absStartPosition = jlimit(0.0, 1.0, start);
     this->absEndPosition = jlimit(0.0, 1.0, end);
+    this->hasOutdatedTimeline = false;
     this->startThread(10);
 }
 
+void PlayerThread::stopPlayback()
+{
+    this->signalThreadShouldExit();
+
+    // the thread might be sleeping right now, so don't wait
+    // for it to exit, and stop sending the events right away
+    this->transport.timelineDispatcher.stopPlayback();
+}
+
+void PlayerThread::updatePlayback()
+{
+    this->hasOutdatedTimeline = true;
+}
+
 void PlayerThread::run()
 {
     ProjectSequences sequences = this->transport.getPlaybackCache();
-    Array<Instrument *> uniqueInstruments(sequences.getUniqueInstruments());
-    
-    double nextEventTimeDelta = 0.0;
-    
-    double totalTimeMs = 0.0;
-    double tempoAtTheEndOfTrack = 0.0;
-    this->transport.calcTimeAndTempoAt(1.0, totalTimeMs, tempoAtTheEndOfTrack);
-    
-    double currentTimeMs = 0.0;
-    double msPerQuarter = 0.0;
-    this->transport.calcTimeAndTempoAt(this->absStartPosition, currentTimeMs, msPerQuarter);
-    
-    if (this->broadcastMode)
-    {
-        this->transport.broadcastTempoChanged(msPerQuarter);
-    }
-    
+    const auto tempoMap = this->transport.getTempoMap();
+
     const double totalTime = this->transport.getTotalTime();
     const double startPositionInTime = this->absStartPosition * totalTime;
     const double endPositionInTime = this->absEndPosition * totalTime;
-    
-    sequences.seekToTime(startPositionInTime);
-    double prevTimeStamp = startPositionInTime;
+
+    const double totalTimeMs = tempoMap->getTimeMsAt(totalTime);
+    const double startTimeMs = tempoMap->getTimeMsAt(startPositionInTime);
+    const double msPerQuarter = tempoMap->getTempoAt(startPositionInTime);
+
     if (this->broadcastMode)
     {
-        this->transport.broadcastSeek(prevTimeStamp / totalTime, currentTimeMs, totalTimeMs);
+        this->transport.broadcastTempoChanged(msPerQuarter);
     }
 
-    // This hack is here to keep track of still playing events
-    // to be able to send noteOff's when playback interrupts.
-    struct HoldingNote final
-    {
-        int key;
-        int channel;
-        MidiMessageCollector *listener;
-    };
-    // (some plugins just don't understand allNotesOff message)
-    Array<HoldingNote> holdingNotes;
-    
-    // Some shorthands:
-    auto sendMidiStart = [&uniqueInstruments]()
+    PlaybackTimeline::Ptr timeline(new PlaybackTimeline(sequences, tempoMap,
+        startPositionInTime, endPositionInTime, this->loopedMode));
+
+    if (this->broadcastMode)
     {
-        for (auto &instrument : uniqueInstruments)
-        {
-            MidiMessage startPlayback(MidiMessage::midiStart());
-            startPlayback.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(startPlayback);
-        }
-    };
+        this->transport.broadcastSeek(startPositionInTime / totalTime, startTimeMs, totalTimeMs);
+    }
 
-    auto sendHoldingNotesOffAndMidiStop = [&holdingNotes, &uniqueInstruments]()
+    if (this->threadShouldExit())
     {
-        for (const auto &holding : holdingNotes)
-        {
-            MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
-            noteOff.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            holding.listener->addMessageToQueue(noteOff);
-        }
-        
-        MidiMessage stopPlayback(MidiMessage::midiStop());
-        stopPlayback.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-        
-        for (auto &instrument : uniqueInstruments)
-        {
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(stopPlayback);
-        }
-        
-        // Wait until all plugins process the messages in their queues
-        Thread::sleep(50);
-    };
+        return;
+    }
+
+    auto &dispatcher = this->transport.timelineDispatcher;
+    dispatcher.startPlayback(timeline);
+
+    double lastBroadcastedTempo = msPerQuarter;
     
-    auto sendTempoChangeToEverybody = [&uniqueInstruments](const MidiMessage &tempoEvent)
+    while (!this->threadShouldExit())
     {
-        for (auto &instrument : uniqueInstruments)
+        Thread::sleep(PLAYER_THREAD_UPDATE_TIME_MS);
+
+        if (this->threadShouldExit())
         {
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(tempoEvent);
+            break;
         }
-    };
-    
-    // And here we go.
-    sendMidiStart();
-    
-    while (1)
-    {
-        CachedMidiMessage wrapper;
 
-        // Handle playback from the last event to the end of track:
-        if (!sequences.getNextMessage(wrapper))
+        if (this->hasOutdatedTimeline.compareAndSetBool(false, true))
         {
-            nextEventTimeDelta = msPerQuarter * (endPositionInTime - prevTimeStamp);
-            const uint32 targetTime = Time::getMillisecondCounter() + uint32(nextEventTimeDelta);
+            // the tempo map is not supposed to change here,
+            // since tempo changes make the transport restart the playback
+            ProjectSequences updatedSequences = this->transport.getPlaybackCache();
+            const PlaybackTimeline::Ptr updatedTimeline(new PlaybackTimeline(updatedSequences,
+                tempoMap, startPositionInTime, endPositionInTime, this->loopedMode));
 
-            // Give thread a chance to exit by checking at least once a, say, second
-            while (nextEventTimeDelta > MINIMUM_STOP_CHECK_TIME_MS)
+            if (dispatcher.updatePlayback(timeline.get(), updatedTimeline))
             {
-                nextEventTimeDelta -= MINIMUM_STOP_CHECK_TIME_MS;
-                Thread::sleep(MINIMUM_STOP_CHECK_TIME_MS);
-                if (this->threadShouldExit())
-                {
-                    sendHoldingNotesOffAndMidiStop();
-                    return;
-                }
+                timeline = updatedTimeline;
             }
+        }
 
-            Time::waitForMillisecondCounter(targetTime);
-
-            if (this->loopedMode)
-            {
-                sequences.seekToTime(startPositionInTime);
-                prevTimeStamp = startPositionInTime;
-                if (this->broadcastMode)
-                {
-                    this->transport.broadcastSeek(prevTimeStamp / totalTime, currentTimeMs, totalTimeMs);
-                }
-                continue;
-            }
-            else
+        if (!dispatcher.isPlaying(timeline.get()))
+        {
+            // either reached the end, or another player took over the dispatcher
+            if (!this->threadShouldExit())
             {
-                sendHoldingNotesOffAndMidiStop();
                 this->transport.allNotesControllersAndSoundOff();
 
                 if (this->broadcastMode)
@@ -175,103 +135,26 @@ void PlayerThread::run()
                     this->transport.seekToPosition(this->transport.getSeekPosition());
                     this->transport.broadcastStop();
                 }
-                return;
-            }
-        }
-
-        const bool shouldRewind =
-            (this->loopedMode &&
-            (wrapper.message.getTimeStamp() > endPositionInTime));
-
-        const double nextEventTimeStamp =
-            shouldRewind ? endPositionInTime : wrapper.message.getTimeStamp();
-
-        nextEventTimeDelta = msPerQuarter * (nextEventTimeStamp - prevTimeStamp);
-        currentTimeMs += nextEventTimeDelta;
-        prevTimeStamp = nextEventTimeStamp;
-
-        // Zero-delay check (we're playing a chord or so)
-        if (uint32(nextEventTimeDelta) != 0)
-        {
-            const uint32 targetTime = Time::getMillisecondCounter() + uint32(nextEventTimeDelta);
-            while (nextEventTimeDelta > MINIMUM_STOP_CHECK_TIME_MS)
-            {
-                nextEventTimeDelta -= MINIMUM_STOP_CHECK_TIME_MS;
-                Thread::sleep(MINIMUM_STOP_CHECK_TIME_MS);
-                if (this->threadShouldExit())
-                {
-                    sendHoldingNotesOffAndMidiStop();
-                    return;
-                }
-            }
-
-            Time::waitForMillisecondCounter(targetTime);
-
-            if (this->threadShouldExit())
-            {
-                sendHoldingNotesOffAndMidiStop();
-                return;
             }
 
-            if (this->broadcastMode)
-            {
-                this->transport.broadcastSeek(prevTimeStamp / totalTime, currentTimeMs, totalTimeMs);
-            }
+            break;
         }
-        
-        if (shouldRewind)
+
+        if (this->broadcastMode)
         {
-            sequences.seekToTime(startPositionInTime);
-            prevTimeStamp = startPositionInTime;
-            if (this->broadcastMode)
+            const double playbackTimeSec = dispatcher.getPlaybackTimeSec();
+            const double tempo = timeline->getTempoAt(playbackTimeSec);
+            if (tempo != lastBroadcastedTempo)
             {
-                this->transport.broadcastSeek(prevTimeStamp / totalTime, currentTimeMs, totalTimeMs);
+                lastBroadcastedTempo = tempo;
+                this->transport.broadcastTempoChanged(tempo);
             }
-        }
-        else
-        {
-            const int key = wrapper.message.getNoteNumber();
-            const int channel = wrapper.message.getChannel();
-            wrapper.message.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            
-            // Master tempo event is sent to everybody
-            if (wrapper.message.isTempoMetaEvent())
-            {
-                msPerQuarter = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f;
 
-                if (this->broadcastMode)
-                {
-                    this->transport.broadcastTempoChanged(msPerQuarter);
-                }
-
-                // Sends this to everybody (need to do that for drum-machines) - TODO test
-                sendTempoChangeToEverybody(wrapper.message);
-            }
-            else
-            {
-                wrapper.listener->addMessageToQueue(wrapper.message);
-            }
-            
-            if (wrapper.message.isNoteOn())
-            {
-                holdingNotes.add({ key, channel, wrapper.listener });
-            }
-            
-            if (wrapper.message.isNoteOff())
-            {
-                for (int i = 0; i < holdingNotes.size(); ++i)
-                {
-                    if (holdingNotes[i].key == key &&
-                        holdingNotes[i].channel == channel &&
-                        holdingNotes[i].listener == wrapper.listener)
-                    {
-                        holdingNotes.remove(i);
-                        break;
-                    }
-                }
-            }
+            const double position = timeline->getPositionAt(playbackTimeSec);
+            const double timeMs = startTimeMs + playbackTimeSec * 1000.0;
+            this->transport.broadcastSeek(position / totalTime, timeMs, totalTimeMs);
         }
     }
-    
-    jassertfalse;
+
+    dispatcher.stopPlayback(timeline.get());
 }
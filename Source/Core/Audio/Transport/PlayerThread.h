@@ -29,6 +29,12 @@ public:
     void startPlayback(double start, double end, bool shouldLoop,
         bool shouldBroadcastTransportEvents = true);
 
+    void stopPlayback();
+
+    // Asks the thread to re-build the timeline from the updated playback cache,
+    // which is then hot-swapped without stopping the playback
+    void updatePlayback();
+
 private:
 
     void run() override;
@@ -41,5 +47,7 @@ private:
     double absStartPosition = 0.0;
     double absEndPosition = 1.0;
 
+    Atomic<bool> hasOutdatedTimeline = false;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlayerThread)
 };
@@ -71,8 +71,16 @@ public:
         if (this->currentPlayer->isThreadRunning())
         {
             // Just signal player to stop:
-            // it might be waiting for the next midi event, so it won't stop immediately
-            this->currentPlayer->signalThreadShouldExit();
+            // it might be sleeping, so it won't exit immediately
+            this->currentPlayer->stopPlayback();
+        }
+    }
+
+    void updatePlayback()
+    {
+        if (this->isPlaying())
+        {
+            this->currentPlayer->updatePlayback();
         }
     }
 
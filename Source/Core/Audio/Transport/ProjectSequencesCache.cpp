@@ -0,0 +1,156 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ProjectSequencesCache.h"
+#include "MidiTrack.h"
+#include "MidiSequence.h"
+#include "Pattern.h"
+#include "Clip.h"
+
+void ProjectSequencesCache::invalidateAll()
+{
+    this->tracks.clear();
+}
+
+void ProjectSequencesCache::invalidateTrack(const MidiTrack *track)
+{
+    const auto found = this->tracks.find(track->getTrackId());
+    if (found != this->tracks.end())
+    {
+        found->second->allClipsOutdated = true;
+        found->second->sequence = nullptr;
+    }
+}
+
+void ProjectSequencesCache::invalidateClip(const Clip &clip)
+{
+    const auto found = this->tracks.find(clip.getTrackId());
+    if (found != this->tracks.end())
+    {
+        found->second->outdatedClips.insert(clip.getId());
+        found->second->sequence = nullptr;
+    }
+}
+
+void ProjectSequencesCache::removeTrack(const MidiTrack *track)
+{
+    this->tracks.erase(track->getTrackId());
+}
+
+void ProjectSequencesCache::setExportParameters(bool soloPlaybackMode, double newTimeOffset)
+{
+    if (this->hasSoloClips != soloPlaybackMode || this->timeOffset != newTimeOffset)
+    {
+        this->hasSoloClips = soloPlaybackMode;
+        this->timeOffset = newTimeOffset;
+        this->invalidateAll();
+    }
+}
+
+CachedMidiSequence::Ptr ProjectSequencesCache::getSequenceFor(const MidiTrack *track, Instrument *instrument)
+{
+    auto &trackCache = this->tracks[track->getTrackId()];
+    if (trackCache == nullptr)
+    {
+        trackCache = MakeUnique<TrackCache>();
+    }
+
+    if (trackCache->sequence != nullptr)
+    {
+        if (trackCache->sequence->instrument == instrument)
+        {
+            return trackCache->sequence;
+        }
+
+        // only the instrument link has changed, no need to re-export anything
+        auto cached = CachedMidiSequence::createFrom(instrument, track->getSequence());
+        cached->midiMessages = trackCache->sequence->midiMessages;
+        cached->notesIndex = trackCache->sequence->notesIndex;
+        trackCache->sequence = cached;
+        return cached;
+    }
+
+    static Clip noTransform;
+    const auto *sequence = track->getSequence();
+    const auto *pattern = track->getPattern();
+
+    // re-export outdated clips, re-use the others, and forget the removed ones
+    FlatHashMap<String, MidiMessageSequence, StringHash> clips;
+    const auto updateClip = [&](const Clip &clip)
+    {
+        const auto &clipId = clip.getId();
+        auto found = trackCache->clips.find(clipId);
+        if (trackCache->allClipsOutdated ||
+            found == trackCache->clips.end() ||
+            trackCache->outdatedClips.contains(clipId))
+        {
+            MidiMessageSequence exported;
+            sequence->exportMidi(exported, clip, this->hasSoloClips, this->timeOffset, 1.0);
+            clips[clipId] = std::move(exported);
+        }
+        else
+        {
+            clips[clipId] = std::move(found.value());
+        }
+    };
+
+    if (pattern != nullptr)
+    {
+        for (const auto *clip : pattern->getClips())
+        {
+            updateClip(*clip);
+        }
+    }
+    else
+    {
+        updateClip(noTransform);
+    }
+
+    trackCache->clips = std::move(clips);
+    trackCache->outdatedClips.clear();
+    trackCache->allClipsOutdated = false;
+
+    // clips are sorted by beat, so adding events one by one
+    // will mostly append them to the end of the merged sequence
+    auto cached = CachedMidiSequence::createFrom(instrument, sequence);
+    const auto mergeClip = [&](const Clip &clip)
+    {
+        const auto &exported = trackCache->clips[clip.getId()];
+        for (const auto *holder : exported)
+        {
+            cached->midiMessages.addEvent(holder->message);
+        }
+    };
+
+    if (pattern != nullptr)
+    {
+        for (const auto *clip : pattern->getClips())
+        {
+            mergeClip(*clip);
+        }
+    }
+    else
+    {
+        mergeClip(noTransform);
+    }
+
+    cached->midiMessages.updateMatchedPairs();
+    cached->notesIndex.rebuild(cached->midiMessages);
+    trackCache->sequence = cached;
+    return cached;
+}
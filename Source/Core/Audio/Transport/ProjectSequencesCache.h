@@ -0,0 +1,66 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiTrack;
+class Clip;
+
+#include "ProjectSequencesWrapper.h"
+
+// Keeps the exported messages for each clip of each track,
+// so that after an edit only the affected track or clip gets re-exported,
+// instead of re-exporting the whole project on the next playback
+
+class ProjectSequencesCache final
+{
+public:
+
+    ProjectSequencesCache() = default;
+
+    void invalidateAll();
+    void invalidateTrack(const MidiTrack *track);
+    void invalidateClip(const Clip &clip);
+    void removeTrack(const MidiTrack *track);
+
+    // both solo mode and time offset affect all clips, so if they change,
+    // the whole cache becomes outdated
+    void setExportParameters(bool hasSoloClips, double timeOffset);
+
+    CachedMidiSequence::Ptr getSequenceFor(const MidiTrack *track, Instrument *instrument);
+
+private:
+
+    struct TrackCache final
+    {
+        // exported messages for each clip, the key is clip id
+        FlatHashMap<String, MidiMessageSequence, StringHash> clips;
+        FlatHashSet<String, StringHash> outdatedClips;
+        bool allClipsOutdated = true;
+
+        // all clips merged together
+        CachedMidiSequence::Ptr sequence;
+    };
+
+    // the key is track id
+    FlatHashMap<String, UniquePointer<TrackCache>, StringHash> tracks;
+
+    bool hasSoloClips = false;
+    double timeOffset = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectSequencesCache)
+};
@@ -18,13 +18,14 @@
 #pragma once
 
 #include "Instrument.h"
+#include "NoteIntervalIndex.h"
 
 class MidiSequence;
 
 struct CachedMidiSequence final : public ReferenceCountedObject
 {
     MidiMessageSequence midiMessages;
-    int currentIndex;
+    NoteIntervalIndex notesIndex;
     MidiMessageCollector *listener;
     Instrument *instrument;
     const MidiSequence *track;
@@ -36,19 +37,28 @@ struct CachedMidiSequence final : public ReferenceCountedObject
         jassert(instrument != nullptr);
         CachedMidiSequence::Ptr wrapper(new CachedMidiSequence());
         wrapper->track = track;
-        wrapper->currentIndex = 0;
         wrapper->instrument = instrument;
         wrapper->listener = &instrument->getProcessorPlayer().getMidiMessageCollector();
         return wrapper;
     }
 };
 
-struct CachedMidiMessage final : public ReferenceCountedObject
+// A track which is played from its rendered audio instead of its messages;
+// the messages are still kept for probing the notes, but never dispatched
+struct FrozenTrack final
 {
-    MidiMessage message;
-    MidiMessageCollector *listener;
-    Instrument *instrument;
-    using Ptr = ReferenceCountedObjectPtr<CachedMidiMessage>;
+    Instrument *instrument = nullptr;
+    FrozenAudio::Ptr audio;
+    CachedMidiSequence::Ptr sequence;
+};
+
+// Points to a message owned by one of the cached sequences,
+// so no messages are copied while iterating
+struct CachedMidiMessage final
+{
+    const MidiMessage *message = nullptr;
+    MidiMessageCollector *listener = nullptr;
+    Instrument *instrument = nullptr;
 };
 
 class ProjectSequences final
@@ -57,14 +67,44 @@ private:
     
     Array<Instrument *> uniqueInstruments;
     ReferenceCountedArray<CachedMidiSequence> sequences;
+    Array<FrozenTrack> frozenTracks;
+
+    // The iteration state is a min-heap of cursors, one for each sequence
+    // that still has messages ahead, ordered by the next message timestamp;
+    // it is owned by each copy, so that different threads could iterate over
+    // the same cached sequences independently (but not over the same copy)
+    struct Cursor final
+    {
+        double timeStamp;
+        int sequenceIndex;
+        int eventIndex;
+
+        // the heap's top is the earliest message, and for equal timestamps,
+        // the one from the first sequence, which keeps the merge order stable
+        static bool isLater(const Cursor &a, const Cursor &b) noexcept
+        {
+            return (a.timeStamp > b.timeStamp) ||
+                (a.timeStamp == b.timeStamp && a.sequenceIndex > b.sequenceIndex);
+        }
+    };
+
+    Array<Cursor> cursors;
+
+    // next message index in each sequence, used as a hint for seeking,
+    // so that seeking close to the current position (like restarting a loop)
+    // doesn't depend on the sequences length
+    Array<int> nextIndices;
 
 public:
     
     ProjectSequences() {}
     
     ProjectSequences(const ProjectSequences &other) :
+    uniqueInstruments(other.uniqueInstruments),
     sequences(other.sequences),
-    uniqueInstruments(other.uniqueInstruments) {}
+    frozenTracks(other.frozenTracks),
+    cursors(other.cursors),
+    nextIndices(other.nextIndices) {}
     
     inline Array<Instrument *> getUniqueInstruments() const noexcept
     {
@@ -81,18 +121,47 @@ public:
             this->sequences.add(newWrapper);
         }
     }
+
+    void addFrozenTrack(Instrument *instrument, FrozenAudio::Ptr audio,
+        CachedMidiSequence::Ptr sequence) noexcept
+    {
+        const SpinLock::ScopedLockType lock(this->sequencesLock);
+        this->uniqueInstruments.addIfNotAlreadyThere(instrument);
+        this->frozenTracks.add({ instrument, audio, sequence });
+    }
+
+    Array<FrozenTrack> getFrozenTracks() const
+    {
+        const SpinLock::ScopedLockType lock(this->sequencesLock);
+        return this->frozenTracks;
+    }
     
     inline void clear()
     {
         const SpinLock::ScopedLockType lock(this->sequencesLock);
         this->uniqueInstruments.clear();
         this->sequences.clear();
+        this->frozenTracks.clear();
+        this->cursors.clear();
+        this->nextIndices.clear();
     }
     
+    // Lets the owner build a new cache aside, and then replace the old one
+    // quickly, while the player threads might be copying it
+    inline void swapWith(ProjectSequences &other) noexcept
+    {
+        const SpinLock::ScopedLockType lock(this->sequencesLock);
+        this->uniqueInstruments.swapWith(other.uniqueInstruments);
+        this->sequences.swapWith(other.sequences);
+        this->frozenTracks.swapWith(other.frozenTracks);
+        this->cursors.swapWith(other.cursors);
+        this->nextIndices.swapWith(other.nextIndices);
+    }
+
     inline bool isEmpty() const
     {
         const SpinLock::ScopedLockType lock(this->sequencesLock);
-        return (this->sequences.size() == 0);
+        return (this->sequences.size() == 0 && this->frozenTracks.isEmpty());
     }
     
     double getSampleRate() const
@@ -105,7 +174,7 @@ public:
         const SpinLock::ScopedLockType lock(this->sequencesLock);
 
         // TODO: something more reasonable?
-        return this->sequences[0]->instrument->getProcessorGraph()->getSampleRate();
+        return this->uniqueInstruments.getFirst()->getProcessorGraph()->getSampleRate();
     }
 
     int getNumOutputChannels() const
@@ -116,7 +185,7 @@ public:
         const SpinLock::ScopedLockType lock(this->sequencesLock);
 
         // TODO: something more reasonable?
-        return this->sequences[0]->instrument->getProcessorGraph()->getTotalNumOutputChannels();
+        return this->uniqueInstruments.getFirst()->getProcessorGraph()->getTotalNumOutputChannels();
     }
 
     int getNumInputChannels() const
@@ -129,10 +198,12 @@ public:
         const SpinLock::ScopedLockType lock(this->sequencesLock);
 
         // TODO: something more reasonable?
-        return this->sequences[0]->instrument->getProcessorGraph()->getTotalNumInputChannels();
+        return this->uniqueInstruments.getFirst()->getProcessorGraph()->getTotalNumInputChannels();
     }
 
-    ReferenceCountedArray<CachedMidiSequence> getAllFor(const MidiSequence *midiTrack)
+    // the frozen tracks' sequences are only needed for probing the notes
+    ReferenceCountedArray<CachedMidiSequence> getAllFor(const MidiSequence *midiTrack,
+        bool includeFrozenTracks = false)
     {
         const SpinLock::ScopedLockType lock(this->sequencesLock);
 
@@ -145,84 +216,151 @@ public:
                 result.add(seq);
             }
         }
+
+        if (includeFrozenTracks)
+        {
+            for (const auto &frozenTrack : this->frozenTracks)
+            {
+                if (midiTrack == nullptr || midiTrack == frozenTrack.sequence->track)
+                {
+                    result.add(frozenTrack.sequence);
+                }
+            }
+        }
         
         return result;
     }
 
+    //===------------------------------------------------------------------===//
+    // Iterating over all messages in the timestamp order
+    //===------------------------------------------------------------------===//
+
     void seekToTime(double position)
     {
         const SpinLock::ScopedLockType lock(this->sequencesLock);
-        
+
+        if (this->nextIndices.size() != this->sequences.size())
+        {
+            this->nextIndices.clearQuick();
+            this->nextIndices.insertMultiple(0, 0, this->sequences.size());
+        }
+
+        this->cursors.clearQuick();
         for (int i = 0; i < this->sequences.size(); ++i)
         {
-            const auto wrapper = this->sequences.getUnchecked(i);
-            wrapper->currentIndex = this->getNextIndexAtTime(wrapper->midiMessages, (position - DBL_MIN));
+            const auto &midiMessages = this->sequences.getUnchecked(i)->midiMessages;
+            const int index = ProjectSequences::getNextIndexAtTime(midiMessages,
+                (position - DBL_MIN), this->nextIndices.getUnchecked(i));
+
+            this->nextIndices.setUnchecked(i, index);
+            if (index < midiMessages.getNumEvents())
+            {
+                const double timeStamp = midiMessages.getEventTime(index);
+                this->cursors.add({ timeStamp, i, index });
+            }
         }
+
+        std::make_heap(this->cursors.begin(), this->cursors.end(), Cursor::isLater);
     }
     
     void seekToZeroIndexes()
     {
-        const SpinLock::ScopedLockType lock(this->sequencesLock);
+        this->seekToTime(-DBL_MAX);
+    }
 
-        for (int i = 0; i < this->sequences.size(); ++i)
+    // Costs O(log(number of sequences)) per message, and doesn't copy anything:
+    // the returned message pointer is valid as long as this object exists
+    bool getNextMessage(CachedMidiMessage &target) noexcept
+    {
+        if (this->cursors.isEmpty())
+        {
+            return false;
+        }
+
+        std::pop_heap(this->cursors.begin(), this->cursors.end(), Cursor::isLater);
+        auto &cursor = this->cursors.getReference(this->cursors.size() - 1);
+
+        const auto *wrapper = this->sequences.getUnchecked(cursor.sequenceIndex);
+        target.message = &wrapper->midiMessages.getEventPointer(cursor.eventIndex)->message;
+        target.listener = wrapper->listener;
+        target.instrument = wrapper->instrument;
+
+        cursor.eventIndex++;
+        this->nextIndices.setUnchecked(cursor.sequenceIndex, cursor.eventIndex);
+
+        if (cursor.eventIndex < wrapper->midiMessages.getNumEvents())
         {
-            this->sequences.getUnchecked(i)->currentIndex = 0;
+            cursor.timeStamp = wrapper->midiMessages.getEventTime(cursor.eventIndex);
+            std::push_heap(this->cursors.begin(), this->cursors.end(), Cursor::isLater);
         }
+        else
+        {
+            this->cursors.removeLast();
+        }
+
+        return true;
     }
     
-    bool getNextMessage(CachedMidiMessage &target)
+private:
+    
+    // Finds the first message at or after the given timestamp: gallops from
+    // the hint position in the needed direction, and then does a binary search,
+    // so it costs O(log(distance from the hint)) instead of a linear scan
+    static int getNextIndexAtTime(const MidiMessageSequence &sequence,
+        double timeStamp, int hint) noexcept
     {
-        const SpinLock::ScopedLockType lock(this->sequencesLock);
+        const int numEvents = sequence.getNumEvents();
+        hint = jlimit(0, numEvents, hint);
 
-        double minTimeStamp = DBL_MAX;
-        int targetSequenceIndex = -1;
+        // the result is somewhere within [low, high]
+        int low = 0;
+        int high = numEvents;
 
-        for (int i = 0; i < this->sequences.size(); ++i)
+        if (hint < numEvents && sequence.getEventTime(hint) < timeStamp)
         {
-            const auto wrapper = this->sequences.getUnchecked(i);
-            if (wrapper->currentIndex < wrapper->midiMessages.getNumEvents())
+            low = hint + 1;
+            for (int step = 1; low + step - 1 < numEvents; step *= 2)
             {
-                MidiMessage &message = wrapper->midiMessages.getEventPointer(wrapper->currentIndex)->message;
-
-                if (message.getTimeStamp() < minTimeStamp)
+                const int probe = low + step - 1;
+                if (sequence.getEventTime(probe) >= timeStamp)
                 {
-                    minTimeStamp = message.getTimeStamp();
-                    targetSequenceIndex = i;
+                    high = probe;
+                    break;
                 }
+
+                low = probe + 1;
             }
         }
-
-        if (targetSequenceIndex < 0)
+        else
         {
-            return false;
-        }
+            high = hint;
+            for (int step = 1; high - step >= 0; step *= 2)
+            {
+                const int probe = high - step;
+                if (sequence.getEventTime(probe) < timeStamp)
+                {
+                    low = probe + 1;
+                    break;
+                }
 
-        const auto foundWrapper = this->sequences.getUnchecked(targetSequenceIndex);
-        MidiMessage &foundMessage = foundWrapper->midiMessages.getEventPointer(foundWrapper->currentIndex)->message;
-        foundWrapper->currentIndex++;
-                
-        target.message = foundMessage;
-        target.listener = foundWrapper->listener;
-        target.instrument = foundWrapper->instrument;
+                high = probe;
+            }
+        }
 
-        return true;
-    }
-    
-private:
-    
-    int getNextIndexAtTime(const MidiMessageSequence &sequence, double timeStamp) const
-    {
-        int i = 0;
-        for (; i < sequence.getNumEvents(); ++i)
+        while (low < high)
         {
-            const double eventTs = sequence.getEventPointer(i)->message.getTimeStamp();
-            if (eventTs >= timeStamp)
+            const int middle = low + (high - low) / 2;
+            if (sequence.getEventTime(middle) < timeStamp)
+            {
+                low = middle + 1;
+            }
+            else
             {
-                break;
+                high = middle;
             }
         }
-        
-        return i;
+
+        return low;
     }
 
     SpinLock instrumentsLock;
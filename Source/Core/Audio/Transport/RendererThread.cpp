@@ -17,6 +17,7 @@
 
 #include "Common.h"
 #include "RendererThread.h"
+#include "PlaybackTimeline.h"
 #include "Instrument.h"
 #include "SerializationKeys.h"
 #include "Workspace.h"
@@ -30,6 +31,7 @@ RendererThread::RendererThread(Transport &parentTrasport) :
 
 RendererThread::~RendererThread()
 {
+    this->cancelPendingUpdate();
     this->stop();
 }
 
@@ -39,67 +41,207 @@ float RendererThread::getPercentsComplete() const
     return this->percentsDone;
 }
 
-void RendererThread::startRecording(const File &file)
+LoudnessMeter::Report RendererThread::getLoudnessReport() const
+{
+    const ScopedReadLock lock(this->percentsLock);
+    return this->loudnessReport;
+}
+
+bool RendererThread::startRecording(const File &file, const Options &options, bool renderStems)
 {
     this->transport.recacheIfNeeded();
-    const ProjectSequences sequencesCache = this->transport.getPlaybackCache();
+    ProjectSequences sequencesCache = this->transport.getPlaybackCache();
     
     if (sequencesCache.isEmpty())
     {
-        return;
+        return false;
     }
 
     this->stop();
+    this->handleUpdateNowIfNeeded(); // let the cancelled freezing know, if any
 
-    double sampleRate = sequencesCache.getSampleRate();
-    int numChannels = sequencesCache.getNumOutputChannels();
+    const double sampleRate = sequencesCache.getSampleRate();
+    const int numChannels = sequencesCache.getNumOutputChannels();
+    this->options = options;
+    this->sequenceToFreeze = nullptr;
+    this->onFreezingFinished = nullptr;
 
-    // Create an OutputStream to write to our destination file...
-    file.deleteFile();
-    UniquePointer<FileOutputStream> fileStream(file.createOutputStream());
+    {
+        const ScopedWriteLock pl(this->percentsLock);
+        this->percentsDone = 0.f;
+        this->loudnessReport = {};
+    }
 
-    if (fileStream != nullptr)
+    if (!renderStems)
     {
+        const ScopedLock sl(this->writerLock);
+        this->writer.reset(createWriterFor(file, sampleRate, numChannels, options.bitDepth));
+
+        if (this->writer == nullptr)
         {
-            const ScopedWriteLock pl(this->percentsLock);
-            this->percentsDone = 0.f;
+            Logger::writeToLog("Failed to create a writer for " + file.getFullPathName());
+            return false;
         }
-        
-        // 16 bits per sample should be enough for anybody :)
-        // ..wanna fight about it? https://people.xiph.org/~xiphmont/demo/neil-young.html
-        const int bitDepth = 16;
 
-        if (file.getFileExtension().endsWithIgnoreCase("wav"))
+        DBG(file.getFullPathName());
+        this->sequencesToRender.swapWith(sequencesCache);
+        this->startThread(9);
+        return true;
+    }
+
+    // stems are named like "Song - Piano.wav", "Song - Piano (2).wav", etc
+    StringArray usedNames;
+    const ScopedLock sl(this->writerLock);
+
+    for (const auto *instrument : sequencesCache.getUniqueInstruments())
+    {
+        const String baseName = file.getFileNameWithoutExtension() + " - " + instrument->getName();
+        String stemName = File::createLegalFileName(baseName);
+        for (int i = 2; usedNames.contains(stemName, true); ++i)
         {
-            WavAudioFormat wavFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer.reset(wavFormat.createWriterFor(fileStream.release(), sampleRate, numChannels, bitDepth, {}, 0));
+            stemName = File::createLegalFileName(baseName + " (" + String(i) + ")");
         }
-        else if (file.getFileExtension().endsWithIgnoreCase("flac"))
+
+        usedNames.add(stemName);
+        const File stemFile(file.getSiblingFile(stemName + file.getFileExtension()));
+        if (auto *stemWriter = createWriterFor(stemFile, sampleRate, numChannels, options.bitDepth))
+        {
+            DBG(stemFile.getFullPathName());
+            this->stemWriters.add(stemWriter);
+            this->stemInstruments.add(instrument);
+        }
+        else
         {
-            FlacAudioFormat flacFormat;
-            const ScopedLock sl(this->writerLock);
-            this->writer.reset(flacFormat.createWriterFor(fileStream.release(), sampleRate, numChannels, bitDepth, {}, 0));
+            Logger::writeToLog("Failed to create a writer for " + stemFile.getFullPathName());
         }
+    }
 
-        if (writer != nullptr)
+    if (this->stemWriters.isEmpty())
+    {
+        return false;
+    }
+
+    this->sequencesToRender.swapWith(sequencesCache);
+    this->startThread(9);
+    return true;
+}
+
+void RendererThread::startFreezing(const File &file, const Options &options,
+    const MidiSequence *sequence, Function<void(bool)> onFinished)
+{
+    jassert(sequence != nullptr);
+    this->stop();
+    this->handleUpdateNowIfNeeded(); // let the cancelled freezing know, if any
+
+    this->options = options;
+    this->sequenceToFreeze = sequence;
+    this->onFreezingFinished = onFinished;
+    this->freezingSucceeded = 0;
+
+    this->transport.recacheIfNeeded();
+    ProjectSequences sequences(this->getSequencesToRender());
+
+    {
+        const ScopedWriteLock pl(this->percentsLock);
+        this->percentsDone = 0.f;
+        this->loudnessReport = {};
+    }
+
+    if (!sequences.isEmpty())
+    {
+        const ScopedLock sl(this->writerLock);
+        this->writer.reset(createWriterFor(file, sequences.getSampleRate(),
+            sequences.getNumOutputChannels(), options.bitDepth));
+
+        if (this->writer != nullptr)
         {
             DBG(file.getFullPathName());
+            this->sequencesToRender.swapWith(sequences);
             this->startThread(9);
+            return;
         }
     }
+
+    // nothing to render, still letting the caller know
+    this->triggerAsyncUpdate();
+}
+
+ProjectSequences RendererThread::getSequencesToRender() const
+{
+    if (this->sequenceToFreeze == nullptr)
+    {
+        return this->transport.getPlaybackCache();
+    }
+
+    ProjectSequences trackSequences;
+    for (auto *wrapper : this->transport.getPlaybackCache().getAllFor(this->sequenceToFreeze))
+    {
+        trackSequences.addWrapper(wrapper);
+    }
+
+    return trackSequences;
 }
 
+AudioFormatWriter *RendererThread::createWriterFor(const File &file,
+    double sampleRate, int numChannels, int bitDepth)
+{
+    // Create an OutputStream to write to our destination file...
+    file.deleteFile();
+    UniquePointer<FileOutputStream> fileStream(file.createOutputStream());
+
+    if (fileStream == nullptr)
+    {
+        return nullptr;
+    }
+
+    // 16 bits per sample should be enough for anybody :)
+    // ..wanna fight about it? https://people.xiph.org/~xiphmont/demo/neil-young.html
+    bitDepth = Options::getSupportedBitDepth(bitDepth);
+
+    if (file.getFileExtension().endsWithIgnoreCase("wav"))
+    {
+        WavAudioFormat wavFormat;
+        return wavFormat.createWriterFor(fileStream.release(), sampleRate, numChannels, bitDepth, {}, 0);
+    }
+    else if (file.getFileExtension().endsWithIgnoreCase("flac"))
+    {
+        // flac has no float samples
+        FlacAudioFormat flacFormat;
+        return flacFormat.createWriterFor(fileStream.release(), sampleRate, numChannels, jmin(bitDepth, 24), {}, 0);
+    }
+
+    return nullptr;
+}
+
+// The render loop checks for the exit between the blocks, and then prepares
+// the graphs for the device again, which can take a while for some plugins,
+// so the thread is only killed as the last resort, if a plugin hangs
+#define RENDER_STOP_TIMEOUT_MS 10000
+
 void RendererThread::stop()
 {
     if (this->isThreadRunning())
     {
-        this->stopThread(500);
+        this->stopThread(RENDER_STOP_TIMEOUT_MS);
     }
 
     {
         const ScopedLock sl(this->writerLock);
         this->writer = nullptr;
+        this->stemWriters.clear();
+        this->stemInstruments.clear();
+    }
+}
+
+void RendererThread::handleAsyncUpdate()
+{
+    if (this->onFreezingFinished != nullptr)
+    {
+        // the callback may start another freezing, so it's moved out first
+        auto callback = this->onFreezingFinished;
+        this->onFreezingFinished = nullptr;
+        this->sequenceToFreeze = nullptr;
+        callback(this->freezingSucceeded.get() != 0);
     }
 }
 
@@ -113,36 +255,257 @@ bool RendererThread::isRecording() const
 // Thread
 //===----------------------------------------------------------------------===//
 
+// Instruments render their audio in chunks of several blocks,
+// so that the workers don't have to sync after every single block
+#define RENDER_MIN_BLOCK_SIZE 64
+#define RENDER_MAX_BLOCK_SIZE 16384
+#define RENDER_MIN_CHUNK_SIZE 8192
+
+// The disk writer's ring buffer holds this many chunks
+#define RENDER_WRITER_NUM_CHUNKS 8
+
+// While waiting for the workers, the renderer checks if it should exit this often
+#define RENDER_WAIT_TIMEOUT_MS 50
+
+// The benchmark renders with 1, 2, 4, etc. threads, up to this number,
+// and then with the block sizes from this one up to the chunk size
+#define RENDER_BENCHMARK_MAX_THREADS 8
+#define RENDER_BENCHMARK_MIN_BLOCK_SIZE 256
+
 struct RenderBuffer final
 {
     Instrument *instrument;
     AudioSampleBuffer sampleBuffer;
     MidiBuffer midiBuffer;
+
+    int blockSize = 0;
+    int numBlocksPerChunk = 0;
+
+    // if the graph renders in double precision, its output is
+    // converted into the float sample buffer after every chunk
+    bool doublePrecision = false;
+    AudioBuffer<double> doubleSampleBuffer;
+
+    // the instrument's messages in the pre-merged timeline, if any
+    const PlaybackTimeline::Track *track = nullptr;
+    int nextEvent = 0;
+    int nextTempoEvent = 0;
+
+    // in stems mode, the instrument's output goes right to its own file
+    UniquePointer<AudioFormatWriter::ThreadedWriter> stemWriter;
+
+    // the frozen tracks' audio is read here before being added to the chunk
+    AudioSampleBuffer frozenAudioBuffer;
+
+    // stops between the blocks, if the rendering thread is asked to exit
+    void renderChunk(const PlaybackTimeline &timeline, double sampleRate,
+        int64 chunkStartFrame, const Thread &renderingThread)
+    {
+        const auto getFrame = [sampleRate](double timeSec)
+        {
+            return int64(timeSec * sampleRate + 0.5);
+        };
+
+        auto *graph = this->instrument->getProcessorGraph();
+        const auto &tempoEvents = timeline.getTempoEvents();
+
+        for (int block = 0; block < this->numBlocksPerChunk; ++block)
+        {
+            if (renderingThread.threadShouldExit())
+            {
+                return;
+            }
+
+            const int blockOffset = block * this->blockSize;
+            const int64 blockStartFrame = chunkStartFrame + blockOffset;
+            const int64 blockEndFrame = blockStartFrame + this->blockSize;
+
+            // tempo events are sent to everybody (need to do that for drum-machines)
+            while (this->nextTempoEvent < tempoEvents.size())
+            {
+                const auto &event = tempoEvents.getReference(this->nextTempoEvent);
+                const int64 eventFrame = getFrame(event.timeSec);
+                if (eventFrame >= blockEndFrame)
+                {
+                    break;
+                }
+
+                this->midiBuffer.addEvent(event.message, int(jmax(int64(0), eventFrame - blockStartFrame)));
+                this->nextTempoEvent++;
+            }
+
+            if (this->track != nullptr)
+            {
+                const auto &events = this->track->events;
+                while (this->nextEvent < events.size())
+                {
+                    const auto &event = events.getReference(this->nextEvent);
+                    const int64 eventFrame = getFrame(event.timeSec);
+                    if (eventFrame >= blockEndFrame)
+                    {
+                        break;
+                    }
+
+                    this->midiBuffer.addEvent(event.message, int(jmax(int64(0), eventFrame - blockStartFrame)));
+                    this->nextEvent++;
+                }
+            }
+
+            // process the block right within the chunk buffer
+            if (this->doublePrecision)
+            {
+                this->processBlock(*graph, this->doubleSampleBuffer, blockOffset);
+            }
+            else
+            {
+                this->processBlock(*graph, this->sampleBuffer, blockOffset);
+            }
+
+            this->midiBuffer.clear();
+        }
+
+        if (this->doublePrecision)
+        {
+            this->sampleBuffer.makeCopyOf(this->doubleSampleBuffer, true);
+        }
+
+        if (this->track != nullptr)
+        {
+            this->mixFrozenAudio(sampleRate, chunkStartFrame);
+        }
+    }
+
+    // the frozen audio always starts at the beginning of the project, as does the render
+    void mixFrozenAudio(double sampleRate, int64 chunkStartFrame)
+    {
+        const int numChannels = this->sampleBuffer.getNumChannels();
+        const int numSamples = this->sampleBuffer.getNumSamples();
+
+        for (const auto *audio : this->track->frozenAudio)
+        {
+            if (audio->getSampleRate() != sampleRate)
+            {
+                continue;
+            }
+
+            this->frozenAudioBuffer.setSize(numChannels, numSamples, false, false, true);
+            audio->readSamples(this->frozenAudioBuffer.getArrayOfWritePointers(),
+                numChannels, 0, numSamples, chunkStartFrame);
+
+            for (int i = 0; i < numChannels; ++i)
+            {
+                this->sampleBuffer.addFrom(i, 0, this->frozenAudioBuffer, i, 0, numSamples);
+            }
+        }
+    }
+
+    template <typename T>
+    void processBlock(AudioProcessorGraph &graph, AudioBuffer<T> &chunkBuffer, int blockOffset)
+    {
+        AudioBuffer<T> blockBuffer(chunkBuffer.getArrayOfWritePointers(),
+            chunkBuffer.getNumChannels(), blockOffset, this->blockSize);
+
+        blockBuffer.clear();
+
+        const ScopedLock lock(graph.getCallbackLock());
+        graph.processBlock(blockBuffer, this->midiBuffer);
+    }
+};
+
+// Renders its share of instruments chunk by chunk, when asked by the renderer thread
+class RenderWorker final : public Thread
+{
+public:
+
+    RenderWorker(const PlaybackTimeline &timeline, double sampleRate,
+        Atomic<int> &numPendingWorkers, WaitableEvent &chunkDone) :
+        Thread("RenderWorker"),
+        timeline(timeline),
+        sampleRate(sampleRate),
+        numPendingWorkers(numPendingWorkers),
+        chunkDone(chunkDone) {}
+
+    ~RenderWorker() override
+    {
+        this->stop();
+        this->stopThread(RENDER_STOP_TIMEOUT_MS);
+    }
+
+    Array<RenderBuffer *> buffers;
+
+    void renderChunk(int64 chunkStartFrame)
+    {
+        this->chunkStartFrame = chunkStartFrame;
+        this->chunkStart.signal();
+    }
+
+    // lets the current chunk stop after the block in progress
+    void stop()
+    {
+        this->signalThreadShouldExit();
+        this->chunkStart.signal();
+    }
+
+private:
+
+    void run() override
+    {
+        while (!this->threadShouldExit())
+        {
+            this->chunkStart.wait();
+
+            if (this->threadShouldExit())
+            {
+                return;
+            }
+
+            for (auto *buffer : this->buffers)
+            {
+                buffer->renderChunk(this->timeline, this->sampleRate, this->chunkStartFrame, *this);
+            }
+
+            if (--this->numPendingWorkers == 0)
+            {
+                this->chunkDone.signal();
+            }
+        }
+    }
+
+    const PlaybackTimeline &timeline;
+    const double sampleRate;
+
+    int64 chunkStartFrame = 0;
+    WaitableEvent chunkStart;
+
+    Atomic<int> &numPendingWorkers;
+    WaitableEvent &chunkDone;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderWorker)
 };
 
 void RendererThread::run()
 {
     // step 0. init.
-    this->transport.recacheIfNeeded();
-    ProjectSequences sequences = this->transport.getPlaybackCache();
-    const int bufferSize = 512;
+    // the sequences are captured on the message thread before starting,
+    // since the transport's caches are not to be touched from here
+    ProjectSequences sequences;
+    sequences.swapWith(this->sequencesToRender);
 
     // assuming that number of channels and sample rate is equal for all instruments
     const int numOutChannels = sequences.getNumOutputChannels();
     const int numInChannels = sequences.getNumInputChannels();
     const double sampleRate = sequences.getSampleRate();
     
-    double totalTimeMs = 0.0;
-    double tempoAtTheEndOfTrack = 0.0;
-    this->transport.calcTimeAndTempoAt(1.0, totalTimeMs, tempoAtTheEndOfTrack);
-    
-    double startTimeMs = 0.0;
-    double msPerQuarter = 0.0;
-    this->transport.calcTimeAndTempoAt(0.0, startTimeMs, msPerQuarter);
-    double secPerQuarter = msPerQuarter / 1000.0;
+    // all messages are merged here once, so that the render loop
+    // only has to stream each instrument's events linearly
+    const PlaybackTimeline::Ptr timeline(new PlaybackTimeline(sequences,
+        this->transport.getTempoMap(), 0.0, this->transport.getTotalTime(), false));
+
+    const int64 lastFrame = int64(timeline->getLengthSec() * sampleRate + 0.5);
 
-    double currentFrame = 0.0;
-    const double lastFrame = totalTimeMs / 1000.0 * sampleRate;
+    const int blockSize = jlimit(RENDER_MIN_BLOCK_SIZE, RENDER_MAX_BLOCK_SIZE, this->options.blockSize);
+    const int numBlocksPerChunk = jmax(1, RENDER_MIN_CHUNK_SIZE / blockSize);
+    const int chunkSize = blockSize * numBlocksPerChunk;
 
     // step 1. create a list of unique instruments with audio buffers for them.
     OwnedArray<RenderBuffer> subBuffers;
@@ -153,154 +516,344 @@ void RendererThread::run()
         Instrument *instrument = uniqueInstruments[i];
         auto *subBuffer = new RenderBuffer();
         subBuffer->instrument = instrument;
-        subBuffer->sampleBuffer = AudioSampleBuffer(numOutChannels, bufferSize);
+        subBuffer->sampleBuffer = AudioSampleBuffer(jmax(numInChannels, numOutChannels), chunkSize);
+        subBuffer->blockSize = blockSize;
+        subBuffer->numBlocksPerChunk = numBlocksPerChunk;
         subBuffers.add(subBuffer);
+
+        for (const auto *track : timeline->getTracks())
+        {
+            if (track->instrument == instrument)
+            {
+                subBuffer->track = track;
+                break;
+            }
+        }
         //DBG("Adding instrument: " + String(instrument->getName()));
     }
 
     // step 2. release resources, prepare to play, etc.
+    // the live callbacks of these instruments are suspended first,
+    // so that they don't process the graphs taken over by the renderer
     for (auto *subBuffer : subBuffers)
     {
+        subBuffer->instrument->getProcessorPlayer().setSuspended(true);
+
         AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
-        graph->setPlayConfigDetails(numInChannels, numOutChannels, sampleRate, bufferSize);
+        graph->setPlayConfigDetails(numInChannels, numOutChannels, sampleRate, blockSize);
         graph->releaseResources();
-        // TODO:
-        //graph->setProcessingPrecision(AudioProcessor::singlePrecision);
-        graph->prepareToPlay(graph->getSampleRate(), bufferSize);
+
+        // the graph converts the buffers itself for the nodes which only support floats
+        subBuffer->doublePrecision = this->options.doublePrecision &&
+            graph->supportsDoublePrecisionProcessing();
+
+        if (subBuffer->doublePrecision)
+        {
+            subBuffer->doubleSampleBuffer.setSize(subBuffer->sampleBuffer.getNumChannels(), chunkSize);
+            graph->setProcessingPrecision(AudioProcessor::doublePrecision);
+        }
+
+        graph->prepareToPlay(graph->getSampleRate(), blockSize);
         graph->setNonRealtime(true);
+        subBuffer->midiBuffer.ensureSize(2048);
     }
 
     // let processor graphs call handle their async updates
     Thread::sleep(200);
 
-    // step 3. render loop itself.
-    sequences.seekToTime(0.0);
-    
-    CachedMidiMessage nextMessage;
-    bool hasNextMessage = sequences.getNextMessage(nextMessage);
-    jassert(hasNextMessage);
-    
-    // TODO: add double precision rendering someday (for processor graphs who support it)
-    AudioSampleBuffer mixingBuffer(numOutChannels, bufferSize);
-    
-    double lastEventTick = 0.0;
-    double prevEventTimeStamp = 0.0;
-    double nextEventTickDelta = (nextMessage.message.getTimeStamp() - prevEventTimeStamp) * secPerQuarter;
-    double nextEventTick = lastEventTick + nextEventTickDelta;
+    // step 3. the disk writer thread drains the ring buffers,
+    // either the mixdown's one, or a ring buffer per stem
+    TimeSliceThread writerThread("RenderWriter");
+    writerThread.startThread(5);
 
-    int messageFrame = int((nextEventTick * sampleRate) - currentFrame);
+    UniquePointer<AudioFormatWriter::ThreadedWriter> threadedWriter;
 
-    // And here we go: send MidiStart
-    for (auto *subBuffer : subBuffers)
     {
-        subBuffer->midiBuffer.addEvent(MidiMessage::midiStart(), messageFrame);
+        const ScopedLock sl(this->writerLock);
+
+        if (this->writer != nullptr)
+        {
+            threadedWriter.reset(new AudioFormatWriter::ThreadedWriter(this->writer.release(),
+                writerThread, chunkSize * RENDER_WRITER_NUM_CHUNKS));
+        }
+
+        for (auto *subBuffer : subBuffers)
+        {
+            const int stemIndex = this->stemInstruments.indexOf(subBuffer->instrument);
+            if (stemIndex >= 0)
+            {
+                subBuffer->stemWriter.reset(new AudioFormatWriter::ThreadedWriter(
+                    this->stemWriters.removeAndReturn(stemIndex),
+                    writerThread, chunkSize * RENDER_WRITER_NUM_CHUNKS));
+                this->stemInstruments.remove(stemIndex);
+            }
+        }
     }
 
-    while (currentFrame < lastFrame)
+    // passes the rendered chunk to the writer thread,
+    // waiting for it to free some space in the ring buffer, if needed
+    const auto writeChunk = [this](AudioFormatWriter::ThreadedWriter &chunkWriter,
+        const AudioSampleBuffer &chunk, int numSamples)
     {
-        if (this->threadShouldExit())
+        while (!chunkWriter.write(chunk.getArrayOfReadPointers(), numSamples))
         {
-            break;
+            if (this->threadShouldExit())
+            {
+                return;
+            }
+
+            Thread::sleep(1);
         }
-        
-        // step 3a. fill up the midi buffers.
-        while (hasNextMessage &&
-               ( (nextEventTick * sampleRate) >= currentFrame &&
-                 (nextEventTick * sampleRate) < (currentFrame + bufferSize) ))
+    };
+
+    AudioSampleBuffer mixingBuffer(numOutChannels, chunkSize);
+
+    // the mixdown is always measured, even if only the stems are written
+    LoudnessMeter loudnessMeter;
+    loudnessMeter.prepare(sampleRate, numOutChannels);
+
+    const auto writeRenderedChunk = [&](int numSamplesToWrite)
+    {
+        // step 4b. write the stems, if any.
+        for (auto *subBuffer : subBuffers)
         {
-            messageFrame = int((nextEventTick * sampleRate) - currentFrame);
+            if (subBuffer->stemWriter != nullptr)
+            {
+                writeChunk(*subBuffer->stemWriter, subBuffer->sampleBuffer, numSamplesToWrite);
+            }
+        }
 
-            if (nextMessage.message.isTempoMetaEvent())
+        // step 4c. mix them down to the render buffer, measure and write the mixdown.
+        mixingBuffer.clear();
+
+        for (auto *subBuffer : subBuffers)
+        {
+            for (int j = 0; j < numOutChannels; ++j)
             {
-                secPerQuarter = nextMessage.message.getTempoSecondsPerQuarterNote();
+                FloatVectorOperations::add(mixingBuffer.getWritePointer(j),
+                    subBuffer->sampleBuffer.getReadPointer(j), numSamplesToWrite);
+            }
+        }
 
-                // Sends this to everybody (need to do that for drum-machines) - TODO test
-                for (auto subBuffer : subBuffers)
-                {
-                    subBuffer->midiBuffer.addEvent(nextMessage.message, messageFrame);
-                }
+        loudnessMeter.process(mixingBuffer, 0, numSamplesToWrite);
+
+        if (threadedWriter != nullptr)
+        {
+            writeChunk(*threadedWriter, mixingBuffer, numSamplesToWrite);
+        }
+    };
+
+    // step 4. render the whole timeline, distributing the instruments among the threads:
+    // the first share is rendered by this thread, the others by worker threads;
+    // returns the number of frames rendered, which is less than the length if cancelled
+    const auto renderAll = [&](int numThreads, bool writeOutput) -> int64
+    {
+        Atomic<int> numPendingWorkers;
+        WaitableEvent chunkDone;
+        OwnedArray<RenderWorker> workers;
+        Array<RenderBuffer *> ownBuffers;
+
+        for (int i = 1; i < numThreads; ++i)
+        {
+            workers.add(new RenderWorker(*timeline, sampleRate, numPendingWorkers, chunkDone));
+        }
+
+        for (int i = 0; i < subBuffers.size(); ++i)
+        {
+            auto *subBuffer = subBuffers.getUnchecked(i);
+            subBuffer->nextEvent = 0;
+            subBuffer->nextTempoEvent = 0;
+
+            // And here we go: send MidiStart
+            subBuffer->midiBuffer.clear();
+            subBuffer->midiBuffer.addEvent(MidiMessage::midiStart(), 0);
+
+            const int threadIndex = i % numThreads;
+            if (threadIndex == 0)
+            {
+                ownBuffers.add(subBuffer);
             }
             else
             {
-                for (auto *subBuffer : subBuffers)
+                workers.getUnchecked(threadIndex - 1)->buffers.add(subBuffer);
+            }
+        }
+
+        for (auto *worker : workers)
+        {
+            worker->startThread(9);
+        }
+
+        int64 currentFrame = 0;
+
+        while (currentFrame < lastFrame)
+        {
+            if (this->threadShouldExit())
+            {
+                break;
+            }
+
+            // step 4a. render all instruments' chunks in parallel
+            numPendingWorkers = workers.size();
+            for (auto *worker : workers)
+            {
+                worker->renderChunk(currentFrame);
+            }
+
+            for (auto *subBuffer : ownBuffers)
+            {
+                subBuffer->renderChunk(*timeline, sampleRate, currentFrame, *this);
+            }
+
+            // the workers check for the exit between the blocks, so they finish soon
+            // after being stopped, and they are never killed while processing a graph
+            while (workers.size() > 0 && !chunkDone.wait(RENDER_WAIT_TIMEOUT_MS))
+            {
+                if (this->threadShouldExit())
                 {
-                    if (nextMessage.instrument == subBuffer->instrument)
+                    bool hasRunningWorkers = false;
+                    for (auto *worker : workers)
+                    {
+                        worker->stop();
+                        hasRunningWorkers = hasRunningWorkers || worker->isThreadRunning();
+                    }
+
+                    if (!hasRunningWorkers)
                     {
-                        //DBG("Adding message with frame " + String(messageFrame));
-                        subBuffer->midiBuffer.addEvent(nextMessage.message, messageFrame);
+                        break;
                     }
                 }
             }
 
-            lastEventTick += nextEventTickDelta;
-            prevEventTimeStamp = nextMessage.message.getTimeStamp();
-            
-            hasNextMessage = sequences.getNextMessage(nextMessage);
-            nextEventTickDelta = (nextMessage.message.getTimeStamp() - prevEventTimeStamp) * secPerQuarter;
-            nextEventTick = lastEventTick + nextEventTickDelta;
-        }
+            // the chunk might be incomplete
+            if (this->threadShouldExit())
+            {
+                break;
+            }
 
-        // step 3b. call processBlock for every instrument.
-        for (auto subBuffer : subBuffers)
-        {
-            AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
+            if (writeOutput)
             {
-                const ScopedLock lock(graph->getCallbackLock());
-                
-                //DBG("processBlock num midi events: " + String(subBuffer->midiBuffer.getNumEvents()));
-                graph->processBlock(subBuffer->sampleBuffer, subBuffer->midiBuffer);
-                subBuffer->midiBuffer.clear();
+                writeRenderedChunk(int(jmin(int64(chunkSize), lastFrame - currentFrame)));
+            }
+
+            // step 4d. finally, update counters.
+            currentFrame += chunkSize;
 
-                //Thread::yield();
+            if (writeOutput)
+            {
+                const ScopedWriteLock pl(this->percentsLock);
+                this->percentsDone = float(double(currentFrame) / double(lastFrame));
             }
         }
 
-        // step 3c. mix them down to the render buffer.
-        mixingBuffer.clear();
+        return jmin(currentFrame, lastFrame);
+    };
 
-        for (auto subBuffer : subBuffers)
+    const int numThreads = jlimit(1, jmax(1, subBuffers.size()), SystemStats::getNumCpus());
+
+    const auto benchmarkPass = [&](int numPassThreads, int passBlockSize)
+    {
+        const double passStartTime = Time::getMillisecondCounterHiRes();
+        const int64 numFramesRendered = renderAll(numPassThreads, false);
+        const double passTimeMs = Time::getMillisecondCounterHiRes() - passStartTime;
+        if (this->threadShouldExit())
         {
-            for (int j = 0; j < numOutChannels; ++j)
-            {
-                mixingBuffer.addFrom(j, 0,
-                    subBuffer->sampleBuffer, j, 0,
-                    bufferSize,
-                    1.0f);
-            }
+            return false;
         }
 
-        // step 3d. write resulting buffer to disk.
+        Logger::writeToLog("Render benchmark: block size " + String(passBlockSize) + ", " +
+            String(numPassThreads) + " thread(s), " + String(subBuffers.size()) + " instrument(s), " +
+            String(numFramesRendered) + " frames in " + String(passTimeMs, 1) + " ms, " +
+            String(double(numFramesRendered) * 1000.0 / sampleRate / jmax(1.0, passTimeMs), 1) + "x realtime");
+
+        // clears the tails left after the previous pass
+        for (auto *subBuffer : subBuffers)
         {
-            const ScopedLock sl(this->writerLock);
-            bool writedSuccessfullty = false;
-            
-            while (! writedSuccessfullty)
-            {
-                writedSuccessfullty =
-                this->writer->writeFromAudioSampleBuffer(mixingBuffer, 0, mixingBuffer.getNumSamples());
-            }
+            subBuffer->instrument->getProcessorGraph()->reset();
+        }
+
+        return true;
+    };
+
+    // the graphs are prepared again for each block size the benchmark tries
+    const auto prepareForBlockSize = [&](int newBlockSize)
+    {
+        for (auto *subBuffer : subBuffers)
+        {
+            subBuffer->blockSize = newBlockSize;
+            subBuffer->numBlocksPerChunk = chunkSize / newBlockSize;
+
+            AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
+            graph->releaseResources();
+            graph->setPlayConfigDetails(numInChannels, numOutChannels, sampleRate, newBlockSize);
+            graph->prepareToPlay(sampleRate, newBlockSize);
+            graph->setNonRealtime(true);
         }
+    };
 
-        // step 3e. finally, update counters.
-        currentFrame += bufferSize;
+    // the timing harness: renders the timeline without writing anything,
+    // first with 1, 2, 4 and 8 threads, then with the different block sizes,
+    // and logs how long each pass took, so that the scaling and the per-block
+    // overhead of the plugins can be compared on the real projects
+    if (this->options.benchmark)
+    {
+        bool benchmarkCompleted = true;
+        for (int n = 1; n <= RENDER_BENCHMARK_MAX_THREADS && benchmarkCompleted; n *= 2)
+        {
+            benchmarkCompleted = benchmarkPass(n, blockSize);
+        }
 
+        // only the sizes the chunk can be split into
+        for (int size = RENDER_BENCHMARK_MIN_BLOCK_SIZE; size <= chunkSize && benchmarkCompleted; size *= 2)
         {
-            const ScopedWriteLock pl(this->percentsLock);
-            this->percentsDone = float(currentFrame / lastFrame);
-            //DBG("this->percentsDone : " + String(this->percentsDone));
+            if (chunkSize % size == 0)
+            {
+                prepareForBlockSize(size);
+                benchmarkCompleted = benchmarkPass(numThreads, size);
+            }
         }
+
+        prepareForBlockSize(blockSize);
     }
+    const uint32 renderStartTime = Time::getMillisecondCounter();
+    const int64 numFramesRendered = renderAll(numThreads, true);
 
-    // step 4. setNonRealtime false.
+    DBG("Rendered in " + String(Time::getMillisecondCounter() - renderStartTime) +
+        " ms using " + String(numThreads) + " thread(s), block size " + String(blockSize) +
+        (this->options.doublePrecision ? ", double precision" : ""));
+
+    {
+        const ScopedWriteLock pl(this->percentsLock);
+        this->loudnessReport = loudnessMeter.getReport();
+    }
+
+    // step 5. flush the writer, setNonRealtime false.
+    threadedWriter = nullptr;
+    for (auto *subBuffer : subBuffers)
+    {
+        subBuffer->stemWriter = nullptr;
+    }
+
+    writerThread.stopThread(1000);
+
+    // the frozen audio file is complete only if the whole track was rendered
+    if (this->sequenceToFreeze != nullptr)
+    {
+        this->freezingSucceeded = (numFramesRendered >= lastFrame) ? 1 : 0;
+        this->triggerAsyncUpdate();
+    }
+
+    // the graphs have been configured for the render's block size and precision,
+    // so each one is prepared again for the device settings, whatever the precision was,
+    // before its live callback is resumed; the graphs of a device which is not running
+    // stay released until it starts
     for (auto subBuffer : subBuffers)
     {
         AudioProcessorGraph *graph = subBuffer->instrument->getProcessorGraph();
         graph->setNonRealtime(false);
-    }
-    
-    {
-        const ScopedLock sl(this->writerLock);
-        this->writer = nullptr;
+        graph->releaseResources();
+        graph->setProcessingPrecision(AudioProcessor::singlePrecision);
+        subBuffer->instrument->getProcessorPlayer().setSuspended(false);
     }
 
     App::Workspace().getAudioCore().setAwake();
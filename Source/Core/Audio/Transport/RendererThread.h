@@ -18,17 +18,54 @@
 #pragma once
 
 #include "Transport.h"
+#include "LoudnessMeter.h"
 
-class RendererThread final : private Thread
+class RendererThread final : private Thread, private AsyncUpdater
 {
 public:
 
     explicit RendererThread(Transport &parentTrasport);
     ~RendererThread() override;
+
+    struct Options final
+    {
+        // larger blocks mean less per-block overhead in plugins,
+        // and offline renders don't care about latency anyway
+        int blockSize = 512;
+
+        // 16 or 24 bits integer, or 32 bits float (wav only)
+        int bitDepth = 16;
+
+        // the nearest of the bit depths above
+        static int getSupportedBitDepth(int bitDepth) noexcept
+        {
+            return bitDepth <= 16 ? 16 : (bitDepth <= 24 ? 24 : 32);
+        }
+
+        // only used by the graphs whose processors support it
+        bool doublePrecision = false;
+
+        // before rendering, measure the render time with 1, 2, 4 and 8 threads,
+        // and write the timings into the log
+        bool benchmark = false;
+    };
     
     float getPercentsComplete() const;
 
-    void startRecording(const File &file);
+    // the mixdown's loudness, measured in the same pass, and valid once the render is done
+    LoudnessMeter::Report getLoudnessReport() const;
+
+    // in stems mode, each instrument is rendered into its own file,
+    // named after the given file and the instrument, in a single pass;
+    // returns false if there's nothing to render or no file could be created
+    bool startRecording(const File &file, const Options &options, bool renderStems = false);
+
+    // renders a single track through its instrument (ignoring the other tracks)
+    // into a float wav file; the callback is called on the message thread,
+    // with false if the rendering was cancelled or has failed
+    void startFreezing(const File &file, const Options &options,
+        const MidiSequence *sequence, Function<void(bool)> onFinished);
+
     void stop();
     bool isRecording() const;
 
@@ -40,15 +77,40 @@ private:
 
     void run() override;
 
+    //===------------------------------------------------------------------===//
+    // AsyncUpdater
+    //===------------------------------------------------------------------===//
+
+    void handleAsyncUpdate() override;
+
 private:
 
+    ProjectSequences getSequencesToRender() const;
+
+    static AudioFormatWriter *createWriterFor(const File &file,
+        double sampleRate, int numChannels, int bitDepth);
+
     Transport &transport;
 
     CriticalSection writerLock;
     UniquePointer<AudioFormatWriter> writer;
+    Options options;
+
+    // stem writers, one per unique instrument
+    OwnedArray<AudioFormatWriter> stemWriters;
+    Array<const Instrument *> stemInstruments;
+
+    // taken by the thread when it starts
+    ProjectSequences sequencesToRender;
+
+    // in freezing mode, only this sequence is rendered
+    const MidiSequence *sequenceToFreeze = nullptr;
+    Function<void(bool)> onFreezingFinished;
+    Atomic<int> freezingSucceeded;
 
     ReadWriteLock percentsLock;
     float percentsDone;
+    LoudnessMeter::Report loudnessReport;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RendererThread)
 };
@@ -0,0 +1,136 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "TempoMap.h"
+
+// default 120 bpm (== 500 ms per quarter note)
+#define DEFAULT_MS_PER_QUARTER (500.0)
+
+TempoMap::TempoMap(const Array<MidiMessage> &tempoMessages)
+{
+    for (const auto &message : tempoMessages)
+    {
+        if (!message.isTempoMetaEvent())
+        {
+            continue;
+        }
+
+        const double position = message.getTimeStamp();
+        const double msPerQuarter = message.getTempoSecondsPerQuarterNote() * 1000.0;
+
+        if (this->segments.isEmpty())
+        {
+            this->segments.add({ position, position * msPerQuarter, msPerQuarter });
+            continue;
+        }
+
+        const auto &last = this->segments.getReference(this->segments.size() - 1);
+        jassert(position >= last.position);
+
+        const double timeMs = last.timeMs + (position - last.position) * last.msPerQuarter;
+        this->segments.add({ position, timeMs, msPerQuarter });
+    }
+}
+
+double TempoMap::getTimeMsAt(double position) const noexcept
+{
+    if (const auto *segment = this->findSegmentAtPosition(position))
+    {
+        return segment->timeMs + (position - segment->position) * segment->msPerQuarter;
+    }
+
+    return position * DEFAULT_MS_PER_QUARTER;
+}
+
+double TempoMap::getPositionAt(double timeMs) const noexcept
+{
+    if (const auto *segment = this->findSegmentAtTime(timeMs))
+    {
+        return segment->position + (timeMs - segment->timeMs) / segment->msPerQuarter;
+    }
+
+    return timeMs / DEFAULT_MS_PER_QUARTER;
+}
+
+double TempoMap::getTempoAt(double position) const noexcept
+{
+    if (const auto *segment = this->findSegmentAtPosition(position))
+    {
+        return segment->msPerQuarter;
+    }
+
+    return DEFAULT_MS_PER_QUARTER;
+}
+
+double TempoMap::getFirstTempo() const noexcept
+{
+    return this->segments.isEmpty() ? DEFAULT_MS_PER_QUARTER :
+        this->segments.getReference(0).msPerQuarter;
+}
+
+// Returns the last segment starting at or before the given position,
+// or the first segment, if the position is before all of them
+const TempoMap::Segment *TempoMap::findSegmentAtPosition(double position) const noexcept
+{
+    if (this->segments.isEmpty())
+    {
+        return nullptr;
+    }
+
+    int low = 0;
+    int high = this->segments.size();
+    while (high - low > 1)
+    {
+        const int mid = (low + high) / 2;
+        if (this->segments.getReference(mid).position <= position)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return &this->segments.getReference(low);
+}
+
+const TempoMap::Segment *TempoMap::findSegmentAtTime(double timeMs) const noexcept
+{
+    if (this->segments.isEmpty())
+    {
+        return nullptr;
+    }
+
+    int low = 0;
+    int high = this->segments.size();
+    while (high - low > 1)
+    {
+        const int mid = (low + high) / 2;
+        if (this->segments.getReference(mid).timeMs <= timeMs)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return &this->segments.getReference(low);
+}
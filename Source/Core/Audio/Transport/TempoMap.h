@@ -0,0 +1,62 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// An index of tempo changes with prefix-summed times, which makes conversions
+// between the playback cache time units (beats) and milliseconds a binary search.
+//
+// Tempo curves are already sampled into constant steps, when the tempo track
+// is exported (see CURVE_INTERPOLATION_STEP_BEAT), so the map uses exactly
+// the same tempo messages as the playback, and within each segment
+// the conversion is linear. The first tempo event also sets the tempo
+// all the way before it.
+
+class TempoMap final : public ReferenceCountedObject
+{
+public:
+
+    TempoMap() = default;
+
+    // Expects messages sorted by timestamp, all non-tempo messages are skipped
+    explicit TempoMap(const Array<MidiMessage> &tempoMessages);
+
+    double getTimeMsAt(double position) const noexcept;
+    double getPositionAt(double timeMs) const noexcept;
+
+    // Returns milliseconds per quarter note
+    double getTempoAt(double position) const noexcept;
+    double getFirstTempo() const noexcept;
+
+    using Ptr = ReferenceCountedObjectPtr<TempoMap>;
+
+private:
+
+    struct Segment final
+    {
+        double position;
+        double timeMs;
+        double msPerQuarter;
+    };
+
+    const Segment *findSegmentAtPosition(double position) const noexcept;
+    const Segment *findSegmentAtTime(double timeMs) const noexcept;
+
+    Array<Segment> segments;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TempoMap)
+};
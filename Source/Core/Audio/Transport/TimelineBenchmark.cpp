@@ -0,0 +1,505 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "TimelineBenchmark.h"
+#include "TimelineDispatcher.h"
+#include "PlaybackTimeline.h"
+#include "Instrument.h"
+#include "SerializationKeys.h"
+
+#define TIMELINE_BENCHMARK_SAMPLE_RATE 44100.0
+#define TIMELINE_BENCHMARK_BLOCK_SIZE 512
+#define TIMELINE_BENCHMARK_NUM_NOTES 200
+
+// the timeline uses the default tempo, 120 bpm
+#define TIMELINE_BENCHMARK_MS_PER_QUARTER 500.0
+
+// The device runs for a while before the playback starts and after it ends,
+// so that the last messages sent by the thread-based player are picked up too
+#define TIMELINE_BENCHMARK_LEAD_IN_MS 250
+#define TIMELINE_BENCHMARK_TAIL_MS 250
+
+const String TimelineBenchmark::argument = "--timeline-benchmark";
+
+//===----------------------------------------------------------------------===//
+// Simulated device
+//===----------------------------------------------------------------------===//
+
+// Wakes up on the block grid, like the real devices do, and calls the callbacks
+// in the same order as the device manager would; block k is assumed to be heard
+// exactly at k * block duration since the start, so the onset errors only come
+// from where the messages have been placed within the blocks
+class TimelineBenchmarkDevice final : public AudioIODevice, private Thread
+{
+public:
+
+    explicit TimelineBenchmarkDevice(const Array<AudioIODeviceCallback *> &callbacks) :
+        AudioIODevice("Timeline Benchmark", "Benchmark"),
+        Thread("TimelineBenchmarkDevice"),
+        callbacks(callbacks) {}
+
+    ~TimelineBenchmarkDevice() override
+    {
+        this->stop();
+    }
+
+    StringArray getOutputChannelNames() override { return { "Left", "Right" }; }
+    StringArray getInputChannelNames() override { return {}; }
+    Array<double> getAvailableSampleRates() override { return { TIMELINE_BENCHMARK_SAMPLE_RATE }; }
+    Array<int> getAvailableBufferSizes() override { return { TIMELINE_BENCHMARK_BLOCK_SIZE }; }
+    int getDefaultBufferSize() override { return TIMELINE_BENCHMARK_BLOCK_SIZE; }
+
+    String open(const BigInteger &, const BigInteger &, double, int) override { return {}; }
+    void close() override {}
+    bool isOpen() override { return true; }
+
+    void start(AudioIODeviceCallback *) override
+    {
+        for (auto *callback : this->callbacks)
+        {
+            callback->audioDeviceAboutToStart(this);
+        }
+
+        this->startThread(10);
+    }
+
+    void stop() override
+    {
+        if (this->isThreadRunning())
+        {
+            this->stopThread(1000);
+
+            for (auto *callback : this->callbacks)
+            {
+                callback->audioDeviceStopped();
+            }
+        }
+    }
+
+    bool isPlaying() override { return this->isThreadRunning(); }
+    String getLastError() override { return {}; }
+
+    int getCurrentBufferSizeSamples() override { return TIMELINE_BENCHMARK_BLOCK_SIZE; }
+    double getCurrentSampleRate() override { return TIMELINE_BENCHMARK_SAMPLE_RATE; }
+    int getCurrentBitDepth() override { return 32; }
+
+    BigInteger getActiveOutputChannels() const override
+    {
+        BigInteger channels;
+        channels.setRange(0, 2, true);
+        return channels;
+    }
+
+    BigInteger getActiveInputChannels() const override { return {}; }
+    int getOutputLatencyInSamples() override { return 0; }
+    int getInputLatencyInSamples() override { return 0; }
+
+private:
+
+    void run() override
+    {
+        AudioBuffer<float> output(2, TIMELINE_BENCHMARK_BLOCK_SIZE);
+        const double blockDurationMs = 1000.0 * TIMELINE_BENCHMARK_BLOCK_SIZE / TIMELINE_BENCHMARK_SAMPLE_RATE;
+        const double startTimeMs = Time::getMillisecondCounterHiRes();
+
+        for (int64 block = 0; !this->threadShouldExit(); ++block)
+        {
+            // sleeps most of the time, and then yields until the block is due;
+            // a late block is still processed, as if the device had waited for it
+            const double blockTimeMs = startTimeMs + double(block) * blockDurationMs;
+            for (double timeLeftMs = blockTimeMs - Time::getMillisecondCounterHiRes(); timeLeftMs > 0.0;
+                timeLeftMs = blockTimeMs - Time::getMillisecondCounterHiRes())
+            {
+                if (timeLeftMs > 2.0)
+                {
+                    Thread::sleep(int(timeLeftMs) - 1);
+                }
+                else
+                {
+                    Thread::yield();
+                }
+            }
+
+            for (auto *callback : this->callbacks)
+            {
+                callback->audioDeviceIOCallback(nullptr, 0,
+                    output.getArrayOfWritePointers(), 2, TIMELINE_BENCHMARK_BLOCK_SIZE);
+            }
+        }
+    }
+
+    const Array<AudioIODeviceCallback *> callbacks;
+
+    JUCE_DECLARE_NON_COPYABLE(TimelineBenchmarkDevice)
+};
+
+//===----------------------------------------------------------------------===//
+// Recorder
+//===----------------------------------------------------------------------===//
+
+// Takes the place of the instrument's graph, and remembers where the notes
+// have landed, in samples since the device has started;
+// the onsets are only to be read when the device is stopped
+class TimelineBenchmarkRecorder final : public AudioProcessor
+{
+public:
+
+    TimelineBenchmarkRecorder() :
+        AudioProcessor(BusesProperties().withOutput("Output", AudioChannelSet::stereo()))
+    {
+        this->onsets.ensureStorageAllocated(TIMELINE_BENCHMARK_NUM_NOTES);
+    }
+
+    const Array<int64> &getOnsets() const noexcept
+    {
+        return this->onsets;
+    }
+
+    const String getName() const override { return "Timeline Benchmark"; }
+
+    // called each time the device starts
+    void prepareToPlay(double, int) override
+    {
+        this->onsets.clearQuick();
+        this->numSamplesProcessed = 0;
+    }
+
+    void releaseResources() override {}
+
+    void processBlock(AudioBuffer<float> &buffer, MidiBuffer &midiMessages) override
+    {
+        MidiBuffer::Iterator it(midiMessages);
+        MidiMessage message;
+        int samplePosition;
+
+        while (it.getNextEvent(message, samplePosition))
+        {
+            // never reallocates on the audio thread
+            if (message.isNoteOn() && this->onsets.size() < TIMELINE_BENCHMARK_NUM_NOTES)
+            {
+                this->onsets.add(this->numSamplesProcessed + samplePosition);
+            }
+        }
+
+        this->numSamplesProcessed += buffer.getNumSamples();
+    }
+
+    double getTailLengthSeconds() const override { return 0.0; }
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+
+    AudioProcessorEditor *createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const String &) override {}
+
+    void getStateInformation(MemoryBlock &) override {}
+    void setStateInformation(const void *, int) override {}
+
+private:
+
+    Array<int64> onsets;
+    int64 numSamplesProcessed = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(TimelineBenchmarkRecorder)
+};
+
+//===----------------------------------------------------------------------===//
+// Players
+//===----------------------------------------------------------------------===//
+
+// The thread-based player, as it used to work: it waits for each next event,
+// counting the delay from the previous one in whole milliseconds,
+// and sends it to the instrument's message collector, stamped with the time
+// it has woken up at, so that the collector places it within the next block
+class TimelineBenchmarkThreadPlayer final : public Thread
+{
+public:
+
+    explicit TimelineBenchmarkThreadPlayer(const PlaybackTimeline::Track &track) :
+        Thread("TimelineBenchmarkThreadPlayer"),
+        track(track) {}
+
+    ~TimelineBenchmarkThreadPlayer() override
+    {
+        this->stopThread(1000);
+    }
+
+    void run() override
+    {
+        auto &collector = this->track.instrument->getProcessorPlayer().getMidiMessageCollector();
+
+        double previousTimeSec = 0.0;
+        for (const auto &event : this->track.events)
+        {
+            const double delayMs = (event.timeSec - previousTimeSec) * 1000.0;
+            previousTimeSec = event.timeSec;
+
+            if (uint32(delayMs) != 0)
+            {
+                Time::waitForMillisecondCounter(Time::getMillisecondCounter() + uint32(delayMs));
+            }
+
+            if (this->threadShouldExit())
+            {
+                return;
+            }
+
+            collector.addMessageToQueue(MidiMessage(event.message,
+                Time::getMillisecondCounterHiRes() * 0.001));
+        }
+    }
+
+private:
+
+    const PlaybackTimeline::Track &track;
+
+    JUCE_DECLARE_NON_COPYABLE(TimelineBenchmarkThreadPlayer)
+};
+
+// Keeps one core busy, to see how the players behave on a loaded system
+class TimelineBenchmarkLoad final : public Thread
+{
+public:
+
+    TimelineBenchmarkLoad() : Thread("TimelineBenchmarkLoad") {}
+
+    ~TimelineBenchmarkLoad() override
+    {
+        this->stopThread(1000);
+    }
+
+    void run() override
+    {
+        while (!this->threadShouldExit()) {}
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(TimelineBenchmarkLoad)
+};
+
+//===----------------------------------------------------------------------===//
+// Results
+//===----------------------------------------------------------------------===//
+
+struct TimelineBenchmarkResult final
+{
+    int numOnsets = 0;
+    double intervalErrorSdMs = 0.0;
+    double intervalErrorMaxMs = 0.0;
+    double onsetErrorMaxMs = 0.0;
+    double driftMs = 0.0;
+
+    // Both the onsets and the expected times are aligned at the first note,
+    // so that the constant latency is not counted as an error
+    static TimelineBenchmarkResult compute(const Array<int64> &onsets,
+        const Array<double> &expectedTimesSec)
+    {
+        TimelineBenchmarkResult result;
+        result.numOnsets = onsets.size();
+
+        const int numNotes = jmin(onsets.size(), expectedTimesSec.size());
+        if (numNotes < 2)
+        {
+            return result;
+        }
+
+        Array<double> intervalErrors;
+        double previousErrorMs = 0.0;
+        for (int i = 1; i < numNotes; ++i)
+        {
+            const double onsetMs = double(onsets[i] - onsets[0]) * 1000.0 / TIMELINE_BENCHMARK_SAMPLE_RATE;
+            const double expectedMs = (expectedTimesSec[i] - expectedTimesSec[0]) * 1000.0;
+            const double errorMs = onsetMs - expectedMs;
+
+            intervalErrors.add(errorMs - previousErrorMs);
+            result.intervalErrorMaxMs = jmax(result.intervalErrorMaxMs, std::abs(errorMs - previousErrorMs));
+            result.onsetErrorMaxMs = jmax(result.onsetErrorMaxMs, std::abs(errorMs));
+            result.driftMs = errorMs;
+            previousErrorMs = errorMs;
+        }
+
+        double mean = 0.0;
+        for (const auto error : intervalErrors)
+        {
+            mean += error / intervalErrors.size();
+        }
+
+        double variance = 0.0;
+        for (const auto error : intervalErrors)
+        {
+            variance += (error - mean) * (error - mean) / intervalErrors.size();
+        }
+
+        result.intervalErrorSdMs = std::sqrt(variance);
+        return result;
+    }
+
+    var toVar() const
+    {
+        namespace Keys = Serialization::Benchmarks;
+        DynamicObject::Ptr data(new DynamicObject());
+        data->setProperty(Keys::numOnsets, this->numOnsets);
+        data->setProperty(Keys::intervalErrorSdMs, this->intervalErrorSdMs);
+        data->setProperty(Keys::intervalErrorMaxMs, this->intervalErrorMaxMs);
+        data->setProperty(Keys::onsetErrorMaxMs, this->onsetErrorMaxMs);
+        data->setProperty(Keys::driftMs, this->driftMs);
+        return var(data.get());
+    }
+
+    String toString() const
+    {
+        return String(this->numOnsets) + " onsets, interval error sd " +
+            String(this->intervalErrorSdMs, 3) + " ms, max " +
+            String(this->intervalErrorMaxMs, 3) + " ms, onset error max " +
+            String(this->onsetErrorMaxMs, 3) + " ms, drift " +
+            String(this->driftMs, 3) + " ms";
+    }
+};
+
+//===----------------------------------------------------------------------===//
+// Benchmark
+//===----------------------------------------------------------------------===//
+
+var TimelineBenchmark::run()
+{
+    // the recorder is released by the instrument, so it needs to outlive it
+    TimelineBenchmarkRecorder recorder;
+    AudioPluginFormatManager formatManager;
+    Instrument instrument(formatManager, "Timeline Benchmark");
+    instrument.getProcessorPlayer().setProcessor(&recorder);
+    instrument.getProcessorPlayer().setCanSleep(false);
+
+    TimelineDispatcher dispatcher;
+
+    // the dispatcher goes first, just like in AudioCore
+    Array<AudioIODeviceCallback *> callbacks;
+    callbacks.add(&dispatcher);
+    callbacks.add(&instrument.getProcessorPlayer());
+    TimelineBenchmarkDevice device(callbacks);
+
+    const auto playAndRecord = [&device, &recorder](const Function<void()> &startPlayback,
+        const Function<bool()> &isPlaying) -> Array<int64>
+    {
+        device.start(nullptr);
+        Thread::sleep(TIMELINE_BENCHMARK_LEAD_IN_MS);
+
+        startPlayback();
+        while (isPlaying())
+        {
+            Thread::sleep(50);
+        }
+
+        Thread::sleep(TIMELINE_BENCHMARK_TAIL_MS);
+        device.stop();
+
+        return recorder.getOnsets();
+    };
+
+    const double stepsMs[] = { 50.0, 62.5 };
+    const int numCpus = SystemStats::getNumCpus();
+
+    Array<var> scenarios;
+    for (const auto stepMs : stepsMs)
+    {
+        for (const int numLoadThreads : { 0, numCpus })
+        {
+            // a steady stream of short notes, starting one step after the playback
+            const double stepBeats = stepMs / TIMELINE_BENCHMARK_MS_PER_QUARTER;
+            const auto sequence = CachedMidiSequence::createFrom(&instrument);
+            for (int i = 1; i <= TIMELINE_BENCHMARK_NUM_NOTES; ++i)
+            {
+                const int key = 60 + i % 12;
+                sequence->midiMessages.addEvent(MidiMessage::noteOn(1, key, 0.8f).withTimeStamp(i * stepBeats));
+                sequence->midiMessages.addEvent(MidiMessage::noteOff(1, key).withTimeStamp((i + 0.5) * stepBeats));
+            }
+
+            sequence->midiMessages.updateMatchedPairs();
+
+            ProjectSequences sequences;
+            sequences.addWrapper(sequence);
+
+            const double endBeat = (TIMELINE_BENCHMARK_NUM_NOTES + 1) * stepBeats;
+            PlaybackTimeline::Ptr timeline(new PlaybackTimeline(sequences,
+                TempoMap::Ptr(new TempoMap()), 0.0, endBeat, false));
+
+            const auto &track = *timeline->getTracks().getFirst();
+
+            Array<double> expectedTimesSec;
+            for (const auto &event : track.events)
+            {
+                if (event.message.isNoteOn())
+                {
+                    expectedTimesSec.add(event.timeSec);
+                }
+            }
+
+            OwnedArray<TimelineBenchmarkLoad> loadThreads;
+            for (int i = 0; i < numLoadThreads; ++i)
+            {
+                loadThreads.add(new TimelineBenchmarkLoad())->startThread();
+            }
+
+            const auto dispatcherOnsets = playAndRecord(
+                [&]() { dispatcher.startPlayback(timeline); },
+                [&]() { return dispatcher.isPlaying(timeline.get()); });
+
+            dispatcher.stopPlayback();
+
+            // the same priority the player thread used to have
+            TimelineBenchmarkThreadPlayer threadPlayer(track);
+            const auto threadPlayerOnsets = playAndRecord(
+                [&]() { threadPlayer.startThread(10); },
+                [&]() { return threadPlayer.isThreadRunning(); });
+
+            loadThreads.clear();
+
+            const auto dispatcherResult =
+                TimelineBenchmarkResult::compute(dispatcherOnsets, expectedTimesSec);
+
+            const auto threadPlayerResult =
+                TimelineBenchmarkResult::compute(threadPlayerOnsets, expectedTimesSec);
+
+            Logger::writeToLog("Timeline benchmark: " + String(stepMs, 1) + " ms steps, " +
+                String(numLoadThreads) + " load thread(s), dispatcher: " + dispatcherResult.toString());
+
+            Logger::writeToLog("Timeline benchmark: " + String(stepMs, 1) + " ms steps, " +
+                String(numLoadThreads) + " load thread(s), thread player: " + threadPlayerResult.toString());
+
+            namespace Keys = Serialization::Benchmarks;
+            DynamicObject::Ptr scenario(new DynamicObject());
+            scenario->setProperty(Keys::stepMs, stepMs);
+            scenario->setProperty(Keys::numLoadThreads, numLoadThreads);
+            scenario->setProperty(Keys::timelineDispatcher, dispatcherResult.toVar());
+            scenario->setProperty(Keys::threadPlayer, threadPlayerResult.toVar());
+            scenarios.add(var(scenario.get()));
+        }
+    }
+
+    DynamicObject::Ptr deviceInfo(new DynamicObject());
+    deviceInfo->setProperty(Serialization::Audio::audioDeviceRate, TIMELINE_BENCHMARK_SAMPLE_RATE);
+    deviceInfo->setProperty(Serialization::Audio::audioDeviceBufferSize, TIMELINE_BENCHMARK_BLOCK_SIZE);
+
+    DynamicObject::Ptr report(new DynamicObject());
+    report->setProperty(Serialization::Audio::audioDevice, var(deviceInfo.get()));
+    report->setProperty(Serialization::Benchmarks::scenarios, scenarios);
+    return var(report.get());
+}
@@ -0,0 +1,39 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Measures the note onset jitter, i.e. how far the notes land from their
+// exact positions in the output, for the timeline dispatcher and for the
+// thread-based player it has replaced, which slept until each next event
+// and pushed it into the instrument's message collector.
+//
+// Runs from the command line, and writes the JSON report into the given file:
+//     Helio --timeline-benchmark report.json
+//
+// Both players drive the real instrument callback with the same timeline;
+// the device is simulated, so that the output time of every sample is known.
+
+class TimelineBenchmark final
+{
+public:
+
+    static const String argument;
+
+    static var run();
+
+};
@@ -0,0 +1,496 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "TimelineDispatcher.h"
+#include "Instrument.h"
+
+void TimelineDispatcher::startPlayback(PlaybackTimeline::Ptr newTimeline)
+{
+    jassert(newTimeline != nullptr);
+    const int numTracks = newTimeline->getTracks().size();
+
+    // allocate all the playback state here, not on the audio thread
+    HeapBlock<int> newNextEvents(numTracks + 1, true);
+    HeapBlock<uint16> newHoldingNotes(numTracks * 128, true);
+    PlaybackTimeline::Ptr replacedTimeline;
+
+    {
+        const ScopedLock sl(this->lock);
+        const SpinLock::ScopedLockType pl(this->pendingLock);
+
+        this->sendHoldingNotesOffViaCollectors();
+        this->clearPendingUpdate(replacedTimeline);
+
+        std::swap(this->timeline, newTimeline);
+        this->nextEvents.swapWith(newNextEvents);
+        this->holdingNotes.swapWith(newHoldingNotes);
+
+        this->positionSamples = 0;
+        this->hasStarted = false;
+        this->hasFinished = false;
+        this->playbackTimeSec = 0.0;
+    }
+
+    // the previous timelines are released here, out of the lock
+}
+
+void TimelineDispatcher::stopPlayback(const PlaybackTimeline *timelineToStop)
+{
+    PlaybackTimeline::Ptr previousTimeline;
+    PlaybackTimeline::Ptr replacedTimeline;
+
+    {
+        const ScopedLock sl(this->lock);
+        const SpinLock::ScopedLockType pl(this->pendingLock);
+
+        const auto *latestTimeline = this->hasPendingUpdate ?
+            this->pendingTimeline.get() : this->timeline.get();
+
+        if (latestTimeline == nullptr ||
+            (timelineToStop != nullptr && timelineToStop != latestTimeline))
+        {
+            return;
+        }
+
+        this->sendHoldingNotesOffViaCollectors();
+        this->clearPendingUpdate(replacedTimeline);
+
+        std::swap(this->timeline, previousTimeline);
+        this->hasFinished = true;
+    }
+}
+
+bool TimelineDispatcher::updatePlayback(const PlaybackTimeline *currentTimeline,
+    PlaybackTimeline::Ptr newTimeline)
+{
+    jassert(newTimeline != nullptr);
+    const int numTracks = newTimeline->getTracks().size();
+
+    HeapBlock<int> newNextEvents(numTracks + 1, true);
+    HeapBlock<uint16> newHoldingNotes(numTracks * 128, true);
+
+    {
+        const SpinLock::ScopedLockType pl(this->pendingLock);
+
+        // the previous update might still be waiting for the audio thread
+        const auto *latestTimeline = this->hasPendingUpdate ?
+            this->pendingTimeline.get() : this->timeline.get();
+
+        if (latestTimeline == nullptr || latestTimeline != currentTimeline)
+        {
+            return false;
+        }
+
+        std::swap(this->pendingTimeline, newTimeline);
+        this->pendingNextEvents.swapWith(newNextEvents);
+        this->pendingHoldingNotes.swapWith(newHoldingNotes);
+        this->hasPendingUpdate = true;
+    }
+
+    // the replaced timeline (or the outdated pending one) is released here
+    return true;
+}
+
+bool TimelineDispatcher::isPlaying(const PlaybackTimeline *timelineToCheck) const noexcept
+{
+    // the timeline is only replaced while holding the pending lock,
+    // so the main lock is left for the audio thread
+    const SpinLock::ScopedLockType pl(this->pendingLock);
+
+    const auto *latestTimeline = this->hasPendingUpdate ?
+        this->pendingTimeline.get() : this->timeline.get();
+
+    return latestTimeline != nullptr &&
+        latestTimeline == timelineToCheck &&
+        !this->hasFinished.get();
+}
+
+double TimelineDispatcher::getPlaybackTimeSec() const noexcept
+{
+    return this->playbackTimeSec.get();
+}
+
+//===----------------------------------------------------------------------===//
+// AudioIODeviceCallback
+//===----------------------------------------------------------------------===//
+
+void TimelineDispatcher::audioDeviceIOCallback(const float **inputChannelData,
+    int numInputChannels, float **outputChannelData,
+    int numOutputChannels, int numSamples)
+{
+    // this callback produces no sound by itself
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        FloatVectorOperations::clear(outputChannelData[i], numSamples);
+    }
+
+    // never wait here either: startPlayback and stopPlayback hold the lock
+    // for a while, and if they do, the playback will start or stop anyway,
+    // so this block is skipped, and the position only moves on the next one
+    const ScopedTryLock sl(this->lock);
+    if (!sl.isLocked())
+    {
+        return;
+    }
+
+    if (this->timeline == nullptr || this->hasFinished.get() || this->sampleRate <= 0.0)
+    {
+        return;
+    }
+
+    this->applyPendingUpdate();
+
+    const auto &tracks = this->timeline->getTracks();
+    const int64 endPosition = this->getSamplePosition(this->timeline->getLengthSec());
+    const bool looped = this->timeline->isLooped() && endPosition > 0;
+
+    if (!this->hasStarted)
+    {
+        for (auto *track : tracks)
+        {
+            track->instrument->getProcessorPlayer().addTimelineMessage(MidiMessage::midiStart(), 0);
+        }
+
+        this->hasStarted = true;
+    }
+
+    int blockOffset = 0;
+    while (blockOffset < numSamples)
+    {
+        const int64 rangeStart = this->positionSamples;
+        const int64 rangeEnd = jmin(rangeStart + (numSamples - blockOffset), endPosition);
+
+        if (rangeEnd < endPosition)
+        {
+            this->dispatchEvents(rangeStart, rangeEnd, blockOffset, numSamples);
+            this->positionSamples = rangeEnd;
+            break;
+        }
+
+        const int endOffset = blockOffset + int(rangeEnd - rangeStart);
+
+        if (looped)
+        {
+            // the loop ends within this block, so finish the loop and wrap around,
+            // making sure no notes are left hanging across the loop boundary
+            this->dispatchEvents(rangeStart, rangeEnd, blockOffset, numSamples);
+            this->sendHoldingNotesOff(jmin(endOffset, numSamples - 1));
+
+            zeromem(this->nextEvents, sizeof(int) * size_t(tracks.size() + 1));
+            this->positionSamples = 0;
+            blockOffset = endOffset;
+        }
+        else
+        {
+            // events exactly at the end position are still sent
+            this->dispatchEvents(rangeStart, rangeEnd + 1, blockOffset, numSamples);
+
+            const int stopOffset = jlimit(0, numSamples - 1, endOffset);
+            this->sendHoldingNotesOff(stopOffset);
+
+            for (auto *track : tracks)
+            {
+                track->instrument->getProcessorPlayer().
+                    addTimelineMessage(MidiMessage::midiStop(), stopOffset);
+            }
+
+            this->positionSamples = jmax(int64(0), endPosition);
+            this->hasFinished = true;
+            break;
+        }
+    }
+
+    this->playbackTimeSec = double(this->positionSamples) / this->sampleRate;
+}
+
+void TimelineDispatcher::audioDeviceAboutToStart(AudioIODevice *device)
+{
+    const auto newSampleRate = device->getCurrentSampleRate();
+
+    const ScopedLock sl(this->lock);
+
+    if (this->sampleRate > 0.0)
+    {
+        this->positionSamples = int64(double(this->positionSamples) * newSampleRate / this->sampleRate);
+    }
+
+    this->sampleRate = newSampleRate;
+}
+
+void TimelineDispatcher::audioDeviceStopped() {}
+
+//===----------------------------------------------------------------------===//
+// Audio thread helpers
+//===----------------------------------------------------------------------===//
+
+void TimelineDispatcher::dispatchEvents(int64 rangeStart, int64 rangeEnd,
+    int blockOffset, int numSamples) noexcept
+{
+    const auto &tracks = this->timeline->getTracks();
+
+    const auto getOffset = [rangeStart, blockOffset, numSamples](int64 position)
+    {
+        return jlimit(0, numSamples - 1, blockOffset + int(position - rangeStart));
+    };
+
+    // tempo events are sent to everybody (need to do that for drum-machines)
+    const auto &tempoEvents = this->timeline->getTempoEvents();
+    int &nextTempoEvent = this->nextEvents[tracks.size()];
+    while (nextTempoEvent < tempoEvents.size())
+    {
+        const auto &event = tempoEvents.getReference(nextTempoEvent);
+        const int64 position = this->getSamplePosition(event.timeSec);
+        if (position >= rangeEnd)
+        {
+            break;
+        }
+
+        for (auto *track : tracks)
+        {
+            track->instrument->getProcessorPlayer().
+                addTimelineMessage(event.message, getOffset(position));
+        }
+
+        nextTempoEvent++;
+    }
+
+    // the frozen tracks' audio is aligned to the beginning of the project
+    const int64 frozenAudioStart = rangeStart + this->getSamplePosition(this->timeline->getStartTimeSec());
+    const int numFrozenSamples = jmin(int(rangeEnd - rangeStart), numSamples - blockOffset);
+
+    for (int i = 0; i < tracks.size(); ++i)
+    {
+        const auto *track = tracks.getUnchecked(i);
+        auto &player = track->instrument->getProcessorPlayer();
+        auto *holding = this->holdingNotes + (i * 128);
+
+        // the instrument which only plays the frozen tracks doesn't need to process anything
+        for (auto *audio : track->frozenAudio)
+        {
+            player.addFrozenAudio(audio, frozenAudioStart, blockOffset,
+                numFrozenSamples, track->events.isEmpty());
+        }
+
+        int &nextEvent = this->nextEvents[i];
+        while (nextEvent < track->events.size())
+        {
+            const auto &event = track->events.getReference(nextEvent);
+            const int64 position = this->getSamplePosition(event.timeSec);
+            if (position >= rangeEnd)
+            {
+                break;
+            }
+
+            const auto &message = event.message;
+            player.addTimelineMessage(message, getOffset(position));
+
+            if (message.isNoteOn())
+            {
+                holding[message.getNoteNumber()] |= uint16(1 << (message.getChannel() - 1));
+            }
+            else if (message.isNoteOff())
+            {
+                holding[message.getNoteNumber()] &= uint16(~(1 << (message.getChannel() - 1)));
+            }
+
+            nextEvent++;
+        }
+    }
+}
+
+// Some plugins just don't understand allNotesOff message,
+// so we keep track of still playing notes to send noteOff's explicitly
+void TimelineDispatcher::sendHoldingNotesOff(int sampleOffset) noexcept
+{
+    const auto &tracks = this->timeline->getTracks();
+    for (int i = 0; i < tracks.size(); ++i)
+    {
+        auto &player = tracks.getUnchecked(i)->instrument->getProcessorPlayer();
+        auto *holding = this->holdingNotes + (i * 128);
+        for (int key = 0; key < 128; ++key)
+        {
+            for (int channel = 0; holding[key] != 0 && channel < 16; ++channel)
+            {
+                if ((holding[key] & (1 << channel)) != 0)
+                {
+                    player.addTimelineMessage(MidiMessage::noteOff(channel + 1, key), sampleOffset);
+                    holding[key] &= uint16(~(1 << channel));
+                }
+            }
+        }
+    }
+}
+
+void TimelineDispatcher::sendHoldingNotesOffViaCollectors()
+{
+    if (this->timeline == nullptr || !this->hasStarted || this->hasFinished.get())
+    {
+        return;
+    }
+
+    const auto timeNow = Time::getMillisecondCounterHiRes() * 0.001;
+    const auto &tracks = this->timeline->getTracks();
+    for (int i = 0; i < tracks.size(); ++i)
+    {
+        auto &collector = tracks.getUnchecked(i)->instrument->
+            getProcessorPlayer().getMidiMessageCollector();
+
+        auto *holding = this->holdingNotes + (i * 128);
+        for (int key = 0; key < 128; ++key)
+        {
+            for (int channel = 0; holding[key] != 0 && channel < 16; ++channel)
+            {
+                if ((holding[key] & (1 << channel)) != 0)
+                {
+                    collector.addMessageToQueue(MidiMessage::noteOff(channel + 1, key).withTimeStamp(timeNow));
+                    holding[key] &= uint16(~(1 << channel));
+                }
+            }
+        }
+
+        collector.addMessageToQueue(MidiMessage::midiStop().withTimeStamp(timeNow));
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Updating the timeline on the fly
+//===----------------------------------------------------------------------===//
+
+// How far to look ahead in the updated timeline for a matching note-off,
+// after that we'd rather stop the note than stall the audio thread
+#define MAX_RECONCILE_LOOKAHEAD_EVENTS 1024
+
+void TimelineDispatcher::applyPendingUpdate() noexcept
+{
+    // never wait here: if the player thread is busy with the pending update,
+    // it will be picked up on the next block
+    const SpinLock::ScopedTryLockType pl(this->pendingLock);
+    if (!pl.isLocked() || !this->hasPendingUpdate)
+    {
+        return;
+    }
+
+    const auto &oldTracks = this->timeline->getTracks();
+    const auto &newTracks = this->pendingTimeline->getTracks();
+
+    // move the cursors to the current position
+    for (int i = 0; i < newTracks.size(); ++i)
+    {
+        this->pendingNextEvents[i] = this->findNextEventIndex(newTracks.getUnchecked(i)->events);
+    }
+
+    this->pendingNextEvents[newTracks.size()] =
+        this->findNextEventIndex(this->pendingTimeline->getTempoEvents());
+
+    // notes still held are either carried over to the new timeline,
+    // if they still end somewhere ahead, or stopped right away
+    for (int i = 0; i < oldTracks.size(); ++i)
+    {
+        const auto *oldTrack = oldTracks.getUnchecked(i);
+        auto *oldHolding = this->holdingNotes + (i * 128);
+
+        int newTrackIndex = -1;
+        for (int j = 0; j < newTracks.size(); ++j)
+        {
+            if (newTracks.getUnchecked(j)->instrument == oldTrack->instrument)
+            {
+                newTrackIndex = j;
+                break;
+            }
+        }
+
+        for (int key = 0; key < 128; ++key)
+        {
+            for (int channel = 0; oldHolding[key] != 0 && channel < 16; ++channel)
+            {
+                const uint16 channelMask = uint16(1 << channel);
+                if ((oldHolding[key] & channelMask) == 0)
+                {
+                    continue;
+                }
+
+                oldHolding[key] &= uint16(~channelMask);
+
+                bool isStillSounding = false;
+                if (newTrackIndex >= 0)
+                {
+                    const auto &events = newTracks.getUnchecked(newTrackIndex)->events;
+                    const int lookaheadEnd = jmin(events.size(),
+                        this->pendingNextEvents[newTrackIndex] + MAX_RECONCILE_LOOKAHEAD_EVENTS);
+
+                    for (int e = this->pendingNextEvents[newTrackIndex]; e < lookaheadEnd; ++e)
+                    {
+                        const auto &message = events.getReference(e).message;
+                        if ((message.isNoteOn() || message.isNoteOff()) &&
+                            message.getNoteNumber() == key &&
+                            message.getChannel() == channel + 1)
+                        {
+                            isStillSounding = message.isNoteOff();
+                            break;
+                        }
+                    }
+                }
+
+                if (isStillSounding)
+                {
+                    this->pendingHoldingNotes[newTrackIndex * 128 + key] |= channelMask;
+                }
+                else
+                {
+                    oldTrack->instrument->getProcessorPlayer().
+                        addTimelineMessage(MidiMessage::noteOff(channel + 1, key), 0);
+                }
+            }
+        }
+    }
+
+    std::swap(this->timeline, this->pendingTimeline);
+    this->nextEvents.swapWith(this->pendingNextEvents);
+    this->holdingNotes.swapWith(this->pendingHoldingNotes);
+    this->hasPendingUpdate = false;
+}
+
+int TimelineDispatcher::findNextEventIndex(const Array<PlaybackTimeline::Event> &events) const noexcept
+{
+    // the first event that has not been dispatched yet
+    int start = 0;
+    int end = events.size();
+    while (start < end)
+    {
+        const int middle = start + (end - start) / 2;
+        if (this->getSamplePosition(events.getReference(middle).timeSec) < this->positionSamples)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return start;
+}
+
+// Should be called with both locks held
+void TimelineDispatcher::clearPendingUpdate(PlaybackTimeline::Ptr &outTimeline)
+{
+    std::swap(this->pendingTimeline, outTimeline);
+    this->pendingNextEvents.free();
+    this->pendingHoldingNotes.free();
+    this->hasPendingUpdate = false;
+}
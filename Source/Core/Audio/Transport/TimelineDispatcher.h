@@ -0,0 +1,100 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "PlaybackTimeline.h"
+
+// Sends the timeline events to instruments right from the audio thread,
+// placing each message at its exact sample offset within the block,
+// so that the playback timing does not depend on the OS scheduler.
+
+// Needs to be the first callback of the audio device, so that
+// instruments could pick up the scheduled events within the same block.
+
+class TimelineDispatcher final : public AudioIODeviceCallback
+{
+public:
+
+    TimelineDispatcher() = default;
+
+    void startPlayback(PlaybackTimeline::Ptr timeline);
+    void stopPlayback(const PlaybackTimeline *timeline = nullptr);
+
+    // Replaces the playing timeline with an updated one, built for the same
+    // time range; the swap itself happens on the audio thread at the next block,
+    // so the playback goes on, and the notes still held are reconciled
+    bool updatePlayback(const PlaybackTimeline *currentTimeline,
+        PlaybackTimeline::Ptr newTimeline);
+
+    bool isPlaying(const PlaybackTimeline *timeline) const noexcept;
+    double getPlaybackTimeSec() const noexcept;
+
+    //===------------------------------------------------------------------===//
+    // AudioIODeviceCallback
+    //===------------------------------------------------------------------===//
+
+    void audioDeviceIOCallback(const float **inputChannelData, int numInputChannels,
+        float **outputChannelData, int numOutputChannels, int numSamples) override;
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+    void audioDeviceStopped() override;
+
+private:
+
+    void dispatchEvents(int64 rangeStart, int64 rangeEnd,
+        int blockOffset, int numSamples) noexcept;
+
+    void sendHoldingNotesOff(int sampleOffset) noexcept;
+    void sendHoldingNotesOffViaCollectors();
+
+    void applyPendingUpdate() noexcept;
+    int findNextEventIndex(const Array<PlaybackTimeline::Event> &events) const noexcept;
+    void clearPendingUpdate(PlaybackTimeline::Ptr &outTimeline);
+
+    inline int64 getSamplePosition(double timeSec) const noexcept
+    {
+        return int64(timeSec * this->sampleRate + 0.5);
+    }
+
+    CriticalSection lock;
+    PlaybackTimeline::Ptr timeline;
+
+    // next event indices for each track, and one more for tempo events
+    HeapBlock<int> nextEvents;
+
+    // each element is a bitmask of midi channels, holding the key for a track
+    HeapBlock<uint16> holdingNotes;
+
+    // the updated timeline is passed to the audio thread through these,
+    // and the replaced one is left here to be released on another thread
+    SpinLock pendingLock;
+    PlaybackTimeline::Ptr pendingTimeline;
+    HeapBlock<int> pendingNextEvents;
+    HeapBlock<uint16> pendingHoldingNotes;
+    bool hasPendingUpdate = false;
+
+    int64 positionSamples = 0;
+    bool hasStarted = false;
+
+    // polled by the player thread without taking the lock
+    Atomic<bool> hasFinished = true;
+
+    double sampleRate = 0.0;
+    Atomic<double> playbackTimeSec = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimelineDispatcher)
+};
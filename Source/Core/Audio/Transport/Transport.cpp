@@ -30,13 +30,24 @@
 #include "HybridRoll.h"
 #include "SerializationKeys.h"
 #include "PlayerThreadPool.h"
+#include "TimelineDispatcher.h"
+#include "Config.h"
 
 #define TIME_NOW (Time::getMillisecondCounterHiRes() * 0.001)
 #define SOUND_SLEEP_DELAY_MS (10000)
 
-Transport::Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer) :
+// Frozen audio is rendered into float wav files, so that it could be memory-mapped as is
+#define FROZEN_AUDIO_BIT_DEPTH 32
+
+// The render block size comes from the config, which anyone can edit
+#define TRANSPORT_MIN_RENDER_BLOCK_SIZE 32
+#define TRANSPORT_MAX_RENDER_BLOCK_SIZE 8192
+
+Transport::Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer,
+    TimelineDispatcher &timelineDispatcher) :
     orchestra(orchestraPit),
     sleepTimer(sleepTimer),
+    timelineDispatcher(timelineDispatcher),
     seekPosition(0.0),
     trackStartMs(0.0),
     trackEndMs(0.0),
@@ -45,6 +56,7 @@ Transport::Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer) :
     projectFirstBeat(0.f),
     projectLastBeat(DEFAULT_NUM_BARS * BEATS_PER_BAR)
 {
+    this->tempoMap = new TempoMap();
     this->player.reset(new PlayerThreadPool(*this));
     this->renderer.reset(new RendererThread(*this));
     this->orchestra.addOrchestraListener(this);
@@ -52,10 +64,13 @@ Transport::Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer) :
 
 Transport::~Transport()
 {
+    this->cancelPendingUpdate();
     this->orchestra.removeOrchestraListener(this);
     this->renderer = nullptr;
     this->player = nullptr;
     this->transportListeners.clear();
+    this->frozenTracks.clear();
+    this->releasedFrozenAudio.clear();
 }
 
 String Transport::getTimeString(double timeMs, bool includeMilliseconds)
@@ -151,36 +166,53 @@ void Transport::probeSoundAt(double absTrackPosition, const MidiSequence *limitT
     this->recacheIfNeeded();
     
     const double targetFlatTime = this->getTotalTime() * absTrackPosition;
-    const auto sequencesToProbe(this->playbackCache.getAllFor(limitToLayer));
-    
+    const auto sequencesToProbe(this->playbackCache.getAllFor(limitToLayer, true));
+
+    Array<int> soundingNotes;
     for (const auto &seq : sequencesToProbe)
     {
-        for (int j = 0; j < seq->midiMessages.getNumEvents(); ++j)
+        soundingNotes.clearQuick();
+        seq->notesIndex.findSoundingNotesAt(targetFlatTime, soundingNotes);
+
+        for (const auto noteOnIndex : soundingNotes)
         {
-            auto *noteOnHolder = seq->midiMessages.getEventPointer(j);
-            
-            if (auto *noteOffHolder = noteOnHolder->noteOffObject)
-            {
-                const double noteOn(noteOnHolder->message.getTimeStamp());
-                const double noteOff(noteOffHolder->message.getTimeStamp());
-                
-                if (noteOn <= targetFlatTime && noteOff > targetFlatTime)
-                {
-                    MidiMessage messageTimestampedAsNow(noteOnHolder->message);
-                    messageTimestampedAsNow.setTimeStamp(TIME_NOW);
-                    seq->listener->addMessageToQueue(messageTimestampedAsNow);
-                }
-            }
+            MidiMessage messageTimestampedAsNow(seq->midiMessages.getEventPointer(noteOnIndex)->message);
+            messageTimestampedAsNow.setTimeStamp(TIME_NOW);
+            seq->listener->addMessageToQueue(messageTimestampedAsNow);
         }
     }
 
     this->sleepTimer.setCanSleepAfter(SOUND_SLEEP_DELAY_MS);
 }
 
+Array<MidiMessage> Transport::findSoundingNotesAt(double absTrackPosition,
+    const MidiSequence *limitToLayer)
+{
+    this->recacheIfNeeded();
+
+    const double targetFlatTime = this->getTotalTime() * absTrackPosition;
+    const auto sequencesToProbe(this->playbackCache.getAllFor(limitToLayer, true));
+
+    Array<int> soundingNotes;
+    Array<MidiMessage> result;
+    for (const auto &seq : sequencesToProbe)
+    {
+        soundingNotes.clearQuick();
+        seq->notesIndex.findSoundingNotesAt(targetFlatTime, soundingNotes);
+
+        for (const auto noteOnIndex : soundingNotes)
+        {
+            result.add(seq->midiMessages.getEventPointer(noteOnIndex)->message);
+        }
+    }
+
+    return result;
+}
+
 // Only used in a key signature dialog to test how scales sound
 void Transport::probeSequence(const MidiMessageSequence &sequence)
 {
-    this->playbackCache.clear();
+    ProjectSequences probeCache;
     this->sequencesAreOutdated = true; // will update on the next playback
 
     const double startPositionInTime = this->getSeekPosition() * this->getTotalTime();
@@ -191,7 +223,12 @@ void Transport::probeSequence(const MidiMessageSequence &sequence)
     cached->midiMessages = MidiMessageSequence(sequence);
     cached->midiMessages.addTimeToMessages(startPositionInTime);
 
-    this->playbackCache.addWrapper(cached);
+    probeCache.addWrapper(cached);
+
+    {
+        const SpinLock::ScopedLockType l(this->sequencesLock);
+        this->playbackCache.swapWith(probeCache);
+    }
 
     if (this->player->isPlaying())
     {
@@ -205,6 +242,7 @@ void Transport::probeSequence(const MidiMessageSequence &sequence)
 void Transport::startPlayback()
 {
     this->sleepTimer.setAwake();
+    this->invalidateChangedFrozenTracks();
     this->recacheIfNeeded();
 
     if (this->player->isPlaying())
@@ -220,6 +258,7 @@ void Transport::startPlayback()
 void Transport::startPlaybackFragment(double absLoopStart, double absLoopEnd, bool looped)
 {
     this->sleepTimer.setAwake();
+    this->invalidateChangedFrozenTracks();
     this->recacheIfNeeded();
     
     if (this->player->isPlaying())
@@ -254,17 +293,31 @@ bool Transport::isPlaying() const
     return this->player->isPlaying();
 }
 
-void Transport::startRender(const String &fileName)
+bool Transport::startRender(const String &fileName, bool renderStems)
 {
     if (this->renderer->isRecording())
     {
-        return;
+        return false;
     }
     
     this->sleepTimer.setCanSleepAfter(0);
 
+    RendererThread::Options options;
+    options.blockSize = jlimit(TRANSPORT_MIN_RENDER_BLOCK_SIZE, TRANSPORT_MAX_RENDER_BLOCK_SIZE,
+        App::Config().getProperty(Serialization::Config::renderBlockSize,
+            String(options.blockSize)).getIntValue());
+    options.bitDepth = RendererThread::Options::getSupportedBitDepth(
+        App::Config().getProperty(Serialization::Config::renderBitDepth,
+            String(options.bitDepth)).getIntValue());
+    options.doublePrecision = App::Config().getProperty(Serialization::Config::renderDoublePrecision,
+        Serialization::Config::disabledState.toString()) == Serialization::Config::enabledState.toString();
+    options.benchmark = App::Config().getProperty(Serialization::Config::renderBenchmark,
+        Serialization::Config::disabledState.toString()) == Serialization::Config::enabledState.toString();
+
+    this->invalidateChangedFrozenTracks();
+
     File file(File::getCurrentWorkingDirectory().getChildFile(fileName));
-    this->renderer->startRecording(file);
+    return this->renderer->startRecording(file, options, renderStems);
 }
 
 void Transport::stopRender()
@@ -289,77 +342,228 @@ float Transport::getRenderingPercentsComplete() const
     return this->renderer->getPercentsComplete();
 }
 
+LoudnessMeter::Report Transport::getRenderLoudnessReport() const
+{
+    return this->renderer->getLoudnessReport();
+}
+
 //===----------------------------------------------------------------------===//
-// Sending messages at real-time
+// Freezing
 //===----------------------------------------------------------------------===//
 
-Transport::MidiMessageDelayedPreview::~MidiMessageDelayedPreview()
+void Transport::freezeTrack(const MidiTrack *track)
 {
-    this->cancelPendingPreview();
+    if (this->renderer->isRecording() || track->isTempoTrack())
+    {
+        return;
+    }
+
+    const String trackId = track->getTrackId();
+    const WeakReference<Instrument> instrument = this->linksCache[trackId];
+    if (instrument == nullptr)
+    {
+        return;
+    }
+
+    this->stopPlayback();
+
+    // the track's messages need to be in the playback cache to be rendered
+    this->invalidateFrozenTrack(track);
+    this->recacheIfNeeded();
+
+    RendererThread::Options options;
+    options.blockSize = App::Config().getProperty(Serialization::Config::renderBlockSize,
+        String(options.blockSize)).getIntValue();
+    options.doublePrecision = App::Config().getProperty(Serialization::Config::renderDoublePrecision,
+        Serialization::Config::disabledState.toString()) == Serialization::Config::enabledState.toString();
+    options.bitDepth = FROZEN_AUDIO_BIT_DEPTH;
+
+    const File file(File::getSpecialLocation(File::tempDirectory)
+        .getNonexistentChildFile(File::createLegalFileName("HelioFreeze-" + trackId), ".wav", false));
+
+    const FrozenTrackInfo info = { nullptr, instrument, track->getTrackChannel(), this->playbackHasSoloClips, 0, 0 };
+
+    this->freezingTrackId = trackId;
+    this->sleepTimer.setCanSleepAfter(0);
+
+    this->renderer->startFreezing(file, options, track->getSequence(),
+        [this, file, trackId, info](bool succeeded)
+        {
+            this->sleepTimer.setAwake();
+
+            // the track might have been changed or unfrozen while rendering
+            if (!succeeded || this->freezingTrackId != trackId || info.instrument == nullptr)
+            {
+                file.deleteFile();
+                return;
+            }
+
+            this->freezingTrackId = {};
+
+            FrozenAudio::Ptr audio(new FrozenAudio(file));
+            if (!audio->isValid())
+            {
+                return;
+            }
+
+            // the state after the render, since the track's own messages might change it
+            this->frozenTracks[trackId] = { audio, info.instrument, info.channel, info.hasSoloClips,
+                info.instrument->getStateVersion(), info.instrument->getStateHash() };
+            this->sequencesAreOutdated = true;
+            this->purgeReleasedFrozenAudio();
+
+            if (this->player->isPlaying())
+            {
+                this->triggerAsyncUpdate();
+            }
+        });
+}
+
+void Transport::unfreezeTrack(const MidiTrack *track)
+{
+    this->invalidateFrozenTrack(track);
+    this->stopOrUpdatePlayback(track->getTrackControllerNumber());
 }
 
-void Transport::MidiMessageDelayedPreview::cancelPendingPreview()
+bool Transport::isTrackFrozen(const MidiTrack *track) const
 {
-    this->stopTimer();
-    this->messages.clearQuick();
-    this->instruments.clearQuick();
+    return this->frozenTracks.contains(track->getTrackId());
 }
 
-void Transport::MidiMessageDelayedPreview::previewMessage(const MidiMessage &message,
-    WeakReference<Instrument> instrument)
+bool Transport::isFreezing() const
 {
-    this->messages.add(message);
-    this->instruments.add(instrument);
-    if (!this->isTimerRunning())
+    return this->freezingTrackId.isNotEmpty();
+}
+
+void Transport::invalidateFrozenTrack(const MidiTrack *track)
+{
+    this->purgeReleasedFrozenAudio();
+
+    if (track->isTempoTrack())
+    {
+        this->invalidateFrozenTracks();
+        return;
+    }
+
+    const auto &trackId = track->getTrackId();
+    if (this->freezingTrackId == trackId)
+    {
+        this->freezingTrackId = {};
+        this->renderer->stop();
+    }
+
+    const auto found = this->frozenTracks.find(trackId);
+    if (found != this->frozenTracks.end())
     {
-        this->startTimer(50);
+        this->releasedFrozenAudio.add(found->second.audio);
+        this->frozenTracks.erase(found);
+        this->sequencesAreOutdated = true;
     }
 }
 
-void Transport::MidiMessageDelayedPreview::timerCallback()
+void Transport::invalidateFrozenTracks()
 {
-    this->stopTimer();
+    this->purgeReleasedFrozenAudio();
 
-#if HELIO_MOBILE
-    // iSEM tends to hang >_< if too many messages are send simultaniously
-    const auto time = TIME_NOW + float(rand() % 50) * 0.01;
-#elif HELIO_DESKTOP
-    const auto time = TIME_NOW;
-#endif
+    if (this->freezingTrackId.isNotEmpty())
+    {
+        this->freezingTrackId = {};
+        this->renderer->stop();
+    }
 
-    for (int i = 0; i < this->messages.size(); ++i)
+    if (!this->frozenTracks.empty())
     {
-        if (Instrument *instrument = this->instruments.getUnchecked(i))
+        for (const auto &it : this->frozenTracks)
         {
-            auto &message = this->messages.getReference(i);
-            message.setTimeStamp(time);
-            instrument->getProcessorPlayer().getMidiMessageCollector().addMessageToQueue(message);
+            this->releasedFrozenAudio.add(it.second.audio);
         }
+
+        this->frozenTracks.clear();
+        this->sequencesAreOutdated = true;
     }
+}
 
-    this->messages.clearQuick();
-    this->instruments.clearQuick();
+// Plugin parameters and graph changes are only checked before the playback or
+// the render starts, since getting the plugins' states might take a while;
+// the state version tells if it's worth checking them at all
+void Transport::invalidateChangedFrozenTracks()
+{
+    for (const auto *track : this->tracksCache)
+    {
+        const auto frozen = this->frozenTracks.find(track->getTrackId());
+        if (frozen == this->frozenTracks.end() || frozen->second.instrument == nullptr)
+        {
+            continue;
+        }
+
+        auto &info = frozen->second;
+        const int stateVersion = info.instrument->getStateVersion();
+        if (stateVersion == info.stateVersion)
+        {
+            continue;
+        }
+
+        if (info.instrument->getStateHash() == info.stateHash)
+        {
+            info.stateVersion = stateVersion;
+            continue;
+        }
+
+        this->invalidateFrozenTrack(track);
+    }
 }
 
+void Transport::purgeReleasedFrozenAudio()
+{
+    for (int i = this->releasedFrozenAudio.size(); --i >= 0;)
+    {
+        if (this->releasedFrozenAudio.getUnchecked(i)->getReferenceCount() == 1)
+        {
+            this->releasedFrozenAudio.remove(i);
+        }
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Sending messages at real-time
+//===----------------------------------------------------------------------===//
+
+// The previewed messages go through the instruments' preview queues,
+// which are drained at the start of each audio block in the same order,
+// so that the stop messages can never overtake the notes sent before them
+
 void Transport::previewMidiMessage(const String &trackId, const MidiMessage &message) const
 {
     this->sleepTimer.setAwake();
-    this->messagePreviewQueue.previewMessage(message, this->linksCache[trackId]);
+
+    if (Instrument *instrument = this->linksCache[trackId])
+    {
+        auto &player = instrument->getProcessorPlayer();
+        if (!player.getMidiPreviewQueue().push(message))
+        {
+            player.getMidiMessageCollector().addMessageToQueue(message.withTimeStamp(TIME_NOW));
+        }
+    }
+
     this->sleepTimer.setCanSleepAfter(SOUND_SLEEP_DELAY_MS);
 }
 
-static void stopSoundForInstrument(Instrument *instrument)
+static void stopSoundForInstrument(Instrument *instrument, int channel = 1)
 {
-    auto &collector = instrument->getProcessorPlayer().getMidiMessageCollector();
-    collector.addMessageToQueue(MidiMessage::allControllersOff(1).withTimeStamp(TIME_NOW));
-    collector.addMessageToQueue(MidiMessage::allNotesOff(1).withTimeStamp(TIME_NOW));
-    collector.addMessageToQueue(MidiMessage::allSoundOff(1).withTimeStamp(TIME_NOW));
+    auto &player = instrument->getProcessorPlayer();
+    if (!player.getMidiPreviewQueue().pushStopSound(channel))
+    {
+        // the queued note-ons are dropped anyway, so these can't be overtaken
+        auto &collector = player.getMidiMessageCollector();
+        collector.addMessageToQueue(MidiMessage::allNotesOff(channel).withTimeStamp(TIME_NOW));
+        collector.addMessageToQueue(MidiMessage::allControllersOff(channel).withTimeStamp(TIME_NOW));
+        collector.addMessageToQueue(MidiMessage::allSoundOff(channel).withTimeStamp(TIME_NOW));
+    }
 }
 
 void Transport::stopSound(const String &trackId) const
 {
     this->sleepTimer.setAwake();
-    this->messagePreviewQueue.cancelPendingPreview();
 
     if (Instrument *instrument = this->linksCache[trackId])
     {
@@ -382,28 +586,21 @@ void Transport::stopSound(const String &trackId) const
 void Transport::allNotesControllersAndSoundOff() const
 {
     this->sleepTimer.setAwake();
-    this->messagePreviewQueue.cancelPendingPreview();
 
     static const int c = 1;
     //for (int c = 1; c <= 16; ++c)
     {
-        const MidiMessage notesOff(MidiMessage::allNotesOff(c).withTimeStamp(TIME_NOW));
-        const MidiMessage soundOff(MidiMessage::allSoundOff(c).withTimeStamp(TIME_NOW));
-        const MidiMessage controllersOff(MidiMessage::allControllersOff(c).withTimeStamp(TIME_NOW));
-        
-        Array<const MidiMessageCollector *> duplicateCollectors;
-        
+        Array<const Instrument *> duplicateInstruments;
+
         for (int l = 0; l < this->tracksCache.size(); ++l)
         {
             const auto &trackId = this->tracksCache.getUnchecked(l)->getTrackId();
-            auto *collector = &this->linksCache[trackId]->getProcessorPlayer().getMidiMessageCollector();
-            
-            if (! duplicateCollectors.contains(collector))
+            auto *instrument = this->linksCache[trackId];
+
+            if (instrument != nullptr && ! duplicateInstruments.contains(instrument))
             {
-                collector->addMessageToQueue(notesOff);
-                collector->addMessageToQueue(controllersOff);
-                collector->addMessageToQueue(soundOff);
-                duplicateCollectors.add(collector);
+                stopSoundForInstrument(instrument, c);
+                duplicateInstruments.add(instrument);
             }
         }
     }
@@ -434,6 +631,18 @@ void Transport::instrumentRemoved(Instrument *instrument)
     // the instrument stack have still not changed here,
     // so just stop the playback before it's too late
     this->stopPlayback();
+
+    // the player thread might be finishing right now, but still
+    // keeping the timeline with a pointer to the removed instrument:
+    this->timelineDispatcher.stopPlayback();
+
+    // the frozen tracks of the removed instrument are dropped on the next recache,
+    // but the track being frozen might be rendered with that instrument right now
+    if (this->isFreezing())
+    {
+        this->freezingTrackId = {};
+        this->renderer->stop();
+    }
 }
 
 void Transport::instrumentRemovedPostAction()
@@ -459,67 +668,96 @@ void Transport::instrumentRemovedPostAction()
 
 void Transport::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
-    // todo stop playback only if the event is in future
-    // and getTrackControllerNumber == 0 (not an automation)
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&newEvent));
+    this->invalidateFrozenTrack(newEvent.getSequence()->getTrack());
+    this->sequencesCache.invalidateTrack(newEvent.getSequence()->getTrack());
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(newEvent.getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded((&newEvent));
 }
 
 void Transport::onAddMidiEvent(const MidiEvent &event)
 {
-    // todo stop playback only if the event is in future
-    // and getTrackControllerNumber == 0 (not an automation)
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&event));
+    this->invalidateFrozenTrack(event.getSequence()->getTrack());
+    this->sequencesCache.invalidateTrack(event.getSequence()->getTrack());
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(event.getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded((&event));
 }
 
 void Transport::onRemoveMidiEvent(const MidiEvent &event) {}
 void Transport::onPostRemoveMidiEvent(MidiSequence *const sequence)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded(sequence->getTrack());
+    this->invalidateFrozenTrack(sequence->getTrack());
+    this->sequencesCache.invalidateTrack(sequence->getTrack());
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(sequence->getTrack()->getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded(sequence->getTrack());
 }
 
 void Transport::onAddClip(const Clip &clip)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&clip));
+    this->invalidateFrozenTrack(clip.getPattern()->getTrack());
+    this->sequencesCache.invalidateClip(clip);
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(clip.getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded((&clip));
 }
 
 void Transport::onChangeClip(const Clip &oldClip, const Clip &newClip)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&newClip));
+    this->invalidateFrozenTrack(newClip.getPattern()->getTrack());
+    this->sequencesCache.invalidateClip(newClip);
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(newClip.getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded((&newClip));
+}
+
+void Transport::onRemoveClip(const Clip &clip)
+{
+    // the removed clip's messages will be dropped from the track on the next recache
+    this->sequencesCache.invalidateClip(clip);
+    this->invalidateFrozenTrack(clip.getPattern()->getTrack());
 }
 
-void Transport::onRemoveClip(const Clip &clip) {}
 void Transport::onPostRemoveClip(Pattern *const pattern)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded(pattern->getTrack());
     this->sequencesAreOutdated = true;
+    this->stopOrUpdatePlayback(pattern->getTrack()->getTrackControllerNumber());
+    updateLengthAndTimeIfNeeded(pattern->getTrack());
 }
 
 void Transport::onChangeTrackProperties(MidiTrack *const track)
 {
+    // Track's channel might have changed, which affects the exported messages:
+    this->sequencesCache.invalidateTrack(track);
+    this->sequencesAreOutdated = true;
+
+    // (the instrument change is checked on the next recache)
+    const auto frozen = this->frozenTracks.find(track->getTrackId());
+    if (frozen != this->frozenTracks.end() &&
+        frozen->second.channel != track->getTrackChannel())
+    {
+        this->invalidateFrozenTrack(track);
+    }
+
     // Stop playback only when instrument changes:
     const auto &trackId = track->getTrackId();
     if (!linksCache.contains(trackId) ||
         this->linksCache[trackId]->getInstrumentId() != track->getTrackInstrumentId())
     {
         this->stopPlayback();
-        this->sequencesAreOutdated = true;
         this->updateLinkForTrack(track);
     }
+    else if (this->player->isPlaying())
+    {
+        this->triggerAsyncUpdate();
+    }
 }
 
 void Transport::onReloadProjectContent(const Array<MidiTrack *> &tracks)
 {
+    this->invalidateFrozenTracks();
+    this->sequencesCache.invalidateAll();
     this->sequencesAreOutdated = true;
 
     this->tracksCache.clearQuick();
@@ -536,25 +774,34 @@ void Transport::onReloadProjectContent(const Array<MidiTrack *> &tracks)
 
 void Transport::onAddTrack(MidiTrack *const track)
 {
-    this->stopPlayback();
-    
+    this->sequencesCache.invalidateTrack(track);
     this->sequencesAreOutdated = true;
     this->tracksCache.addIfNotAlreadyThere(track);
     this->updateLinkForTrack(track);
+
+    this->stopOrUpdatePlayback(track->getTrackControllerNumber());
 }
 
 void Transport::onRemoveTrack(MidiTrack *const track)
 {
-    this->stopPlayback();
-    
+    this->invalidateFrozenTrack(track);
+    this->sequencesCache.removeTrack(track);
     this->sequencesAreOutdated = true;
     this->tracksCache.removeAllInstancesOf(track);
     this->removeLinkForTrack(track);
+
+    this->stopOrUpdatePlayback(track->getTrackControllerNumber());
 }
 
 void Transport::onChangeProjectBeatRange(float firstBeat, float lastBeat)
 {
     this->stopPlayback();
+
+    // the frozen audio starts at the project's first beat
+    if (firstBeat != this->projectFirstBeat.get())
+    {
+        this->invalidateFrozenTracks();
+    }
     
     const double seekBeat = double(this->projectFirstBeat.get()) +
         double(this->projectLastBeat.get() - this->projectFirstBeat.get()) * this->seekPosition.get(); // may be 0
@@ -595,58 +842,17 @@ void Transport::calcTimeAndTempoAt(const double targetAbsPosition,
                                    double &outTimeMs, double &outTempo)
 {
     this->recacheIfNeeded();
-    this->playbackCache.seekToZeroIndexes();
-    
-    const double targetTime = targetAbsPosition * this->getTotalTime();
-    
-    outTimeMs = 0.0;
-    outTempo = 500.0; // default 120 BPM
-    
-    double prevTimestamp = 0.0;
-    double nextEventTimeDelta = 0.0;
-    bool foundFirstTempoEvent = false;
-    
-    CachedMidiMessage cached;
-    
-    while (this->playbackCache.getNextMessage(cached))
-    {
-        const double nextAbsPosition = cached.message.getTimeStamp() / this->getTotalTime();
-        
-        // first tempo event sets the tempo all the way before it
-        if (nextAbsPosition > targetAbsPosition && foundFirstTempoEvent) { break; }
-        
-        nextEventTimeDelta = outTempo * (cached.message.getTimeStamp() - prevTimestamp);
-        outTimeMs += nextEventTimeDelta;
-        prevTimestamp = cached.message.getTimeStamp();
-        
-        if (cached.message.isTempoMetaEvent())
-        {
-            outTempo = cached.message.getTempoSecondsPerQuarterNote() * 1000.f;
-            foundFirstTempoEvent = true;
-        }
-    }
-    
-    nextEventTimeDelta = outTempo * (targetTime - prevTimestamp);
-    outTimeMs += nextEventTimeDelta;
+    const auto tempoMap = this->getTempoMap();
+    const double targetPosition = targetAbsPosition * this->getTotalTime();
+    outTimeMs = tempoMap->getTimeMsAt(targetPosition);
+    outTempo = tempoMap->getTempoAt(targetPosition);
 }
 
 MidiMessage Transport::findFirstTempoEvent()
 {
     this->recacheIfNeeded();
-    this->playbackCache.seekToZeroIndexes();
-    
-    CachedMidiMessage wrapper;
-    
-    while (this->playbackCache.getNextMessage(wrapper))
-    {
-        if (wrapper.message.isTempoMetaEvent())
-        {
-            return wrapper.message;
-        }
-    }
-    
-    // return default 120 bpm (== 500 ms per quarter note)
-    return MidiMessage::tempoMetaEvent(500 * 1000);
+    const auto tempoMap = this->getTempoMap();
+    return MidiMessage::tempoMetaEvent(int(tempoMap->getFirstTempo() * 1000.0));
 }
 
 //===----------------------------------------------------------------------===//
@@ -657,9 +863,9 @@ void Transport::recacheIfNeeded()
 {
     if (this->sequencesAreOutdated)
     {
-        this->playbackCache.clear();
-        static Clip noTransform;
-        const double offset = -this->trackStartMs.get();
+        // the player thread may be copying the cache meanwhile,
+        // so the new one is built aside and swapped in under the lock
+        ProjectSequences newCache;
 
         // Find solo clips, if any
         bool hasSoloClips = false;
@@ -673,26 +879,68 @@ void Transport::recacheIfNeeded()
             }
         }
 
+        const double offset = -this->trackStartMs.get();
+        this->sequencesCache.setExportParameters(hasSoloClips, offset);
+        this->playbackHasSoloClips = hasSoloClips;
+
+        // only the changed tracks and clips are re-exported here
+        Array<MidiMessage> tempoMessages;
         for (const auto *track : this->tracksCache)
         {
             const auto instrument = this->linksCache[track->getTrackId()];
-            auto cached = CachedMidiSequence::createFrom(instrument, track->getSequence());
+            const auto sequence = this->sequencesCache.getSequenceFor(track, instrument);
+
+            // frozen tracks are played from their audio, as long as it's still valid
+            const auto frozen = this->frozenTracks.find(track->getTrackId());
+            if (frozen != this->frozenTracks.end())
+            {
+                const auto &info = frozen->second;
+                if (instrument != nullptr && info.instrument == instrument &&
+                    info.hasSoloClips == hasSoloClips &&
+                    info.audio->getSampleRate() == instrument->getProcessorGraph()->getSampleRate())
+                {
+                    newCache.addFrozenTrack(instrument, info.audio, sequence);
+                    continue;
+                }
+
+                this->releasedFrozenAudio.add(info.audio);
+                this->frozenTracks.erase(frozen);
+            }
+
+            newCache.addWrapper(sequence);
 
-            if (track->getPattern() != nullptr)
+            if (track->isTempoTrack())
             {
-                for (const auto *clip : track->getPattern()->getClips())
+                for (const auto *holder : sequence->midiMessages)
                 {
-                    cached->track->exportMidi(cached->midiMessages, *clip, hasSoloClips, offset, 1.0);
+                    tempoMessages.add(holder->message);
                 }
             }
-            else
+        }
+
+        // there's normally only one tempo track, but just in case
+        struct TimeStampSorter final
+        {
+            static int compareElements(const MidiMessage &first, const MidiMessage &second)
             {
-                cached->track->exportMidi(cached->midiMessages, noTransform, hasSoloClips, offset, 1.0);
+                const double diff = first.getTimeStamp() - second.getTimeStamp();
+                return (diff > 0.0) - (diff < 0.0);
             }
+        };
 
-            this->playbackCache.addWrapper(cached);
+        TimeStampSorter sorter;
+        tempoMessages.sort(sorter, true);
+
+        const TempoMap::Ptr newTempoMap(new TempoMap(tempoMessages));
+
+        {
+            const SpinLock::ScopedLockType l(this->sequencesLock);
+            this->playbackCache.swapWith(newCache);
+            this->tempoMap = newTempoMap;
         }
-        
+
+        // the previous cache is released here, out of the lock
+
         this->sequencesAreOutdated = false;
     }
 }
@@ -703,6 +951,12 @@ ProjectSequences Transport::getPlaybackCache()
     return this->playbackCache;
 }
 
+TempoMap::Ptr Transport::getTempoMap()
+{
+    const SpinLock::ScopedLockType l(this->sequencesLock);
+    return this->tempoMap;
+}
+
 void Transport::updateLinkForTrack(const MidiTrack *track)
 {
     const Array<Instrument *> instruments = this->orchestra.getInstruments();
@@ -741,6 +995,32 @@ void Transport::removeLinkForTrack(const MidiTrack *track)
     this->linksCache.erase(track->getTrackId());
 }
 
+//===----------------------------------------------------------------------===//
+// Updating the playback on the fly
+//===----------------------------------------------------------------------===//
+
+void Transport::stopOrUpdatePlayback(int trackControllerNumber)
+{
+    if (trackControllerNumber == MidiTrack::tempoController)
+    {
+        this->stopPlayback();
+    }
+    else if (this->player->isPlaying())
+    {
+        // coalesce the changes, e.g. while dragging the notes around
+        this->triggerAsyncUpdate();
+    }
+}
+
+void Transport::handleAsyncUpdate()
+{
+    if (this->player->isPlaying())
+    {
+        this->recacheIfNeeded();
+        this->player->updatePlayback();
+    }
+}
+
 //===----------------------------------------------------------------------===//
 // Transport Listeners
 //===----------------------------------------------------------------------===//
@@ -18,6 +18,7 @@
 #pragma once
 
 class SleepTimer;
+class TimelineDispatcher;
 class OrchestraPit;
 class PlayerThread;
 class PlayerThreadPool;
@@ -25,17 +26,22 @@ class RendererThread;
 
 #include "TransportListener.h"
 #include "ProjectSequencesWrapper.h"
+#include "ProjectSequencesCache.h"
+#include "TempoMap.h"
 #include "ProjectListener.h"
 #include "OrchestraListener.h"
 #include "Instrument.h"
+#include "LoudnessMeter.h"
 
 class Transport final : public Serializable,
                         public ProjectListener,
-                        private OrchestraListener
+                        private OrchestraListener,
+                        private AsyncUpdater
 {
 public:
 
-    Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer);
+    Transport(OrchestraPit &orchestraPit, SleepTimer &sleepTimer,
+        TimelineDispatcher &timelineDispatcher);
     ~Transport() override;
     
     static String getTimeString(double timeMs, bool includeMilliseconds = false);
@@ -55,6 +61,11 @@ public:
     
     void probeSoundAt(double absTrackPosition, 
         const MidiSequence *limitToLayer = nullptr);
+
+    // Returns note-on messages of all notes sounding at the given position,
+    // e.g. to highlight them in the editor
+    Array<MidiMessage> findSoundingNotesAt(double absTrackPosition,
+        const MidiSequence *limitToLayer = nullptr);
     
     void probeSequence(const MidiMessageSequence &sequence);
 
@@ -65,11 +76,25 @@ public:
     void stopPlayback();
     void toggleStatStopPlayback();
 
-    void startRender(const String &filename);
+    // returns false if the render could not be started
+    bool startRender(const String &filename, bool renderStems = false);
     bool isRendering() const;
     void stopRender();
     
     float getRenderingPercentsComplete() const;
+    LoudnessMeter::Report getRenderLoudnessReport() const;
+
+    //===------------------------------------------------------------------===//
+    // Freezing
+    //===------------------------------------------------------------------===//
+
+    // Renders the track through its instrument in background, and then plays
+    // the rendered audio instead of its messages, until the track, the tempo track,
+    // the track's instrument, or any of its plugins' parameters are changed
+    void freezeTrack(const MidiTrack *track);
+    void unfreezeTrack(const MidiTrack *track);
+    bool isTrackFrozen(const MidiTrack *track) const;
+    bool isFreezing() const;
     
     void calcTimeAndTempoAt(const double absPosition,
         double &outTimeMs, double &outTempo);
@@ -147,21 +172,32 @@ private:
     
     OrchestraPit &orchestra;
     SleepTimer &sleepTimer;
+    TimelineDispatcher &timelineDispatcher;
 
     UniquePointer<PlayerThreadPool> player;
     UniquePointer<RendererThread> renderer;
 
     friend class RendererThread;
     friend class PlayerThread;
+    friend class PlaybackCacheBenchmark;
 
 private:
 
     ProjectSequences getPlaybackCache();
+    TempoMap::Ptr getTempoMap();
     void recacheIfNeeded();
     
     SpinLock sequencesLock;
     ProjectSequences playbackCache;
     bool sequencesAreOutdated;
+    bool playbackHasSoloClips = false;
+
+    // exported sequences for each track and clip,
+    // invalidated partially by project changes
+    ProjectSequencesCache sequencesCache;
+
+    // rebuilt from the tempo track along with the playback cache
+    TempoMap::Ptr tempoMap;
     
     // linksCache is <track id : instrument>
     mutable Array<const MidiTrack *> tracksCache;
@@ -169,33 +205,41 @@ private:
 
     void updateLinkForTrack(const MidiTrack *track);
     void removeLinkForTrack(const MidiTrack *track);
-    
+
+    // Tempo changes affect the timing of everything after them,
+    // so they still stop the playback; other changes are picked up on the fly
+    void stopOrUpdatePlayback(int trackControllerNumber);
+    void handleAsyncUpdate() override;
+
 private:
 
-    /*
-        The purpose of this class is to help with previewing messages on the fly in piano roll.
-        Will simply send messages to queue after a delay, and cancels all pending messages when
-        someone calls allNotesControllersAndSoundOff(); that delay is needed because some plugins
-        (e.g. Kontakt in my case) are often processing play/stop messages out of order, which is weird -
-        note the word `queue` in addMessageToQueue() method name - but it still happens in some cases,
-        for example, when a user drags some notes around quickly. Said that, for whatever reason,
-        JUCE's message collector cannot be relied upon, and this hack is used instead.
-    */
-    class MidiMessageDelayedPreview final : private Timer
+    // the rendered audio is only valid for the same instrument and export parameters
+    struct FrozenTrackInfo final
     {
-    public:
-        MidiMessageDelayedPreview() = default;
-        ~MidiMessageDelayedPreview();
-        void cancelPendingPreview();
-        void previewMessage(const MidiMessage &message, WeakReference<Instrument> instrument);
-    private:
-        void timerCallback() override;
-        Array<WeakReference<Instrument>> instruments;
-        Array<MidiMessage> messages;
+        FrozenAudio::Ptr audio;
+        WeakReference<Instrument> instrument;
+        int channel;
+        bool hasSoloClips;
+        int stateVersion;
+        uint32 stateHash;
     };
 
-    mutable MidiMessageDelayedPreview messagePreviewQueue;
+    // frozen track id : its rendered audio
+    FlatHashMap<String, FrozenTrackInfo, StringHash> frozenTracks;
 
+    // the unfrozen tracks' audio may still be used by the playback,
+    // and it is only released here, so that the audio thread never has to
+    ReferenceCountedArray<FrozenAudio> releasedFrozenAudio;
+    void purgeReleasedFrozenAudio();
+
+    // the track being rendered, if any, cleared if that track changes meanwhile
+    String freezingTrackId;
+
+    // changes in the tempo track unfreeze everything
+    void invalidateFrozenTrack(const MidiTrack *track);
+    void invalidateFrozenTracks();
+    void invalidateChangedFrozenTracks();
+    
 private:
 
     Atomic<double> seekPosition;
@@ -93,8 +93,14 @@ namespace I18n
         static const Identifier renameTrackCaption = "dialog::renametrack::caption";
         static const Identifier renameTrackProceed = "dialog::renametrack::proceed";
         static const Identifier renderAbort = "dialog::render::abort";
+        static const Identifier renderBitDepth16 = "dialog::render::bitdepth16";
+        static const Identifier renderBitDepth24 = "dialog::render::bitdepth24";
+        static const Identifier renderBitDepth32 = "dialog::render::bitdepth32";
+        static const Identifier renderBlockSize = "dialog::render::blocksize";
         static const Identifier renderCaption = "dialog::render::caption";
         static const Identifier renderClose = "dialog::render::close";
+        static const Identifier renderDoublePrecision = "dialog::render::doubleprecision";
+        static const Identifier renderFailed = "dialog::render::failed";
         static const Identifier renderProceed = "dialog::render::proceed";
         static const Identifier renderSelectFile = "dialog::render::selectfile";
         static const Identifier scanFolderCaption = "dialog::scanfolder::caption";
@@ -131,6 +137,7 @@ namespace I18n
         static const Identifier instrumentSetColour = "menu::instrument::setcolour";
         static const Identifier instrumentSetIcon = "menu::instrument::seticon";
         static const Identifier instrumentShowEditor = "menu::instrument::showeditor";
+        static const Identifier instrumentSleepWhenSilent = "menu::instrument::sleepwhensilent";
         static const Identifier instrumentsReload = "menu::instruments::reload";
         static const Identifier instrumentsScanFolder = "menu::instruments::scanfolder";
         static const Identifier keySignatureAdd = "menu::keysignature::add";
@@ -159,6 +166,8 @@ namespace I18n
             static const Identifier renderFlac = "menu::project::render::flac";
             static const Identifier renderMidi = "menu::project::render::midi";
             static const Identifier renderSavedTo = "menu::project::render::savedto";
+            static const Identifier renderStemsFlac = "menu::project::render::stems::flac";
+            static const Identifier renderStemsWav = "menu::project::render::stems::wav";
             static const Identifier renderWav = "menu::project::render::wav";
             static const Identifier transposeDown = "menu::project::transpose::down";
             static const Identifier transposeUp = "menu::project::transpose::up";
@@ -209,8 +218,10 @@ namespace I18n
         static const Identifier trackChangeColour = "menu::track::change::colour";
         static const Identifier trackChangeInstrument = "menu::track::change::instrument";
         static const Identifier trackDelete = "menu::track::delete";
+        static const Identifier trackFreeze = "menu::track::freeze";
         static const Identifier trackRename = "menu::track::rename";
         static const Identifier trackSelectall = "menu::track::selectall";
+        static const Identifier trackUnfreeze = "menu::track::unfreeze";
         static const Identifier tuplet1 = "menu::tuplet::1";
         static const Identifier tuplet2 = "menu::tuplet::2";
         static const Identifier tuplet3 = "menu::tuplet::3";
@@ -276,6 +287,8 @@ namespace I18n
         static const Identifier audioBufferSize = "settings::audio::buffersize";
         static const Identifier audioDevice = "settings::audio::device";
         static const Identifier audioDriver = "settings::audio::driver";
+        static const Identifier audioDropouts = "settings::audio::dropouts";
+        static const Identifier audioLoad = "settings::audio::load";
         static const Identifier audioSampleRate = "settings::audio::samplerate";
         static const Identifier languageHelp = "settings::language::help";
         static const Identifier rendererCoreGraphics = "settings::renderer::coregraphics";
@@ -263,23 +263,7 @@ void AnnotationsSequence::deserialize(const ValueTree &tree)
         return;
     }
 
-    float lastBeat = 0.f;
-    float firstBeat = 0.f;
-
-    forEachValueTreeChildWithType(root, e, Serialization::Midi::annotation)
-    {
-        AnnotationEvent *annotation = new AnnotationEvent(this);
-        annotation->deserialize(e);
-        
-        this->midiEvents.add(annotation); // sorted later
-
-        lastBeat = jmax(lastBeat, annotation->getBeat());
-        firstBeat = jmin(firstBeat, annotation->getBeat());
-
-        this->usedEventIds.insert(annotation->getId());
-    }
-
-    this->sort();
+    this->loadEvents<AnnotationEvent>(root, Serialization::Midi::annotation);
     this->updateBeatRange(false);
 }
 
@@ -253,23 +253,7 @@ void AutomationSequence::deserialize(const ValueTree &tree)
     if (!root.isValid())
     { return; }
 
-    float firstBeat = 0;
-    float lastBeat = 0;
-
-    forEachValueTreeChildWithType(root, e, Serialization::Midi::automationEvent)
-    {
-        auto *event = new AutomationEvent(this, 0, 0);
-        event->deserialize(e);
-        
-        this->midiEvents.add(event); // sorted later
-        
-        lastBeat = jmax(lastBeat, event->getBeat());
-        firstBeat = jmin(firstBeat, event->getBeat());
-
-        this->usedEventIds.insert(event->getId());
-    }
-
-    this->sort();
+    this->loadEvents<AutomationEvent>(root, Serialization::Midi::automationEvent);
     this->updateBeatRange(false);
 }
 
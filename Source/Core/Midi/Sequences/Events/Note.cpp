@@ -229,6 +229,18 @@ void Note::deserialize(const ValueTree &tree) noexcept
     this->tuplet = Tuplet(int(tree.getProperty(Midi::tuplet, 1)));
 }
 
+void Note::deserialize(const ColumnarSerializer::NoteColumns &columns, int index) noexcept
+{
+    this->reset();
+    this->id = columns.getId(index);
+    this->key = columns.getKey(index);
+    this->beat = float(columns.getTimestamp(index)) / TICKS_PER_BEAT;
+    this->length = float(columns.getLength(index)) / TICKS_PER_BEAT;
+    const auto vol = float(columns.getVolume(index)) / VELOCITY_SAVE_ACCURACY;
+    this->velocity = jmax(jmin(vol, 1.f), 0.f);
+    this->tuplet = Tuplet(columns.getTuplet(index));
+}
+
 void Note::reset() noexcept {}
 
 void Note::applyChanges(const Note &other) noexcept
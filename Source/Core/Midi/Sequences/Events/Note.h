@@ -18,6 +18,7 @@
 #pragma once
 
 #include "MidiEvent.h"
+#include "ColumnarSerializer.h"
 
 #define MIDDLE_C 60
 
@@ -74,6 +75,9 @@ public:
     void deserialize(const ValueTree &tree) noexcept override;
     void reset() noexcept override;
 
+    // Reads the note at the given index, when the track is stored in columns
+    void deserialize(const ColumnarSerializer::NoteColumns &columns, int index) noexcept;
+
     //===------------------------------------------------------------------===//
     // Helpers
     //===------------------------------------------------------------------===//
@@ -266,23 +266,7 @@ void KeySignaturesSequence::deserialize(const ValueTree &tree)
         return;
     }
 
-    float lastBeat = 0;
-    float firstBeat = 0;
-
-    forEachValueTreeChildWithType(root, e, Serialization::Midi::keySignature)
-    {
-        auto *signature = new KeySignatureEvent(this);
-        signature->deserialize(e);
-        
-        this->midiEvents.add(signature); // sorted later
-
-        lastBeat = jmax(lastBeat, signature->getBeat());
-        firstBeat = jmin(firstBeat, signature->getBeat());
-
-        this->usedEventIds.insert(signature->getId());
-    }
-
-    this->sort();
+    this->loadEvents<KeySignatureEvent>(root, Serialization::Midi::keySignature);
     this->updateBeatRange(false);
 }
 
@@ -21,6 +21,9 @@
 #include "MidiEvent.h"
 #include "ProjectEventDispatcher.h"
 
+// Bulk loads of this many events or more report their throughput in debug builds
+#define MIDI_SEQUENCE_LOAD_REPORT_MIN_EVENTS 1000
+
 class ProjectNode;
 class MidiTrack;
 class UndoStack;
@@ -158,7 +161,82 @@ protected:
 
     OwnedArray<MidiEvent> midiEvents;
     mutable FlatHashSet<MidiEvent::Id, StringHash> usedEventIds;
-    
+
+    //===------------------------------------------------------------------===//
+    // Bulk loading
+    //===------------------------------------------------------------------===//
+
+    // Used by deserialization: reserves the storage once, reads each event into
+    // a prototype without an owner, so that no ids are generated, and copies it into
+    // the sequence, filling usedEventIds in the same pass; the events are saved sorted,
+    // so they are only sorted here if they come out of order.
+    // The reader is called with the prototype and the index of each of numEvents,
+    // and returns false to skip the index (e.g. a value tree child of another type).
+    // Doesn't notify anybody, call updateBeatRange() when done.
+    template<typename T, typename EventReader>
+    void loadEvents(int numEvents, EventReader readEvent)
+    {
+        const auto startTime = Time::getHighResolutionTicks();
+
+        this->midiEvents.ensureStorageAllocated(this->midiEvents.size() + numEvents);
+        this->usedEventIds.reserve(this->usedEventIds.size() + size_t(numEvents));
+
+        T prototype;
+        bool isSorted = true;
+        const MidiEvent *previous = this->midiEvents.getLast();
+        const int numEventsBefore = this->midiEvents.size();
+
+        for (int i = 0; i < numEvents; ++i)
+        {
+            if (!readEvent(prototype, i))
+            {
+                continue;
+            }
+
+            auto *event = new T(this, prototype);
+            isSorted = isSorted && (previous == nullptr ||
+                MidiEvent::compareElements(previous, event) < 0);
+
+            this->midiEvents.add(event);
+            this->usedEventIds.insert(event->getId());
+            previous = event;
+        }
+
+        if (!isSorted)
+        {
+            this->sort();
+        }
+
+#if DEBUG
+        const auto numLoaded = this->midiEvents.size() - numEventsBefore;
+        if (numLoaded >= MIDI_SEQUENCE_LOAD_REPORT_MIN_EVENTS)
+        {
+            const auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime);
+            DBG("Loaded " + String(numLoaded) + " events" + (isSorted ? "" : ", sorted,") + " at " +
+                String(int64(numLoaded / jmax(seconds, 0.000001))) + " events per second");
+        }
+#else
+        ignoreUnused(startTime, numEventsBefore);
+#endif
+    }
+
+    // The usual case of reading the children of the given type from a value tree
+    template<typename T>
+    void loadEvents(const ValueTree &root, const Identifier &eventType)
+    {
+        this->loadEvents<T>(root.getNumChildren(), [&root, &eventType](T &prototype, int index)
+        {
+            const auto child = root.getChild(index);
+            if (!child.hasType(eventType))
+            {
+                return false;
+            }
+
+            prototype.deserialize(child);
+            return true;
+        });
+    }
+
 private:
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiSequence)
@@ -320,16 +320,17 @@ void PianoSequence::deserialize(const ValueTree &tree)
         return;
     }
 
-    forEachValueTreeChildWithType(root, e, Serialization::Midi::note)
+    // the notes stored in columns are read right from the loaded file
+    if (const auto *columns = ColumnarSerializer::NoteColumns::findIn(root))
     {
-        auto *note = new Note(this);
-        note->deserialize(e);
-
-        this->midiEvents.add(note); // sorted later
-        this->usedEventIds.insert(note->getId());
+        this->loadEvents<Note>(columns->getNumNotes(), [columns](Note &prototype, int index)
+        {
+            prototype.deserialize(*columns, index);
+            return true;
+        });
     }
 
-    this->sort();
+    this->loadEvents<Note>(root, Serialization::Midi::note);
     this->updateBeatRange(false);
 }
 
@@ -268,23 +268,7 @@ void TimeSignaturesSequence::deserialize(const ValueTree &tree)
         return;
     }
 
-    float lastBeat = 0;
-    float firstBeat = 0;
-
-    forEachValueTreeChildWithType(root, e, Serialization::Midi::timeSignature)
-    {
-        TimeSignatureEvent *signature = new TimeSignatureEvent(this);
-        signature->deserialize(e);
-        
-        this->midiEvents.add(signature); // sorted later
-
-        lastBeat = jmax(lastBeat, signature->getBeat());
-        firstBeat = jmin(firstBeat, signature->getBeat());
-
-        this->usedEventIds.insert(signature->getId());
-    }
-
-    this->sort();
+    this->loadEvents<TimeSignatureEvent>(root, Serialization::Midi::timeSignature);
     this->updateBeatRange(false);
 }
 
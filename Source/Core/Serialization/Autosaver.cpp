@@ -44,5 +44,5 @@ void Autosaver::changeListenerCallback(ChangeBroadcaster *source)
 void Autosaver::timerCallback()
 {
     this->stopTimer();
-    this->documentOwner.getDocument()->save();
+    this->documentOwner.getDocument()->saveInBackground();
 }
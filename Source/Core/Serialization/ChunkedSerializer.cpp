@@ -0,0 +1,548 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ChunkedSerializer.h"
+#include "ColumnarSerializer.h"
+#include "DocumentHelpers.h"
+#include "SerializationKeys.h"
+
+static const char *kHelioHeaderV4String = "Helio4::";
+static const uint64 kHelioHeaderV4 = ByteOrder::littleEndianInt64(kHelioHeaderV4String);
+
+#define CHUNKED_FORMAT_VERSION 1
+#define CHUNKED_HEADER_SIZE 32
+#define CHUNKED_INDEX_HEADER_SIZE 24
+#define CHUNKED_INDEX_ENTRY_SIZE 32
+
+// Small containers are not worth compacting
+#define CHUNKED_COMPACTION_MIN_SIZE (1024 * 1024)
+
+static inline int64 alignChunkSize(int64 size) noexcept
+{
+    return (size + 7) & ~int64(7);
+}
+
+//===----------------------------------------------------------------------===//
+// Chunk hashes
+//===----------------------------------------------------------------------===//
+
+// 128 bits made of two different 64-bit hashes of the chunk data,
+// which is plenty to tell the chunks apart, as long as nobody crafts collisions
+struct ChunkHash final
+{
+    uint64 first = 0;
+    uint64 second = 0;
+
+    static ChunkHash fromData(const void *data, size_t size) noexcept
+    {
+        ChunkHash hash;
+        const auto *bytes = static_cast<const uint8 *>(data);
+
+        // FNV-1a
+        hash.first = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash.first = (hash.first ^ bytes[i]) * 1099511628211ULL;
+        }
+
+        // MurmurHash64A
+        const uint64 m = 0xc6a4a7935bd1e995ULL;
+        const int r = 47;
+        uint64 h = 0x48656c696f344bULL ^ (uint64(size) * m);
+
+        const size_t numBlocks = size / 8;
+        for (size_t i = 0; i < numBlocks; ++i)
+        {
+            uint64 k;
+            memcpy(&k, bytes + i * 8, 8);
+            k = ByteOrder::swapIfBigEndian(k);
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+
+        const auto *tail = bytes + numBlocks * 8;
+        switch (size & 7)
+        {
+            case 7: h ^= uint64(tail[6]) << 48;
+            case 6: h ^= uint64(tail[5]) << 40;
+            case 5: h ^= uint64(tail[4]) << 32;
+            case 4: h ^= uint64(tail[3]) << 24;
+            case 3: h ^= uint64(tail[2]) << 16;
+            case 2: h ^= uint64(tail[1]) << 8;
+            case 1: h ^= uint64(tail[0]);
+                h *= m;
+            default: break;
+        };
+
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+
+        hash.second = h;
+        return hash;
+    }
+
+    String toString() const
+    {
+        return String::toHexString(int64(this->first)).paddedLeft('0', 16) +
+            String::toHexString(int64(this->second)).paddedLeft('0', 16);
+    }
+
+    static ChunkHash fromString(const String &string)
+    {
+        ChunkHash hash;
+        hash.first = uint64(string.substring(0, 16).getHexValue64());
+        hash.second = uint64(string.substring(16, 32).getHexValue64());
+        return hash;
+    }
+};
+
+struct ChunkLocation final
+{
+    int64 offset;
+    int64 size;
+};
+
+using ChunkLocations = FlatHashMap<String, ChunkLocation, StringHash>;
+
+//===----------------------------------------------------------------------===//
+// Splitting the tree into chunks
+//===----------------------------------------------------------------------===//
+
+static bool isChunkRoot(const ValueTree &node)
+{
+    using namespace Serialization;
+
+    if (node.hasType(Core::treeNode))
+    {
+        const String type = node.getProperty(Core::treeNodeType);
+        return type == Core::pianoTrack.toString() ||
+            type == Core::automationTrack.toString();
+    }
+
+    return node.hasType(Core::projectTimeline) ||
+        node.hasType(Undo::transaction) ||
+        node.hasType(VCS::revision) ||
+        node.hasType(VCS::revisionItem);
+}
+
+// Serializes the tree bottom-up, since each chunk refers to its children by their hashes,
+// and collects the unique chunks in the order they should be written
+class ChunkBuilder final
+{
+public:
+
+    String addChunk(const ValueTree &node)
+    {
+        MemoryOutputStream data;
+        this->serializer.write(data, node, [this](const ValueTree &child) -> ValueTree
+        {
+            if (!isChunkRoot(child))
+            {
+                return ValueTree();
+            }
+
+            ValueTree placeholder(Serialization::Core::chunk);
+            placeholder.setProperty(Serialization::Core::chunkHash, this->addChunk(child), nullptr);
+            return placeholder;
+        });
+
+        const auto hash = ChunkHash::fromData(data.getData(), data.getDataSize()).toString();
+        if (!this->chunks.contains(hash))
+        {
+            this->chunks[hash] = data.getMemoryBlock();
+            this->order.add(hash);
+        }
+
+        return hash;
+    }
+
+    const StringArray &getHashes() const noexcept
+    {
+        return this->order;
+    }
+
+    const MemoryBlock &getData(const String &hash) const
+    {
+        return this->chunks.at(hash);
+    }
+
+private:
+
+    ColumnarSerializer serializer;
+    FlatHashMap<String, MemoryBlock, StringHash> chunks;
+    StringArray order;
+
+};
+
+//===----------------------------------------------------------------------===//
+// Writing
+//===----------------------------------------------------------------------===//
+
+static void padChunk(OutputStream &out)
+{
+    const auto position = out.getPosition();
+    out.writeRepeatedByte(0, size_t(alignChunkSize(position) - position));
+}
+
+static int64 getIndexSize(int numChunks) noexcept
+{
+    return CHUNKED_INDEX_HEADER_SIZE + int64(numChunks) * CHUNKED_INDEX_ENTRY_SIZE;
+}
+
+// Writes the chunks missing in the locations, then the index of all the builder's chunks,
+// and returns the location of the index; the stream is expected to be 8-byte aligned
+static ChunkLocation writeChunksAndIndex(OutputStream &out,
+    const ChunkBuilder &builder, const String &rootHash, ChunkLocations &locations)
+{
+    for (const auto &hash : builder.getHashes())
+    {
+        if (!locations.contains(hash))
+        {
+            const auto &data = builder.getData(hash);
+            locations[hash] = { out.getPosition(), int64(data.getSize()) };
+            out.write(data.getData(), data.getSize());
+            padChunk(out);
+        }
+    }
+
+    const ChunkLocation index = { out.getPosition(), getIndexSize(builder.getHashes().size()) };
+
+    const auto root = ChunkHash::fromString(rootHash);
+    out.writeInt64(int64(root.first));
+    out.writeInt64(int64(root.second));
+    out.writeInt(builder.getHashes().size());
+    out.writeInt(0);
+
+    for (const auto &hash : builder.getHashes())
+    {
+        const auto chunk = ChunkHash::fromString(hash);
+        const auto &location = locations.at(hash);
+        out.writeInt64(int64(chunk.first));
+        out.writeInt64(int64(chunk.second));
+        out.writeInt64(location.offset);
+        out.writeInt64(location.size);
+    }
+
+    padChunk(out);
+    return index;
+}
+
+static void writeHeader(OutputStream &out, const ChunkLocation &index)
+{
+    out.writeInt64(int64(kHelioHeaderV4));
+    out.writeInt(CHUNKED_FORMAT_VERSION);
+    out.writeInt(0);
+    out.writeInt64(index.offset);
+    out.writeInt64(index.size);
+}
+
+static Result writeContainer(OutputStream &out, const ChunkBuilder &builder, const String &rootHash)
+{
+    ChunkLocations locations;
+    writeHeader(out, { 0, 0 });
+    const auto index = writeChunksAndIndex(out, builder, rootHash, locations);
+
+    if (!out.setPosition(0))
+    {
+        return Result::fail("Failed to save");
+    }
+
+    writeHeader(out, index);
+    return Result::ok();
+}
+
+//===----------------------------------------------------------------------===//
+// Reading
+//===----------------------------------------------------------------------===//
+
+static Result readIndex(const char *data, int64 size,
+    String &outRootHash, ChunkLocations &outLocations)
+{
+    if (data == nullptr || size < CHUNKED_HEADER_SIZE ||
+        ByteOrder::littleEndianInt64(data) != kHelioHeaderV4)
+    {
+        return Result::fail("Failed to load");
+    }
+
+    MemoryInputStream header(data, CHUNKED_HEADER_SIZE, false);
+    header.skipNextBytes(8);
+
+    const int version = header.readInt();
+    header.skipNextBytes(4);
+    const int64 indexOffset = header.readInt64();
+    const int64 indexSize = header.readInt64();
+
+    if (version > CHUNKED_FORMAT_VERSION || indexOffset < CHUNKED_HEADER_SIZE ||
+        indexSize < CHUNKED_INDEX_HEADER_SIZE || indexOffset + indexSize > size)
+    {
+        return Result::fail("Unsupported file version");
+    }
+
+    MemoryInputStream index(data + indexOffset, size_t(indexSize), false);
+
+    ChunkHash root;
+    root.first = uint64(index.readInt64());
+    root.second = uint64(index.readInt64());
+    const int numChunks = index.readInt();
+    index.skipNextBytes(4);
+
+    if (numChunks < 0 || getIndexSize(numChunks) > indexSize)
+    {
+        return Result::fail("Corrupted file");
+    }
+
+    outLocations.reserve(size_t(numChunks));
+    for (int i = 0; i < numChunks; ++i)
+    {
+        ChunkHash hash;
+        hash.first = uint64(index.readInt64());
+        hash.second = uint64(index.readInt64());
+        const int64 offset = index.readInt64();
+        const int64 chunkSize = index.readInt64();
+
+        if (offset < CHUNKED_HEADER_SIZE || chunkSize < 0 || offset + chunkSize > size)
+        {
+            return Result::fail("Corrupted file");
+        }
+
+        outLocations[hash.toString()] = { offset, chunkSize };
+    }
+
+    outRootHash = root.toString();
+    return Result::ok();
+}
+
+class ChunkReader final
+{
+public:
+
+    ChunkReader(ColumnarSerializer::Storage::Ptr storage, const ChunkLocations &locations) :
+        storage(storage), locations(locations) {}
+
+    Result readChunk(const String &hash, ValueTree &tree)
+    {
+        const auto found = this->locations.find(hash);
+        if (found == this->locations.end() || this->chunksBeingRead.contains(hash))
+        {
+            return Result::fail("Corrupted file");
+        }
+
+        const auto result = this->serializer.read(this->storage,
+            found->second.offset, found->second.size, tree);
+
+        if (result.failed())
+        {
+            return result;
+        }
+
+        this->chunksBeingRead.insert(hash);
+        const auto childrenResult = this->resolvePlaceholders(tree);
+        this->chunksBeingRead.erase(hash);
+        return childrenResult;
+    }
+
+private:
+
+    Result resolvePlaceholders(ValueTree &node)
+    {
+        for (int i = 0; i < node.getNumChildren(); ++i)
+        {
+            auto child = node.getChild(i);
+            if (child.hasType(Serialization::Core::chunk))
+            {
+                ValueTree chunk;
+                const auto result = this->readChunk(child.getProperty(Serialization::Core::chunkHash), chunk);
+                if (result.failed())
+                {
+                    return result;
+                }
+
+                node.removeChild(i, nullptr);
+                node.addChild(chunk, i, nullptr);
+            }
+            else
+            {
+                const auto result = this->resolvePlaceholders(child);
+                if (result.failed())
+                {
+                    return result;
+                }
+            }
+        }
+
+        return Result::ok();
+    }
+
+    ColumnarSerializer serializer;
+    ColumnarSerializer::Storage::Ptr storage;
+    const ChunkLocations &locations;
+    FlatHashSet<String, StringHash> chunksBeingRead;
+
+};
+
+static Result readContainer(ColumnarSerializer::Storage::Ptr storage, ValueTree &tree)
+{
+    String rootHash;
+    ChunkLocations locations;
+    const auto result = readIndex(storage->getData(), storage->getSize(), rootHash, locations);
+    if (result.failed())
+    {
+        return result;
+    }
+
+    ChunkReader reader(storage, locations);
+    return reader.readChunk(rootHash, tree);
+}
+
+//===----------------------------------------------------------------------===//
+// Serializer
+//===----------------------------------------------------------------------===//
+
+// Saves in place, if the file is a container already, and it doesn't need compaction;
+// otherwise the whole container is written into a temporary file which then replaces the target
+Result ChunkedSerializer::saveToFile(File file, const ValueTree &tree) const
+{
+    ChunkBuilder builder;
+    const auto rootHash = builder.addChunk(tree);
+
+    String existingRootHash;
+    ChunkLocations locations;
+    int64 existingSize = 0;
+
+    if (file.existsAsFile())
+    {
+        // only the header and the index are read here
+        MemoryMappedFile existing(file, MemoryMappedFile::readOnly, false);
+        existingSize = int64(existing.getSize());
+        if (readIndex(static_cast<const char *>(existing.getData()),
+            existingSize, existingRootHash, locations).failed())
+        {
+            locations.clear();
+            existingSize = 0;
+        }
+    }
+
+    if (existingSize > 0 && existingRootHash == rootHash)
+    {
+        return Result::ok(); // nothing has changed
+    }
+
+    int64 liveSize = CHUNKED_HEADER_SIZE + alignChunkSize(getIndexSize(builder.getHashes().size()));
+    int64 appendedSize = alignChunkSize(getIndexSize(builder.getHashes().size()));
+    for (const auto &hash : builder.getHashes())
+    {
+        const auto chunkSize = alignChunkSize(int64(builder.getData(hash).getSize()));
+        liveSize += chunkSize;
+        appendedSize += locations.contains(hash) ? 0 : chunkSize;
+    }
+
+    const auto sizeAfterAppending = alignChunkSize(existingSize) + appendedSize;
+    const bool needsCompaction = sizeAfterAppending - liveSize > liveSize &&
+        sizeAfterAppending > CHUNKED_COMPACTION_MIN_SIZE;
+
+    if (existingSize > 0 && !needsCompaction)
+    {
+        FileOutputStream out(file); // positioned at the end
+        if (!out.openedOk() || out.getPosition() != existingSize)
+        {
+            return Result::fail("Failed to save");
+        }
+
+        padChunk(out);
+        const auto index = writeChunksAndIndex(out, builder, rootHash, locations);
+
+        // the new chunks and the index should reach the disk before the header points to them
+        out.flush();
+        if (out.getStatus().failed() || !out.setPosition(0))
+        {
+            return Result::fail("Failed to save");
+        }
+
+        writeHeader(out, index);
+        out.flush();
+        return out.getStatus();
+    }
+
+    DocumentHelpers::TempDocument tempDoc(file);
+
+    {
+        FileOutputStream out(tempDoc.getFile());
+        if (!out.openedOk())
+        {
+            return Result::fail("Failed to save");
+        }
+
+        out.setPosition(0);
+        out.truncate();
+        const auto result = writeContainer(out, builder, rootHash);
+        out.flush();
+        if (result.failed() || out.getStatus().failed())
+        {
+            return Result::fail("Failed to save");
+        }
+    }
+
+    return tempDoc.overwriteTargetFileWithTemporary() ?
+        Result::ok() : Result::fail("Failed to save");
+}
+
+Result ChunkedSerializer::loadFromFile(const File &file, ValueTree &tree) const
+{
+    ColumnarSerializer::Storage::Ptr storage(new ColumnarSerializer::Storage(file));
+    return readContainer(storage, tree);
+}
+
+Result ChunkedSerializer::saveToString(String &string, const ValueTree &tree) const
+{
+    ChunkBuilder builder;
+    const auto rootHash = builder.addChunk(tree);
+
+    MemoryOutputStream memStream;
+    const auto result = writeContainer(memStream, builder, rootHash);
+    string = String(kHelioHeaderV4String) + memStream.getMemoryBlock().toBase64Encoding();
+    return result;
+}
+
+Result ChunkedSerializer::loadFromString(const String &string, ValueTree &tree) const
+{
+    if (string.startsWith(kHelioHeaderV4String))
+    {
+        MemoryBlock data;
+        if (data.fromBase64Encoding(string.substring(int(strlen(kHelioHeaderV4String)))))
+        {
+            ColumnarSerializer::Storage::Ptr storage(new ColumnarSerializer::Storage(std::move(data)));
+            return readContainer(storage, tree);
+        }
+    }
+
+    return Result::fail("Failed to load");
+}
+
+bool ChunkedSerializer::supportsFileWithExtension(const String &extension) const
+{
+    return extension.endsWithIgnoreCase("helio");
+}
+
+bool ChunkedSerializer::supportsFileWithHeader(const String &header) const
+{
+    return header.startsWith(kHelioHeaderV4String);
+}
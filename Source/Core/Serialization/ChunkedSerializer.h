@@ -0,0 +1,51 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Serializer.h"
+
+// The project container, in which the tracks, the timeline, the undo transactions,
+// and each VCS revision and revision item live in separate chunks, addressed
+// by the hashes of their contents, each written in the columnar format:
+//
+//  "Helio4::" | version | index offset and size
+//  chunk | chunk | ... | index | chunk | ... | index
+//
+// The index lists the hash of the root chunk, and the location of each live chunk.
+// The nodes split into chunks are replaced by placeholders referencing them, so
+// the chunk of a VCS revision only changes when a child revision is committed.
+//
+// Saving to an existing container only appends the chunks it doesn't have yet,
+// followed by a new index, and then points the header to it, so that the file
+// stays valid if the save gets interrupted; once the unreferenced chunks take
+// more space than the live ones, the container is compacted, i.e. rewritten.
+
+class ChunkedSerializer final : public Serializer
+{
+public:
+
+    Result saveToFile(File file, const ValueTree &tree) const override;
+    Result loadFromFile(const File &file, ValueTree &tree) const override;
+
+    Result saveToString(String &string, const ValueTree &tree) const override;
+    Result loadFromString(const String &string, ValueTree &tree) const override;
+
+    bool supportsFileWithExtension(const String &extension) const override;
+    bool supportsFileWithHeader(const String &header) const override;
+
+};
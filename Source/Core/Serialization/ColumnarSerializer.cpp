@@ -0,0 +1,471 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ColumnarSerializer.h"
+#include "SerializationKeys.h"
+
+static const char *kHelioHeaderV3String = "Helio3::";
+static const uint64 kHelioHeaderV3 = ByteOrder::littleEndianInt64(kHelioHeaderV3String);
+
+#define COLUMNAR_FORMAT_VERSION 1
+#define COLUMNAR_HEADER_SIZE 32
+#define COLUMNAR_TOC_ENTRY_SIZE 16
+
+// The columns are aligned, so that they could be read right from the mapped memory
+static inline int64 alignColumnsSize(int64 size) noexcept
+{
+    return (size + 7) & ~int64(7);
+}
+
+static inline int64 getTupletsOffset(int numNotes) noexcept
+{
+    return int64(numNotes) * 20;
+}
+
+static inline int64 getIdsOffset(int numNotes) noexcept
+{
+    return getTupletsOffset(numNotes) + ((int64(numNotes) + 3) & ~int64(3));
+}
+
+// 4 int32 columns, the ids offsets, the tuplets padded to 4 bytes, and the ids
+static inline int64 getColumnsSize(int numNotes, int idsSize) noexcept
+{
+    return alignColumnsSize(getIdsOffset(numNotes) + idsSize);
+}
+
+//===----------------------------------------------------------------------===//
+// Storage
+//===----------------------------------------------------------------------===//
+
+ColumnarSerializer::Storage::Storage(const File &file) :
+    mappedFile(new MemoryMappedFile(file, MemoryMappedFile::readOnly, false)) {}
+
+ColumnarSerializer::Storage::Storage(MemoryBlock &&data) :
+    block(std::move(data)) {}
+
+const char *ColumnarSerializer::Storage::getData() const noexcept
+{
+    return this->mappedFile != nullptr ?
+        static_cast<const char *>(this->mappedFile->getData()) :
+        static_cast<const char *>(this->block.getData());
+}
+
+int64 ColumnarSerializer::Storage::getSize() const noexcept
+{
+    return this->mappedFile != nullptr ?
+        int64(this->mappedFile->getSize()) : int64(this->block.getSize());
+}
+
+//===----------------------------------------------------------------------===//
+// NoteColumns
+//===----------------------------------------------------------------------===//
+
+ColumnarSerializer::NoteColumns::NoteColumns(Storage::Ptr storage,
+    const char *data, int numNotes, int idsSize) noexcept :
+    storage(storage),
+    numNotes(numNotes),
+    timestamps(reinterpret_cast<const int32 *>(data)),
+    keys(reinterpret_cast<const int32 *>(data) + numNotes),
+    lengths(reinterpret_cast<const int32 *>(data) + numNotes * 2),
+    volumes(reinterpret_cast<const int32 *>(data) + numNotes * 3),
+    idOffsets(reinterpret_cast<const uint32 *>(data) + numNotes * 4),
+    tuplets(reinterpret_cast<const int8 *>(data + getTupletsOffset(numNotes))),
+    ids(data + getIdsOffset(numNotes)),
+    idsSize(idsSize) {}
+
+ColumnarSerializer::NoteColumns::~NoteColumns() = default;
+
+ColumnarSerializer::NoteColumns *ColumnarSerializer::NoteColumns::findIn(const ValueTree &track)
+{
+    return dynamic_cast<NoteColumns *>(track.getProperty(Serialization::Midi::columns).getObject());
+}
+
+String ColumnarSerializer::NoteColumns::getId(int index) const
+{
+    const auto offset = int(ByteOrder::swapIfBigEndian(this->idOffsets[index]));
+    if (offset >= this->idsSize)
+    {
+        jassertfalse;
+        return {};
+    }
+
+    // ids are null-terminated, and the last one is checked to be so when loading
+    return String(CharPointer_UTF8(this->ids + offset));
+}
+
+int ColumnarSerializer::NoteColumns::getKey(int index) const noexcept
+{
+    return int(ByteOrder::swapIfBigEndian(this->keys[index]));
+}
+
+int ColumnarSerializer::NoteColumns::getTimestamp(int index) const noexcept
+{
+    return int(ByteOrder::swapIfBigEndian(this->timestamps[index]));
+}
+
+int ColumnarSerializer::NoteColumns::getLength(int index) const noexcept
+{
+    return int(ByteOrder::swapIfBigEndian(this->lengths[index]));
+}
+
+int ColumnarSerializer::NoteColumns::getVolume(int index) const noexcept
+{
+    return int(ByteOrder::swapIfBigEndian(this->volumes[index]));
+}
+
+int ColumnarSerializer::NoteColumns::getTuplet(int index) const noexcept
+{
+    return jmax(1, int(this->tuplets[index]));
+}
+
+//===----------------------------------------------------------------------===//
+// Writing
+//===----------------------------------------------------------------------===//
+
+// Only the tracks containing nothing but the plain notes are stored in columns,
+// anything else (e.g. a track saved by some future version) is kept in the skeleton
+static bool canStoreInColumns(const ValueTree &node)
+{
+    using namespace Serialization;
+
+    if (!node.hasType(Midi::track) || node.getNumProperties() > 0 || node.getNumChildren() == 0)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < node.getNumChildren(); ++i)
+    {
+        const auto note = node.getChild(i);
+        if (!note.hasType(Midi::note) || note.getNumChildren() > 0 || !note.hasProperty(Midi::id))
+        {
+            return false;
+        }
+
+        for (int j = 0; j < note.getNumProperties(); ++j)
+        {
+            const auto name = note.getPropertyName(j);
+            if (name != Midi::id && name != Midi::key && name != Midi::timestamp &&
+                name != Midi::length && name != Midi::volume && name != Midi::tuplet)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static ValueTree createColumnarSkeleton(const ValueTree &node, Array<ValueTree> &outTracks,
+    const ColumnarSerializer::Substitution &substitution)
+{
+    // normally, the tracks loaded in columns are re-serialized before saving,
+    // but if some part of the loaded tree is saved as is, its notes should not get lost
+    if (ColumnarSerializer::NoteColumns::findIn(node) != nullptr)
+    {
+        return createColumnarSkeleton(ColumnarSerializer::expandNoteColumns(node),
+            outTracks, substitution);
+    }
+
+    if (canStoreInColumns(node))
+    {
+        ValueTree placeholder(node.getType());
+        placeholder.setProperty(Serialization::Midi::columns, outTracks.size(), nullptr);
+        outTracks.add(node);
+        return placeholder;
+    }
+
+    ValueTree skeleton(node.getType());
+    skeleton.copyPropertiesFrom(node, nullptr);
+    for (int i = 0; i < node.getNumChildren(); ++i)
+    {
+        const auto child = node.getChild(i);
+        const auto substitute = substitution != nullptr ? substitution(child) : ValueTree();
+        skeleton.appendChild(substitute.isValid() ? substitute :
+            createColumnarSkeleton(child, outTracks, substitution), nullptr);
+    }
+
+    return skeleton;
+}
+
+static void writeNoteColumns(OutputStream &stream, const ValueTree &track, int idsSize)
+{
+    using namespace Serialization;
+
+    const int numNotes = track.getNumChildren();
+
+    const auto writeColumn = [&](const Identifier &property, int defaultValue)
+    {
+        for (int i = 0; i < numNotes; ++i)
+        {
+            stream.writeInt(track.getChild(i).getProperty(property, defaultValue));
+        }
+    };
+
+    writeColumn(Midi::timestamp, 0);
+    writeColumn(Midi::key, 0);
+    writeColumn(Midi::length, 0);
+    writeColumn(Midi::volume, 0);
+
+    uint32 idOffset = 0;
+    for (int i = 0; i < numNotes; ++i)
+    {
+        stream.writeInt(int(idOffset));
+        idOffset += uint32(track.getChild(i).getProperty(Midi::id).toString().getNumBytesAsUTF8() + 1);
+    }
+
+    for (int64 i = 0; i < getIdsOffset(numNotes) - getTupletsOffset(numNotes); ++i)
+    {
+        const int tuplet = i < numNotes ? int(track.getChild(int(i)).getProperty(Midi::tuplet, 1)) : 0;
+        stream.writeByte(char(jlimit(0, 127, tuplet)));
+    }
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        const auto id = track.getChild(i).getProperty(Midi::id).toString();
+        stream.write(id.toRawUTF8(), id.getNumBytesAsUTF8() + 1);
+    }
+
+    const auto padding = getColumnsSize(numNotes, idsSize) - getIdsOffset(numNotes) - idsSize;
+    stream.writeRepeatedByte(0, size_t(padding));
+}
+
+Result ColumnarSerializer::write(OutputStream &stream,
+    const ValueTree &tree, const Substitution &substitution) const
+{
+    Array<ValueTree> tracks;
+    const auto skeleton = createColumnarSkeleton(tree, tracks, substitution);
+
+    MemoryOutputStream skeletonData;
+    skeleton.writeToStream(skeletonData);
+
+    Array<int> idsSizes;
+    const auto start = stream.getPosition();
+    int64 offset = COLUMNAR_HEADER_SIZE + int64(tracks.size()) * COLUMNAR_TOC_ENTRY_SIZE;
+    offset = alignColumnsSize(offset);
+    const auto columnsOffset = offset;
+
+    for (const auto &track : tracks)
+    {
+        int idsSize = 0;
+        for (int i = 0; i < track.getNumChildren(); ++i)
+        {
+            idsSize += int(track.getChild(i).getProperty(Serialization::Midi::id).toString().getNumBytesAsUTF8()) + 1;
+        }
+
+        idsSizes.add(idsSize);
+        offset += getColumnsSize(track.getNumChildren(), idsSize);
+    }
+
+    stream.writeInt64(int64(kHelioHeaderV3));
+    stream.writeInt(COLUMNAR_FORMAT_VERSION);
+    stream.writeInt(tracks.size());
+    stream.writeInt64(offset);
+    stream.writeInt64(int64(skeletonData.getDataSize()));
+
+    int64 trackOffset = columnsOffset;
+    for (int i = 0; i < tracks.size(); ++i)
+    {
+        const int numNotes = tracks.getReference(i).getNumChildren();
+        stream.writeInt64(trackOffset);
+        stream.writeInt(numNotes);
+        stream.writeInt(idsSizes[i]);
+        trackOffset += getColumnsSize(numNotes, idsSizes[i]);
+    }
+
+    // all offsets are relative to the start, so that the data could be embedded, see ChunkedSerializer
+    stream.writeRepeatedByte(0, size_t(columnsOffset - (stream.getPosition() - start)));
+
+    for (int i = 0; i < tracks.size(); ++i)
+    {
+        writeNoteColumns(stream, tracks.getReference(i), idsSizes[i]);
+    }
+
+    jassert(stream.getPosition() - start == offset);
+    stream << skeletonData;
+    return Result::ok();
+}
+
+Result ColumnarSerializer::saveToFile(File file, const ValueTree &tree) const
+{
+    FileOutputStream fileStream(file);
+    if (fileStream.openedOk())
+    {
+        fileStream.setPosition(0);
+        fileStream.truncate();
+        return this->write(fileStream, tree);
+    }
+
+    return Result::fail("Failed to save");
+}
+
+Result ColumnarSerializer::saveToString(String &string, const ValueTree &tree) const
+{
+    // the columns are binary, so they are base64-encoded after the readable header,
+    // so that the format could still be detected by DocumentHelpers::load
+    MemoryOutputStream memStream;
+    const auto result = this->write(memStream, tree);
+    string = String(kHelioHeaderV3String) + memStream.getMemoryBlock().toBase64Encoding();
+    return result;
+}
+
+//===----------------------------------------------------------------------===//
+// Reading
+//===----------------------------------------------------------------------===//
+
+static void attachNoteColumns(ValueTree &node, const Array<ColumnarSerializer::NoteColumns::Ptr> &columns)
+{
+    const auto *index = node.getPropertyPointer(Serialization::Midi::columns);
+    if (index != nullptr && node.hasType(Serialization::Midi::track))
+    {
+        const auto i = int(*index);
+        node.setProperty(Serialization::Midi::columns,
+            isPositiveAndBelow(i, columns.size()) ? var(columns[i].get()) : var(), nullptr);
+        return;
+    }
+
+    for (int i = 0; i < node.getNumChildren(); ++i)
+    {
+        auto child = node.getChild(i);
+        attachNoteColumns(child, columns);
+    }
+}
+
+ValueTree ColumnarSerializer::expandNoteColumns(const ValueTree &tree)
+{
+    using namespace Serialization;
+
+    ValueTree copy(tree.getType());
+    copy.copyPropertiesFrom(tree, nullptr);
+
+    if (const auto *columns = NoteColumns::findIn(tree))
+    {
+        copy.removeProperty(Midi::columns, nullptr);
+
+        // same as Note::serialize does
+        for (int i = 0; i < columns->getNumNotes(); ++i)
+        {
+            ValueTree note(Midi::note);
+            note.setProperty(Midi::id, columns->getId(i), nullptr);
+            note.setProperty(Midi::key, columns->getKey(i), nullptr);
+            note.setProperty(Midi::timestamp, columns->getTimestamp(i), nullptr);
+            note.setProperty(Midi::length, columns->getLength(i), nullptr);
+            note.setProperty(Midi::volume, columns->getVolume(i), nullptr);
+            if (columns->getTuplet(i) > 1)
+            {
+                note.setProperty(Midi::tuplet, columns->getTuplet(i), nullptr);
+            }
+
+            copy.appendChild(note, nullptr);
+        }
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        copy.appendChild(expandNoteColumns(tree.getChild(i)), nullptr);
+    }
+
+    return copy;
+}
+
+Result ColumnarSerializer::read(Storage::Ptr storage,
+    int64 dataOffset, int64 size, ValueTree &tree) const
+{
+    if (storage->getData() == nullptr || dataOffset < 0 ||
+        (dataOffset & 7) != 0 || dataOffset + size > storage->getSize())
+    {
+        return Result::fail("Failed to load");
+    }
+
+    const auto *data = storage->getData() + dataOffset;
+
+    if (size < COLUMNAR_HEADER_SIZE ||
+        ByteOrder::littleEndianInt64(data) != kHelioHeaderV3)
+    {
+        return Result::fail("Failed to load");
+    }
+
+    MemoryInputStream header(data, COLUMNAR_HEADER_SIZE, false);
+    header.skipNextBytes(8);
+
+    const int version = header.readInt();
+    const int numTracks = header.readInt();
+    const int64 skeletonOffset = header.readInt64();
+    const int64 skeletonSize = header.readInt64();
+
+    if (version > COLUMNAR_FORMAT_VERSION || numTracks < 0 ||
+        COLUMNAR_HEADER_SIZE + int64(numTracks) * COLUMNAR_TOC_ENTRY_SIZE > size ||
+        skeletonOffset < 0 || skeletonSize < 0 || skeletonOffset + skeletonSize > size)
+    {
+        return Result::fail("Unsupported file version");
+    }
+
+    Array<NoteColumns::Ptr> columns;
+    MemoryInputStream toc(data + COLUMNAR_HEADER_SIZE,
+        size_t(numTracks) * COLUMNAR_TOC_ENTRY_SIZE, false);
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        const int64 offset = toc.readInt64();
+        const int numNotes = toc.readInt();
+        const int idsSize = toc.readInt();
+
+        if (offset < 0 || (offset & 7) != 0 || numNotes < 0 || idsSize < numNotes ||
+            offset + getColumnsSize(numNotes, idsSize) > size ||
+            (idsSize > 0 && data[offset + getIdsOffset(numNotes) + idsSize - 1] != 0))
+        {
+            return Result::fail("Corrupted file");
+        }
+
+        columns.add(new NoteColumns(storage, data + offset, numNotes, idsSize));
+    }
+
+    tree = ValueTree::readFromData(data + skeletonOffset, size_t(skeletonSize));
+    attachNoteColumns(tree, columns);
+    return Result::ok();
+}
+
+Result ColumnarSerializer::loadFromFile(const File &file, ValueTree &tree) const
+{
+    Storage::Ptr storage(new Storage(file));
+    return this->read(storage, 0, storage->getSize(), tree);
+}
+
+Result ColumnarSerializer::loadFromString(const String &string, ValueTree &tree) const
+{
+    if (string.startsWith(kHelioHeaderV3String))
+    {
+        MemoryBlock data;
+        if (data.fromBase64Encoding(string.substring(int(strlen(kHelioHeaderV3String)))))
+        {
+            Storage::Ptr storage(new Storage(std::move(data)));
+            return this->read(storage, 0, storage->getSize(), tree);
+        }
+    }
+
+    return Result::fail("Failed to load");
+}
+
+bool ColumnarSerializer::supportsFileWithExtension(const String &extension) const
+{
+    return extension.endsWithIgnoreCase("helio");
+}
+
+bool ColumnarSerializer::supportsFileWithHeader(const String &header) const
+{
+    return header.startsWith(kHelioHeaderV3String);
+}
@@ -0,0 +1,128 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Serializer.h"
+
+// The project format which stores the notes of each piano track as packed columns
+// (timestamps, keys, lengths, volumes, tuplets and ids), followed by the rest of the tree,
+// written as a usual binary value tree, in which the tracks only keep their column indices:
+//
+//  "Helio3::" | version | number of tracks | skeleton offset and size
+//  table of contents: offset, number of notes and ids size for each track
+//  columns of track 0 | columns of track 1 | ... | skeleton
+//
+// The file is memory-mapped when loading, and the notes are not turned into value trees:
+// each track node in the loaded tree references its columns (see NoteColumns::findIn),
+// which are only decoded when the track is deserialized, and only if it is deserialized.
+// Since the mapping is kept alive by those references, the loaded tree should not
+// be kept around after the deserialization, so that the file could be overwritten;
+// the parts of it which are kept (e.g. the track snapshots in the undo actions)
+// should be copied with expandNoteColumns instead.
+
+class ColumnarSerializer final : public Serializer
+{
+public:
+
+    Result saveToFile(File file, const ValueTree &tree) const override;
+    Result loadFromFile(const File &file, ValueTree &tree) const override;
+
+    Result saveToString(String &string, const ValueTree &tree) const override;
+    Result loadFromString(const String &string, ValueTree &tree) const override;
+
+    bool supportsFileWithExtension(const String &extension) const override;
+    bool supportsFileWithHeader(const String &header) const override;
+
+    // Either the memory-mapped file, or the data decoded from a string
+    class Storage final : public ReferenceCountedObject
+    {
+    public:
+
+        using Ptr = ReferenceCountedObjectPtr<Storage>;
+
+        explicit Storage(const File &file);
+        explicit Storage(MemoryBlock &&data);
+
+        const char *getData() const noexcept;
+        int64 getSize() const noexcept;
+
+    private:
+
+        UniquePointer<MemoryMappedFile> mappedFile;
+        MemoryBlock block;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Storage)
+    };
+
+    // Called for each node below the root while writing: returns a node
+    // to be written instead of the given one, or an invalid tree to write it as is
+    using Substitution = Function<ValueTree(const ValueTree &node)>;
+
+    // Writes the tree into the stream in the columnar format,
+    // and reads it back from the given range of the storage, which is expected
+    // to be 8-byte aligned; this is how ChunkedSerializer stores each chunk
+    Result write(OutputStream &stream, const ValueTree &tree,
+        const Substitution &substitution = nullptr) const;
+    Result read(Storage::Ptr storage, int64 offset, int64 size, ValueTree &tree) const;
+
+    // Returns a deep copy of the tree, in which the tracks stored in columns
+    // have their notes as the usual child nodes, and no longer reference the storage
+    static ValueTree expandNoteColumns(const ValueTree &tree);
+
+    // The packed notes of a single track, all values are in the same units
+    // as the corresponding note properties in the value tree, see Note::serialize
+    class NoteColumns final : public ReferenceCountedObject
+    {
+    public:
+
+        using Ptr = ReferenceCountedObjectPtr<NoteColumns>;
+
+        NoteColumns(Storage::Ptr storage,
+            const char *data, int numNotes, int idsSize) noexcept;
+        ~NoteColumns() override;
+
+        // Returns nullptr, if the track is not stored in columns
+        static NoteColumns *findIn(const ValueTree &track);
+
+        inline int getNumNotes() const noexcept { return this->numNotes; }
+
+        String getId(int index) const;
+        int getKey(int index) const noexcept;
+        int getTimestamp(int index) const noexcept;
+        int getLength(int index) const noexcept;
+        int getVolume(int index) const noexcept;
+        int getTuplet(int index) const noexcept;
+
+    private:
+
+        Storage::Ptr storage;
+
+        const int numNotes;
+        const int32 *timestamps;
+        const int32 *keys;
+        const int32 *lengths;
+        const int32 *volumes;
+        const uint32 *idOffsets;
+        const int8 *tuplets;
+        const char *ids;
+        const int idsSize;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteColumns)
+    };
+
+};
@@ -21,6 +21,131 @@
 #include "DocumentHelpers.h"
 #include "MainLayout.h"
 
+//===----------------------------------------------------------------------===//
+// BackgroundWriter
+//===----------------------------------------------------------------------===//
+
+// Holds at most one pending snapshot, so that the consecutive requests are coalesced,
+// and reports the results back to the document on the message thread
+class Document::BackgroundWriter final : public Thread, private AsyncUpdater
+{
+public:
+
+    explicit BackgroundWriter(Document &document) :
+        Thread("Document saver"),
+        document(document) {}
+
+    ~BackgroundWriter() override
+    {
+        this->cancelPendingWrite();
+        this->stopThread(DOCUMENT_BACKGROUND_SAVE_TIMEOUT_MS);
+        this->cancelPendingUpdate();
+    }
+
+    void write(const File &file, DocumentOwner::SnapshotWriter writer, int changesCount)
+    {
+        {
+            const ScopedLock sl(this->jobsLock);
+            this->pendingJob = { file, writer, changesCount, false };
+        }
+
+        if (!this->isThreadRunning())
+        {
+            this->startThread(3);
+        }
+
+        this->notify();
+    }
+
+    void cancelPendingWrite()
+    {
+        const ScopedLock sl(this->jobsLock);
+        this->pendingJob = {};
+    }
+
+    // Held while the snapshot is written, so that the synchronous saves
+    // don't overwrite the file at the same time, or get overwritten by older snapshots
+    const CriticalSection &getWriteLock() const noexcept
+    {
+        return this->writeLock;
+    }
+
+private:
+
+    struct Job final
+    {
+        File file;
+        DocumentOwner::SnapshotWriter writer;
+        int changesCount;
+        bool savedOk;
+    };
+
+    void run() override
+    {
+        while (!this->threadShouldExit())
+        {
+            Job job;
+
+            {
+                const ScopedLock sl(this->jobsLock);
+                job = this->pendingJob;
+                this->pendingJob = {};
+            }
+
+            if (job.writer != nullptr)
+            {
+                {
+                    const ScopedLock sl(this->writeLock);
+                    job.savedOk = job.writer(job.file);
+                }
+
+                // the writer is provided by the owner, and might capture something
+                // it's not safe to release here, so it's released on the message thread,
+                // see handleAsyncUpdate
+                {
+                    const ScopedLock sl(this->jobsLock);
+                    this->finishedJobs.add(job);
+                    job.writer = nullptr;
+                }
+
+                this->triggerAsyncUpdate();
+                continue;
+            }
+
+            this->wait(-1);
+        }
+    }
+
+    void handleAsyncUpdate() override
+    {
+        Array<Job> jobs;
+
+        {
+            const ScopedLock sl(this->jobsLock);
+            jobs.swapWith(this->finishedJobs);
+        }
+
+        for (const auto &job : jobs)
+        {
+            this->document.onBackgroundSaveDone(job.file, job.savedOk, job.changesCount);
+        }
+    }
+
+    Document &document;
+
+    CriticalSection jobsLock;
+    Job pendingJob;
+    Array<Job> finishedJobs;
+
+    CriticalSection writeLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BackgroundWriter)
+};
+
+//===----------------------------------------------------------------------===//
+// Document
+//===----------------------------------------------------------------------===//
+
 Document::Document(DocumentOwner &documentOwner,
     const String &defaultName,
     const String &defaultExtension) :
@@ -38,6 +163,7 @@ Document::Document(DocumentOwner &documentOwner,
         }
     }
 
+    this->backgroundWriter = MakeUnique<BackgroundWriter>(*this);
     this->owner.addChangeListener(this);
 }
 
@@ -46,17 +172,23 @@ Document::Document(DocumentOwner &documentOwner, const File &existingFile) :
     extension(existingFile.getFileExtension().replace(",", ""))
 {
     this->workingFile = existingFile;
+    this->backgroundWriter = MakeUnique<BackgroundWriter>(*this);
     this->owner.addChangeListener(this);
 }
 
 Document::~Document()
 {
     this->owner.removeChangeListener(this);
+    this->backgroundWriter = nullptr;
 }
 
 void Document::changeListenerCallback(ChangeBroadcaster *source)
 {
     this->hasChanges = true;
+    this->changesCount++;
+
+    // the snapshot is outdated, and the next autosave is coming anyway
+    this->cancelBackgroundSave();
 }
 
 File Document::getFile() const
@@ -76,6 +208,9 @@ void Document::renameFile(const String &newName)
         return;
     }
 
+    this->cancelBackgroundSave();
+    const ScopedLock sl(this->backgroundWriter->getWriteLock());
+
     const auto safeNewName = File::createLegalFileName(newName).trimCharactersAtEnd(".");
 
     File newFile(this->workingFile.getSiblingFile(safeNewName + "." + this->extension));
@@ -104,6 +239,47 @@ void Document::save()
     }
 }
 
+void Document::saveInBackground()
+{
+    if (!this->hasChanges || this->workingFile.getFullPathName().isEmpty())
+    {
+        return;
+    }
+
+    auto writer = this->owner.onDocumentSnapshot();
+    if (writer == nullptr)
+    {
+        this->internalSave(this->workingFile);
+        return;
+    }
+
+    this->backgroundWriter->write(this->workingFile, writer, this->changesCount);
+}
+
+void Document::cancelBackgroundSave()
+{
+    this->backgroundWriter->cancelPendingWrite();
+}
+
+void Document::onBackgroundSaveDone(const File &file, bool savedOk, int savedChangesCount)
+{
+    if (!savedOk)
+    {
+        DBG("Document save failed: " + file.getFullPathName());
+        return;
+    }
+
+    // the document might have been changed while saving
+    if (this->changesCount == savedChangesCount)
+    {
+        this->hasChanges = false;
+    }
+
+    auto savedFile = file;
+    this->owner.onDocumentDidSave(savedFile);
+    DBG("Document saved in background: " + file.getFullPathName());
+}
+
 void Document::saveAs()
 {
 #if HELIO_DESKTOP
@@ -257,6 +433,10 @@ bool Document::internalSave(File result)
         return false;
     }
 
+    // make sure no older snapshot is written after this save
+    this->cancelBackgroundSave();
+    const ScopedLock sl(this->backgroundWriter->getWriteLock());
+
     const bool savedOk = this->owner.onDocumentSave(result);
 
     if (savedOk)
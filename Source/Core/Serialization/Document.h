@@ -19,6 +19,9 @@
 
 #include "Common.h"
 
+// How long to wait for a background save to finish when the document is closed
+#define DOCUMENT_BACKGROUND_SAVE_TIMEOUT_MS 10000
+
 class DocumentOwner;
 
 class Document : public ChangeListener
@@ -46,6 +49,12 @@ public:
     //===------------------------------------------------------------------===//
 
     void save();
+
+    // Takes a snapshot of the owner's state on the message thread, and writes it
+    // on a background thread; a newer request replaces the one not yet started,
+    // and any change to the document cancels it, see Autosaver
+    void saveInBackground();
+
     void saveAs();
     void exportAs(const String &exportExtension,
         const String &defaultFilename = "");
@@ -83,5 +92,14 @@ protected:
 
 private:
 
+    class BackgroundWriter;
+    UniquePointer<BackgroundWriter> backgroundWriter;
+
+    // tells if the document has been changed while it was being saved in background
+    int changesCount = 0;
+
+    void cancelBackgroundSave();
+    void onBackgroundSaveDone(const File &file, bool savedOk, int savedChangesCount);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Document)
 };
@@ -21,7 +21,10 @@
 #include "JsonSerializer.h"
 #include "XmlSerializer.h"
 #include "BinarySerializer.h"
+#include "ColumnarSerializer.h"
+#include "ChunkedSerializer.h"
 #include "LegacySerializer.h"
+#include "SerializationKeys.h"
 
 String DocumentHelpers::getTemporaryFolder()
 {
@@ -153,6 +156,8 @@ static const OwnedArray<Serializer> &getSerializers()
         serializers.add(new XmlSerializer());
         serializers.add(new JsonSerializer());
         serializers.add(new BinarySerializer());
+        serializers.add(new ColumnarSerializer());
+        serializers.add(new ChunkedSerializer());
         serializers.add(new LegacySerializer());
     }
 
@@ -253,6 +258,75 @@ ValueTree DocumentHelpers::load(const String &string)
 
 }
 
+//===----------------------------------------------------------------------===//
+// Snapshots
+//===----------------------------------------------------------------------===//
+
+// snapshots are only taken on the message thread
+static int snapshotScopeDepth = 0;
+
+DocumentHelpers::SnapshotScope::SnapshotScope() noexcept
+{
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+    ++snapshotScopeDepth;
+}
+
+DocumentHelpers::SnapshotScope::~SnapshotScope() noexcept
+{
+    --snapshotScopeDepth;
+}
+
+bool DocumentHelpers::SnapshotScope::isActive() noexcept
+{
+    // other threads, e.g. the VCS sync threads, may serialize the same objects meanwhile
+    return snapshotScopeDepth > 0 && MessageManager::existsAndIsCurrentThread();
+}
+
+class ReferencedSnapshotTree final : public ReferenceCountedObject
+{
+public:
+
+    explicit ReferencedSnapshotTree(const ValueTree &tree) : tree(tree) {}
+
+    const ValueTree tree;
+
+};
+
+ValueTree DocumentHelpers::createSnapshotReference(const ValueTree &immutableTree)
+{
+    jassert(!immutableTree.getParent().isValid());
+    ValueTree reference(Serialization::Core::snapshotReference);
+    reference.setProperty(Serialization::Core::snapshotReferencedTree,
+        var(new ReferencedSnapshotTree(immutableTree)), nullptr);
+    return reference;
+}
+
+ValueTree DocumentHelpers::resolveSnapshotReferences(const ValueTree &snapshot)
+{
+    if (snapshot.hasType(Serialization::Core::snapshotReference))
+    {
+        const auto *referenced = dynamic_cast<ReferencedSnapshotTree *>(snapshot
+            .getProperty(Serialization::Core::snapshotReferencedTree).getObject());
+
+        jassert(referenced != nullptr);
+        return referenced != nullptr ? referenced->tree.createCopy() : ValueTree();
+    }
+
+    ValueTree result(snapshot.getType());
+    result.copyPropertiesFrom(snapshot, nullptr);
+
+    for (const auto &child : snapshot)
+    {
+        const auto resolvedChild = resolveSnapshotReferences(child);
+        if (resolvedChild.isValid())
+        {
+            result.appendChild(resolvedChild, nullptr);
+        }
+    }
+
+    return result;
+}
+
 static File createTempFileForSaving(const File &parentDirectory, String name, const String& suffix)
 {
     return parentDirectory.getNonexistentChildFile(name, suffix, false);
@@ -76,6 +76,38 @@ public:
         return false;
     }
 
+    // For the serializers which update the existing file in place, and keep it valid
+    // if the save is interrupted, so that it doesn't need to be rewritten, see ChunkedSerializer
+    template<typename T>
+    static bool saveIncrementally(const File &file, const ValueTree &tree)
+    {
+        T serializer;
+        return serializer.saveToFile(file, tree).wasOk();
+    }
+
+    // While a snapshot of the model is taken on the message thread, see
+    // DocumentOwner::onDocumentSnapshot, the objects which never change once created
+    // (e.g. the revision items) can serialize into the references to their cached trees,
+    // instead of building them again or copying them; the writer thread then
+    // resolves the references into the copies of those trees
+    class SnapshotScope final
+    {
+    public:
+
+        SnapshotScope() noexcept;
+        ~SnapshotScope() noexcept;
+
+        static bool isActive() noexcept;
+
+    private:
+
+        JUCE_DECLARE_NON_COPYABLE(SnapshotScope)
+    };
+
+    // The referenced tree should have no parent, and should never be modified
+    static ValueTree createSnapshotReference(const ValueTree &immutableTree);
+    static ValueTree resolveSnapshotReferences(const ValueTree &snapshot);
+
     class TempDocument final
     {
     public:
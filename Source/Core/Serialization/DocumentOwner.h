@@ -47,6 +47,12 @@ protected:
     virtual void onDocumentImport(File &file) = 0;
     virtual bool onDocumentExport(File &file) = 0;
 
+    // Owners that can be saved in background return a callback here, which captures
+    // a snapshot of their state, and writes it to the given file on a background thread,
+    // so it must not touch the owner itself; returns nullptr, if that's not supported
+    using SnapshotWriter = Function<bool(const File &file)>;
+    virtual SnapshotWriter onDocumentSnapshot() { return nullptr; }
+
     friend class Document;
 
 private:
@@ -0,0 +1,104 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "JsonParserBenchmark.h"
+#include "JsonSerializer.h"
+#include "SerializationKeys.h"
+
+// Each resource is parsed over and over with each parser,
+// at least this many times, and for at least this long
+#define JSON_PARSER_BENCHMARK_MIN_RUNS 10
+#define JSON_PARSER_BENCHMARK_MIN_TIME_MS 500
+
+const String JsonParserBenchmark::argument = "--json-parser-benchmark";
+
+var JsonParserBenchmark::run()
+{
+    namespace Keys = Serialization::Benchmarks;
+
+    JsonSerializer serializer;
+    JsonSerializer legacySerializer;
+    legacySerializer.setUsesLegacyParser(true);
+
+    // returns the mean time of one parse, in microseconds
+    const auto measure = [](const JsonSerializer &parser, const String &text) -> double
+    {
+        int numRuns = 0;
+        double elapsedMs = 0.0;
+        const auto startTime = Time::getHighResolutionTicks();
+
+        while (numRuns < JSON_PARSER_BENCHMARK_MIN_RUNS ||
+            elapsedMs < JSON_PARSER_BENCHMARK_MIN_TIME_MS)
+        {
+            ValueTree tree;
+            parser.loadFromString(text, tree);
+            numRuns++;
+
+            elapsedMs = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1000.0;
+        }
+
+        return elapsedMs * 1000.0 / numRuns;
+    };
+
+    Array<var> resources;
+    for (int i = 0; i < BinaryData::namedResourceListSize; ++i)
+    {
+        const String fileName(BinaryData::originalFilenames[i]);
+        if (!fileName.endsWithIgnoreCase(".json"))
+        {
+            continue;
+        }
+
+        int dataSize = 0;
+        const auto *data = BinaryData::getNamedResource(BinaryData::namedResourceList[i], dataSize);
+        const auto text = String::fromUTF8(data, dataSize);
+
+        ValueTree tree;
+        ValueTree legacyTree;
+        const auto result = serializer.loadFromString(text, tree);
+        const auto legacyResult = legacySerializer.loadFromString(text, legacyTree);
+        if (result.failed() || legacyResult.failed())
+        {
+            Logger::writeToLog("JSON parser benchmark: failed to parse " + fileName +
+                (result.failed() ? " with the current parser" : " with the legacy parser"));
+            continue;
+        }
+
+        const bool hasSameResult = tree.isEquivalentTo(legacyTree);
+        const double parseTimeUs = measure(serializer, text);
+        const double legacyParseTimeUs = measure(legacySerializer, text);
+
+        // bytes per microsecond is megabytes per second
+        Logger::writeToLog("JSON parser benchmark: " + fileName + ", " + String(dataSize) + " bytes, " +
+            String(parseTimeUs, 1) + " us (" + String(dataSize / parseTimeUs, 1) + " MB/s), legacy parser " +
+            String(legacyParseTimeUs, 1) + " us (" + String(dataSize / legacyParseTimeUs, 1) + " MB/s), " +
+            (hasSameResult ? "same trees" : "different trees"));
+
+        DynamicObject::Ptr resource(new DynamicObject());
+        resource->setProperty(Keys::resourceName, fileName);
+        resource->setProperty(Keys::numBytes, dataSize);
+        resource->setProperty(Keys::parseTimeUs, parseTimeUs);
+        resource->setProperty(Keys::legacyParseTimeUs, legacyParseTimeUs);
+        resource->setProperty(Keys::sameResult, hasSameResult);
+        resources.add(var(resource.get()));
+    }
+
+    DynamicObject::Ptr report(new DynamicObject());
+    report->setProperty(Keys::resources, resources);
+    return var(report.get());
+}
@@ -0,0 +1,35 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Measures how long it takes to parse each of the bundled JSON resources
+// with the current parser and with the legacy one, which reads the text
+// character by character, and checks that both parsers give the same trees.
+//
+// Runs from the command line, and writes the JSON report into the given file:
+//     Helio --json-parser-benchmark report.json
+
+class JsonParserBenchmark final
+{
+public:
+
+    static const String argument;
+
+    static var run();
+
+};
@@ -18,15 +18,721 @@
 #include "Common.h"
 #include "JsonSerializer.h"
 
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define JSON_SCANNER_USES_SSE2 1
+#elif defined (__ARM_NEON__) || defined (__ARM_NEON)
+#   include <arm_neon.h>
+#   define JSON_SCANNER_USES_NEON 1
+#endif
+
+#if JUCE_MSVC
+#   include <intrin.h>
+#endif
+
+#define JSON_SCANNER_BLOCK_SIZE 16
+
+//===----------------------------------------------------------------------===//
+// Json scanner
+//===----------------------------------------------------------------------===//
+
+// Finds the characters of interest 16 bytes at a time, with SSE2 or NEON when available,
+// returning a bit mask for each block: the structural characters, quotes, backslashes
+// and slashes for the parser, and the characters to be escaped for the formatter.
+
+struct JsonScanner final
+{
+    static inline bool isSpecialCharacter(const char c) noexcept
+    {
+        switch (c)
+        {
+        case '{': case '}': case '[': case ']': case ':': case ',':
+        case '"': case '\'': case '\\': case '/':
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static inline bool needsEscaping(const char c) noexcept
+    {
+        const auto b = static_cast<uint8>(c);
+        return b < 32 || b >= 127 || c == '"' || c == '\\';
+    }
+
+    static inline uint32 findSpecialCharacters(const char *p, size_t numBytes) noexcept
+    {
+        uint32 mask = 0;
+        for (size_t i = 0; i < numBytes; ++i)
+        {
+            mask |= isSpecialCharacter(p[i]) ? (1u << i) : 0u;
+        }
+
+        return mask;
+    }
+
+#if JSON_SCANNER_USES_SSE2
+
+    static inline uint32 findSpecialCharacters(const char *p) noexcept
+    {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // '[' and ']' differ from '{' and '}' only by 0x20
+        const auto brackets = _mm_or_si128(block, _mm_set1_epi8(0x20));
+
+        auto m = _mm_or_si128(_mm_cmpeq_epi8(brackets, _mm_set1_epi8('{')),
+            _mm_cmpeq_epi8(brackets, _mm_set1_epi8('}')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(':')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(',')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\'')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('/')));
+        return static_cast<uint32>(_mm_movemask_epi8(m));
+    }
+
+    static inline uint32 findCharactersToEscape(const char *p) noexcept
+    {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // the comparison is signed, so that all non-ASCII bytes are below 32 as well
+        auto m = _mm_cmplt_epi8(block, _mm_set1_epi8(32));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(127)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+        return static_cast<uint32>(_mm_movemask_epi8(m));
+    }
+
+#elif JSON_SCANNER_USES_NEON
+
+    static inline uint32 getMask(uint8x16_t m) noexcept
+    {
+        static const uint8 bitWeights[JSON_SCANNER_BLOCK_SIZE] =
+            { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+
+        const auto bits = vandq_u8(m, vld1q_u8(bitWeights));
+        auto sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        return vget_lane_u16(vreinterpret_u16_u8(sum), 0);
+    }
+
+    static inline uint32 findSpecialCharacters(const char *p) noexcept
+    {
+        const auto block = vld1q_u8(reinterpret_cast<const uint8 *>(p));
+        // '[' and ']' differ from '{' and '}' only by 0x20
+        const auto brackets = vorrq_u8(block, vdupq_n_u8(0x20));
+
+        auto m = vorrq_u8(vceqq_u8(brackets, vdupq_n_u8('{')),
+            vceqq_u8(brackets, vdupq_n_u8('}')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8(':')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8(',')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('"')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('\'')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('\\')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('/')));
+        return getMask(m);
+    }
+
+    static inline uint32 findCharactersToEscape(const char *p) noexcept
+    {
+        const auto block = vld1q_u8(reinterpret_cast<const uint8 *>(p));
+        auto m = vorrq_u8(vcltq_u8(block, vdupq_n_u8(32)),
+            vcgeq_u8(block, vdupq_n_u8(127)));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('"')));
+        m = vorrq_u8(m, vceqq_u8(block, vdupq_n_u8('\\')));
+        return getMask(m);
+    }
+
+#else
+
+    static inline uint32 findSpecialCharacters(const char *p) noexcept
+    {
+        return findSpecialCharacters(p, JSON_SCANNER_BLOCK_SIZE);
+    }
+
+    static inline uint32 findCharactersToEscape(const char *p) noexcept
+    {
+        uint32 mask = 0;
+        for (int i = 0; i < JSON_SCANNER_BLOCK_SIZE; ++i)
+        {
+            mask |= needsEscaping(p[i]) ? (1u << i) : 0u;
+        }
+
+        return mask;
+    }
+
+#endif
+
+    static inline int countTrailingZeros(uint32 mask) noexcept
+    {
+        jassert(mask != 0);
+#if JUCE_MSVC
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Returns the number of bytes to be written as is, before the next character to escape
+    static size_t findCharacterToEscape(const char *p, size_t numBytes) noexcept
+    {
+        size_t i = 0;
+
+        for (; i + JSON_SCANNER_BLOCK_SIZE <= numBytes; i += JSON_SCANNER_BLOCK_SIZE)
+        {
+            const auto mask = findCharactersToEscape(p + i);
+            if (mask != 0)
+            {
+                return i + countTrailingZeros(mask);
+            }
+        }
+
+        for (; i < numBytes; ++i)
+        {
+            if (needsEscaping(p[i]))
+            {
+                return i;
+            }
+        }
+
+        return numBytes;
+    }
+
+    // Both expect the pointer after the comment opening, and return the pointer after the comment
+    static const char *skipLineComment(const char *p) noexcept
+    {
+        while (*p != 0 && *p != '\n' && *p != '\r') { ++p; }
+        return p;
+    }
+
+    static const char *skipMultilineComment(const char *p) noexcept
+    {
+        for (; *p != 0; ++p)
+        {
+            if (p[0] == '*' && p[1] == '/')
+            {
+                return p + 2;
+            }
+        }
+
+        return p;
+    }
+
+    // The first stage of parsing: writes the positions of all structural characters
+    // and of the opening and closing quotes of all strings, skipping the escaped quotes
+    // and the comments; the tokens buffer is expected to have room for numBytes entries;
+    // returns false if the input ends within a string
+    static bool findStructuralCharacters(const char *json, size_t numBytes,
+        uint32 *tokens, int &numTokens) noexcept
+    {
+        numTokens = 0;
+
+        char quote = 0;
+        size_t escapedUntil = 0;
+        size_t position = 0;
+
+        while (position < numBytes)
+        {
+            const auto blockSize = jmin(numBytes - position, size_t(JSON_SCANNER_BLOCK_SIZE));
+            auto mask = (blockSize == JSON_SCANNER_BLOCK_SIZE) ?
+                findSpecialCharacters(json + position) :
+                findSpecialCharacters(json + position, blockSize);
+
+            auto nextPosition = position + blockSize;
+
+            while (mask != 0)
+            {
+                const auto i = position + countTrailingZeros(mask);
+                mask &= mask - 1;
+
+                if (i < escapedUntil)
+                {
+                    continue;
+                }
+
+                const auto c = json[i];
+
+                if (quote != 0)
+                {
+                    if (c == '\\')
+                    {
+                        escapedUntil = i + 2;
+                    }
+                    else if (c == quote)
+                    {
+                        tokens[numTokens++] = static_cast<uint32>(i);
+                        quote = 0;
+                    }
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    tokens[numTokens++] = static_cast<uint32>(i);
+                    quote = c;
+                }
+                else if (c == '/')
+                {
+                    const char *commentEnd = nullptr;
+                    if (json[i + 1] == '/')
+                    {
+                        commentEnd = skipLineComment(json + i + 2);
+                    }
+                    else if (json[i + 1] == '*')
+                    {
+                        commentEnd = skipMultilineComment(json + i + 2);
+                    }
+
+                    if (commentEnd != nullptr)
+                    {
+                        // continue scanning from the end of the comment
+                        nextPosition = size_t(commentEnd - json);
+                        break;
+                    }
+                }
+                else if (c != '\\')
+                {
+                    tokens[numTokens++] = static_cast<uint32>(i);
+                }
+            }
+
+            position = nextPosition;
+        }
+
+        return quote == 0;
+    }
+};
+
 //===----------------------------------------------------------------------===//
 // Json parser
 //===----------------------------------------------------------------------===//
 
-// Slightly modified JSONParser from JUCE classes,
-// but returns ValueTree instead of var, and supports comments like `//` and `/* */`.
+// Returns ValueTree instead of var, and supports comments like `//` and `/* */`,
+// like the JSONParser from JUCE classes it used to be a modified version of.
 // Parses arrays and objects as nodes/children, and all others as properties.
+//
+// Parsing is done in two stages: JsonScanner first finds all structural characters
+// and string boundaries, so that strings are never scanned character by character,
+// and then the parser walks through those positions, building the tree as it goes;
+// strings without escape sequences are copied into properties as they are.
 
-struct JsonParser final
+class JsonParser final
+{
+public:
+
+    static Result parseObjectOrArray(const String &text, ValueTree &result)
+    {
+        static_assert(sizeof(String::CharPointerType::CharType) == 1,
+            "The parser expects UTF-8 strings");
+
+        const auto *json = text.toRawUTF8();
+        const auto numBytes = text.getNumBytesAsUTF8();
+
+        HeapBlock<uint32> tokens(numBytes + 1);
+        int numTokens = 0;
+
+        if (!JsonScanner::findStructuralCharacters(json, numBytes, tokens.get(), numTokens))
+        {
+            return createFail("Unexpected end-of-input in string constant");
+        }
+
+        JsonParser parser(json, tokens.get());
+        return parser.parseRoot(result);
+    }
+
+private:
+
+    JsonParser(const char *json, const uint32 *tokens) noexcept :
+        json(json), tokens(tokens), cursor(json) {}
+
+    const char *const json;
+    const uint32 *const tokens;
+
+    // the next token to be consumed, and the position after the last parsed one
+    int token = 0;
+    const char *cursor;
+
+    inline void consumeToken(const char *p) noexcept
+    {
+        jassert(this->json + this->tokens[this->token] == p);
+        this->token++;
+        this->cursor = p + 1;
+    }
+
+    static inline bool isWhitespace(const char c) noexcept
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    static const char *skipCommentsAndWhitespaces(const char *p) noexcept
+    {
+        for (;;)
+        {
+            while (isWhitespace(*p)) { ++p; }
+
+            if (p[0] == '/' && p[1] == '/')
+            {
+                p = JsonScanner::skipLineComment(p + 2);
+            }
+            else if (p[0] == '/' && p[1] == '*')
+            {
+                p = JsonScanner::skipMultilineComment(p + 2);
+            }
+            else
+            {
+                return p;
+            }
+        }
+    }
+
+    static Result createFail(const char *const message, const char *location = nullptr)
+    {
+        String m(message);
+        if (location != nullptr)
+            m << ": \"" << String(String::CharPointerType(location), 20) << '"';
+
+        return Result::fail(m);
+    }
+
+    Result parseRoot(ValueTree &result)
+    {
+        const auto *p = skipCommentsAndWhitespaces(this->cursor);
+
+        switch (*p)
+        {
+        case 0:      result = ValueTree(); return Result::ok();
+        case '{':    this->consumeToken(p); return this->parseObject(result);
+        case '[':    this->consumeToken(p); return this->parseArray(result, result.getType());
+        }
+
+        return createFail("Expected '{' or '['", p);
+    }
+
+    // Expects the pointer to the opening quote
+    Result parseString(const char *p, String &result)
+    {
+        this->consumeToken(p);
+        const auto *start = p + 1;
+        const auto *end = this->json + this->tokens[this->token];
+        this->consumeToken(end);
+
+        if (memchr(start, '\\', size_t(end - start)) != nullptr)
+        {
+            return decodeEscapedString(start, end, result);
+        }
+
+        result = String(String::CharPointerType(start), String::CharPointerType(end));
+        return Result::ok();
+    }
+
+    static Result decodeEscapedString(const char *p, const char *end, String &result)
+    {
+        MemoryOutputStream buffer(size_t(end - p));
+
+        while (p < end)
+        {
+            const auto *escape = static_cast<const char *>(memchr(p, '\\', size_t(end - p)));
+            if (escape == nullptr)
+            {
+                buffer.write(p, size_t(end - p));
+                break;
+            }
+
+            buffer.write(p, size_t(escape - p));
+
+            // the scanner never lets a backslash escape the closing quote
+            p = escape + 1;
+            jassert(p < end);
+
+            auto c = static_cast<juce_wchar>(static_cast<uint8>(*p++));
+
+            switch (c)
+            {
+            case 'a':  c = '\a'; break;
+            case 'b':  c = '\b'; break;
+            case 'f':  c = '\f'; break;
+            case 'n':  c = '\n'; break;
+            case 'r':  c = '\r'; break;
+            case 't':  c = '\t'; break;
+
+            case 'u':
+            {
+                if (!readUnicodeEscape(p, end, c))
+                {
+                    return createFail("Syntax error in Unicode escape sequence");
+                }
+
+                // the formatter writes the characters outside of the BMP as surrogate pairs
+                if (c >= 0xd800 && c <= 0xdbff &&
+                    end - p > 1 && p[0] == '\\' && p[1] == 'u')
+                {
+                    juce_wchar lowSurrogate = 0;
+                    auto next = p + 2;
+                    if (readUnicodeEscape(next, end, lowSurrogate) &&
+                        lowSurrogate >= 0xdc00 && lowSurrogate <= 0xdfff)
+                    {
+                        c = 0x10000 + ((c - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+                        p = next;
+                    }
+                }
+
+                break;
+            }
+
+            default:
+                if (c >= 0x80)
+                {
+                    // a multi-byte character, copied as is
+                    p = escape + 1;
+                    continue;
+                }
+
+                break;
+            }
+
+            if (c == 0) { return createFail("Unexpected end-of-input in string constant"); }
+            buffer.appendUTF8Char(c);
+        }
+
+        result = buffer.toUTF8();
+        return Result::ok();
+    }
+
+    static bool readUnicodeEscape(const char *&p, const char *end, juce_wchar &result) noexcept
+    {
+        if (end - p < 4)
+        {
+            return false;
+        }
+
+        result = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            const auto digitValue = CharacterFunctions::getHexDigitValue(static_cast<juce_wchar>(*p++));
+            if (digitValue < 0) { return false; }
+            result = (juce_wchar)((result << 4) + static_cast<juce_wchar>(digitValue));
+        }
+
+        return true;
+    }
+
+    Result parseAny(ValueTree &result, const Identifier &nodeOrProperty)
+    {
+        const auto *p = skipCommentsAndWhitespaces(this->cursor);
+
+        switch (*p)
+        {
+        case '{':
+            {
+                this->consumeToken(p);
+                ValueTree child(nodeOrProperty);
+                result.appendChild(child, nullptr);
+                return this->parseObject(child);
+            }
+
+        case '[':
+            this->consumeToken(p);
+            return this->parseArray(result, nodeOrProperty);
+
+        case '"':
+        case '\'':
+            {
+                String property;
+                const auto r = this->parseString(p, property);
+                if (r.wasOk())
+                {
+                    result.setProperty(nodeOrProperty, property, nullptr);
+                }
+
+                return r;
+            }
+
+        case '-':
+            {
+                const auto *digits = skipCommentsAndWhitespaces(p + 1);
+                if (!CharacterFunctions::isDigit(*digits))
+                    break;
+
+                return this->parseNumberProperty(digits, nodeOrProperty, result, true);
+            }
+
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return this->parseNumberProperty(p, nodeOrProperty, result, false);
+
+        case 't':
+            if (strncmp(p, "true", 4) == 0)
+            {
+                this->cursor = p + 4;
+                result.setProperty(nodeOrProperty, true, nullptr);
+                return Result::ok();
+            }
+            break;
+
+        case 'f':
+            if (strncmp(p, "false", 5) == 0)
+            {
+                this->cursor = p + 5;
+                result.setProperty(nodeOrProperty, false, nullptr);
+                return Result::ok();
+            }
+            break;
+
+        case 'n':
+            if (strncmp(p, "null", 4) == 0)
+            {
+                this->cursor = p + 4;
+                // no need to set any property in this case?
+                return Result::ok();
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        return createFail("Syntax error", p);
+    }
+
+    Result parseNumberProperty(const char *p, const Identifier &propertyName, ValueTree &result, const bool isNegative)
+    {
+        const auto *start = p;
+
+        int64 intValue = *p++ - '0';
+        jassert(intValue >= 0 && intValue < 10);
+
+        for (;;)
+        {
+            const auto c = *p;
+            const auto digit = ((int)c) - '0';
+
+            if (isPositiveAndBelow(digit, 10))
+            {
+                intValue = intValue * 10 + digit;
+                ++p;
+                continue;
+            }
+
+            if (c == 'e' || c == 'E' || c == '.')
+            {
+                String::CharPointerType t(start);
+                const auto asDouble = CharacterFunctions::readDoubleValue(t);
+                result.setProperty(propertyName, isNegative ? -asDouble : asDouble, nullptr);
+                this->cursor = t.getAddress();
+                return Result::ok();
+            }
+
+            if (isWhitespace(c) || c == ',' || c == '}' || c == ']' || c == 0)
+            {
+                break;
+            }
+
+            return createFail("Syntax error in number", start);
+        }
+
+        this->cursor = p;
+        const auto correctedValue = isNegative ? -intValue : intValue;
+
+        if ((intValue >> 31) != 0)
+            result.setProperty(propertyName, correctedValue, nullptr);
+        else
+            result.setProperty(propertyName, (int)correctedValue, nullptr);
+
+        return Result::ok();
+    }
+
+    // Expects the pointer to the opening quote
+    Result parseKey(const char *p, Identifier &result)
+    {
+        const auto *start = p + 1;
+        const auto *end = this->json + this->tokens[this->token + 1];
+
+        if (start != end && memchr(start, '\\', size_t(end - start)) == nullptr)
+        {
+            // looks up the pooled identifier without making a string
+            this->consumeToken(p);
+            this->consumeToken(end);
+            result = Identifier(String::CharPointerType(start), String::CharPointerType(end));
+            return Result::ok();
+        }
+
+        String name;
+        const auto r = this->parseString(p, name);
+        if (r.wasOk() && name.isNotEmpty())
+        {
+            result = Identifier(name);
+        }
+
+        return r;
+    }
+
+    Result parseObject(ValueTree &result)
+    {
+        for (;;)
+        {
+            const auto *p = skipCommentsAndWhitespaces(this->cursor);
+
+            if (*p == '}') { this->consumeToken(p); break; }
+            if (*p == 0) { return createFail("Unexpected end-of-input in object declaration"); }
+            if (*p == '"')
+            {
+                Identifier nodeName;
+                const auto r = this->parseKey(p, nodeName);
+                if (r.failed()) { return r; }
+
+                if (nodeName.isValid())
+                {
+                    p = skipCommentsAndWhitespaces(this->cursor);
+                    if (*p != ':') { return createFail("Expected ':', but found", p); }
+                    this->consumeToken(p);
+
+                    const auto r2 = this->parseAny(result, nodeName);
+                    if (r2.failed()) { return r2; }
+
+                    p = skipCommentsAndWhitespaces(this->cursor);
+                    if (*p == ',') { this->consumeToken(p); continue; }
+                    if (*p == '}') { this->consumeToken(p); break; }
+                }
+            }
+
+            return createFail("Expected object member declaration, but found", p);
+        }
+
+        return Result::ok();
+    }
+
+    Result parseArray(ValueTree &result, const Identifier &nodeName)
+    {
+        for (;;)
+        {
+            const auto *p = skipCommentsAndWhitespaces(this->cursor);
+
+            if (*p == ']') { this->consumeToken(p); break; }
+            if (*p == 0) { return createFail("Unexpected end-of-input in array declaration"); }
+
+            const auto r = this->parseAny(result, nodeName);
+            if (r.failed()) { return r; }
+
+            p = skipCommentsAndWhitespaces(this->cursor);
+            if (*p == ',') { this->consumeToken(p); continue; }
+            if (*p == ']') { this->consumeToken(p); break; }
+            return createFail("Expected object array item, but found", p);
+        }
+
+        return Result::ok();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(JsonParser)
+};
+
+//===----------------------------------------------------------------------===//
+// Legacy json parser
+//===----------------------------------------------------------------------===//
+
+// The parser used before the structural index: a slightly modified JSONParser
+// from JUCE classes, which reads the text character by character; only kept
+// to compare the results and the performance, see JsonSerializer::setUsesLegacyParser
+
+struct JsonLegacyParser final
 {
     static Result parseObjectOrArray(String::CharPointerType t, ValueTree &result)
     {
@@ -358,6 +1064,10 @@ private:
 // Json formatter
 //===----------------------------------------------------------------------===//
 
+// Writes everything straight into the stream: the runs of characters which need
+// no escaping are found by JsonScanner and written at once, and the integers
+// are formatted on the stack, so that no temporary strings are made.
+
 struct JsonFormatter final
 {
     static void write(OutputStream &out, const ValueTree &tree, const StringArray &headerComments,
@@ -391,7 +1101,7 @@ struct JsonFormatter final
 
         if (!oneLine) { writeSpaces(out, indentLevel + indentSize); }
         out << '"';
-        writeString(out, tree.getType());
+        writeString(out, tree.getType().toString());
         out << "\": ";
         writeObject(out, tree, indentLevel + indentSize, oneLine, maximumDecimalPlaces);
 
@@ -413,7 +1123,7 @@ struct JsonFormatter final
 
             if (!allOnOneLine) { writeSpaces(out, indentLevel + indentSize); }
             out << '"';
-            writeString(out, propertyName);
+            writeString(out, propertyName.toString());
             out << "\": ";
             writeProperty(out, tree.getProperty(propertyName), maximumDecimalPlaces);
 
@@ -452,7 +1162,7 @@ struct JsonFormatter final
             }
 
             out << '"';
-            writeString(out, childrenType);
+            writeString(out, childrenType.toString());
             out << "\": ";
 
             if (childGroupOfSameType.size() == 1)
@@ -489,7 +1199,7 @@ struct JsonFormatter final
         if (v.isString())
         {
             out << '"';
-            writeString(out, v.toString().getCharPointer());
+            writeString(out, v.toString());
             out << '"';
         }
         else if (v.isVoid())
@@ -506,7 +1216,7 @@ struct JsonFormatter final
         }
         else if (v.isInt() || v.isInt64())
         {
-            out << v.toString();
+            writeInteger(out, static_cast<int64>(v));
         }
         else if (v.isDouble())
         {
@@ -520,56 +1230,84 @@ struct JsonFormatter final
         }
     }
 
+    static void writeInteger(OutputStream &out, int64 value)
+    {
+        char buffer[24];
+        auto *const end = buffer + numElementsInArray(buffer);
+        auto *p = end;
+
+        auto n = value < 0 ? uint64(-(value + 1)) + 1 : uint64(value);
+        do
+        {
+            *--p = char('0' + n % 10);
+            n /= 10;
+        } while (n != 0);
+
+        if (value < 0) { *--p = '-'; }
+        out.write(p, size_t(end - p));
+    }
+
     static void writeEscapedChar(OutputStream &out, const unsigned short value)
     {
-        out << "\\u" << String::toHexString((int)value).paddedLeft('0', 4);
+        static const char hexDigits[] = "0123456789abcdef";
+        const char escaped[] = { '\\', 'u',
+            hexDigits[(value >> 12) & 15], hexDigits[(value >> 8) & 15],
+            hexDigits[(value >> 4) & 15], hexDigits[value & 15] };
+
+        out.write(escaped, sizeof(escaped));
     }
 
-    static void writeString(OutputStream &out, String::CharPointerType t)
+    static void writeString(OutputStream &out, const String &string)
     {
-        for (;;)
-        {
-            auto c = t.getAndAdvance();
+        const auto *p = string.toRawUTF8();
+        const auto *end = p + string.getNumBytesAsUTF8();
 
-            switch (c)
+        while (p < end)
+        {
+            const auto numPlainBytes = JsonScanner::findCharacterToEscape(p, size_t(end - p));
+            if (numPlainBytes > 0)
             {
-            case 0:  return;
+                out.write(p, numPlainBytes);
+                p += numPlainBytes;
+                if (p == end) { return; }
+            }
 
-            case '\"':  out << "\\\""; break;
-            case '\\':  out << "\\\\"; break;
-            case '\a':  out << "\\a";  break;
-            case '\b':  out << "\\b";  break;
-            case '\f':  out << "\\f";  break;
-            case '\t':  out << "\\t";  break;
-            case '\r':  out << "\\r";  break;
-            case '\n':  out << "\\n";  break;
+            switch (*p)
+            {
+            case '\"':  out.write("\\\"", 2); ++p; break;
+            case '\\':  out.write("\\\\", 2); ++p; break;
+            case '\a':  out.write("\\a", 2);  ++p; break;
+            case '\b':  out.write("\\b", 2);  ++p; break;
+            case '\f':  out.write("\\f", 2);  ++p; break;
+            case '\t':  out.write("\\t", 2);  ++p; break;
+            case '\r':  out.write("\\r", 2);  ++p; break;
+            case '\n':  out.write("\\n", 2);  ++p; break;
 
             default:
-                if (c >= 32 && c < 127)
+            {
+                String::CharPointerType t(p);
+                const auto c = t.getAndAdvance();
+                p = t.getAddress();
+
+                if (CharPointer_UTF16::getBytesRequiredFor(c) > 2)
                 {
-                    out << (char)c;
+                    CharPointer_UTF16::CharType chars[2];
+                    CharPointer_UTF16 utf16(chars);
+                    utf16.write(c);
+
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        writeEscapedChar(out, (unsigned short)chars[i]);
+                    }
                 }
                 else
                 {
-                    if (CharPointer_UTF16::getBytesRequiredFor(c) > 2)
-                    {
-                        CharPointer_UTF16::CharType chars[2];
-                        CharPointer_UTF16 utf16(chars);
-                        utf16.write(c);
-
-                        for (int i = 0; i < 2; ++i)
-                        {
-                            writeEscapedChar(out, (unsigned short)chars[i]);
-                        }
-                    }
-                    else
-                    {
-                        writeEscapedChar(out, (unsigned short)c);
-                    }
+                    writeEscapedChar(out, (unsigned short)c);
                 }
 
                 break;
             }
+            }
         }
     }
 
@@ -627,6 +1365,21 @@ void JsonSerializer::setHeaderComments(StringArray comments) noexcept
     this->headerComments = comments;
 }
 
+void JsonSerializer::setUsesLegacyParser(bool shouldUseLegacyParser) noexcept
+{
+    this->usesLegacyParser = shouldUseLegacyParser;
+}
+
+Result JsonSerializer::parse(const String &text, ValueTree &root) const
+{
+    if (this->usesLegacyParser)
+    {
+        return JsonLegacyParser::parseObjectOrArray(text.getCharPointer(), root);
+    }
+
+    return JsonParser::parseObjectOrArray(text, root);
+}
+
 Result JsonSerializer::saveToFile(File file, const ValueTree &tree) const
 {
     FileOutputStream fileStream(file);
@@ -646,7 +1399,7 @@ Result JsonSerializer::loadFromFile(const File &file, ValueTree &tree) const
 {
     const String text(file.loadFileAsString());
     ValueTree root(fakeRoot);
-    const auto result = JsonParser::parseObjectOrArray(text.getCharPointer(), root);
+    const auto result = this->parse(text, root);
     if (result.wasOk())
     {
         tree = root.getChild(0);
@@ -667,7 +1420,7 @@ Result JsonSerializer::saveToString(String &string, const ValueTree &tree) const
 Result JsonSerializer::loadFromString(const String &string, ValueTree &tree) const
 {
     ValueTree root(fakeRoot);
-    const auto result = JsonParser::parseObjectOrArray(string.getCharPointer(), root);
+    const auto result = this->parse(string, root);
     if (result.wasOk())
     {
         if (root.getNumChildren() == 1 && root.getNumProperties() == 0)
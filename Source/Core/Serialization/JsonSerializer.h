@@ -27,6 +27,10 @@ public:
 
     void setHeaderComments(StringArray comments) noexcept;
 
+    // Switches loading to the previous parser, which reads the text character
+    // by character, only to compare the two, see JsonParserBenchmark
+    void setUsesLegacyParser(bool shouldUseLegacyParser) noexcept;
+
     Result saveToFile(File file, const ValueTree &tree) const override;
     Result loadFromFile(const File &file, ValueTree &tree) const override;
 
@@ -39,6 +43,9 @@ public:
 private:
 
     bool allOnOneLine;
+    bool usesLegacyParser = false;
     StringArray headerComments;
 
+    Result parse(const String &text, ValueTree &root) const;
+
 };
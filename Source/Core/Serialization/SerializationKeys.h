@@ -48,6 +48,14 @@ namespace Serialization
         static const Identifier projectTimeline = "projectTimeline";
         static const Identifier filePath = "filePath";
 
+        // Chunked project files, see ChunkedSerializer
+        static const Identifier chunk = "chunk";
+        static const Identifier chunkHash = "hash";
+
+        // Snapshots for the background saving, see DocumentHelpers::SnapshotScope
+        static const Identifier snapshotReference = "snapshotReference";
+        static const Identifier snapshotReferencedTree = "tree";
+
         // Properties
         static const Identifier trackId = "trackId";
         static const Identifier trackColour = "colour";
@@ -106,6 +114,9 @@ namespace Serialization
         static const Identifier volume = "vol";
         static const Identifier tuplet = "div";
 
+        // the index of a track's packed note columns, see ColumnarSerializer
+        static const Identifier columns = "columns";
+
         static const Identifier mute = "mute";
         static const Identifier solo = "solo";
 
@@ -124,6 +135,7 @@ namespace Serialization
         static const Identifier instrument = "instrument";
         static const Identifier instrumentId = "id";
         static const Identifier instrumentName = "name";
+        static const Identifier instrumentCanSleep = "canSleep";
 
         static const Identifier node = "node";
         static const Identifier nodeId = "id";
@@ -159,6 +171,10 @@ namespace Serialization
         static const Identifier defaultMidiOutput = "defaultMidiOutput";
 
         static const Identifier pluginsList = "plugins";
+        static const Identifier pluginsScanCache = "scanCache";
+        static const Identifier scannedFile = "scannedFile";
+        static const Identifier scannedFilePath = "path";
+        static const Identifier scannedFileSize = "size";
         static const Identifier audioCore = "audioCore";
         static const Identifier orchestra = "orchestra";
 
@@ -170,8 +186,53 @@ namespace Serialization
         static const Identifier audioDeviceBufferSize = "bufferSize";
         static const Identifier audioDeviceInputChannels = "inputChannels";
         static const Identifier audioDeviceOutputChannels = "outputChannels";
+
+        static const Identifier loadReport = "loadReport";
+        static const Identifier loadDevice = "device";
+        static const Identifier loadDeviceXRuns = "xRuns";
+        static const Identifier loadDeviceCpuUsage = "cpuUsage";
+        static const Identifier loadBlockDurationMs = "blockDurationMs";
+        static const Identifier loadMixer = "mixer";
+        static const Identifier loadMonitor = "monitor";
+        static const Identifier loadInstruments = "instruments";
+        static const Identifier loadNumBlocks = "numBlocks";
+        static const Identifier loadNumOverruns = "numOverruns";
+        static const Identifier loadMean = "meanLoad";
+        static const Identifier loadMedian = "medianLoad";
+        static const Identifier load95thPercentile = "load95";
+        static const Identifier load99thPercentile = "load99";
+        static const Identifier loadMax = "maxLoad";
+        static const Identifier loadMeanMidiQueueDepth = "meanMidiQueueDepth";
+        static const Identifier loadMaxMidiQueueDepth = "maxMidiQueueDepth";
+        static const Identifier loadHistogram = "histogram";
     } // namespace Audio
 
+    namespace Benchmarks
+    {
+        static const Identifier scenarios = "scenarios";
+        static const Identifier stepMs = "stepMs";
+        static const Identifier numLoadThreads = "loadThreads";
+        static const Identifier timelineDispatcher = "timelineDispatcher";
+        static const Identifier threadPlayer = "threadPlayer";
+        static const Identifier numOnsets = "numOnsets";
+        static const Identifier intervalErrorSdMs = "intervalErrorSdMs";
+        static const Identifier intervalErrorMaxMs = "intervalErrorMaxMs";
+        static const Identifier onsetErrorMaxMs = "onsetErrorMaxMs";
+        static const Identifier driftMs = "driftMs";
+        static const Identifier numNotes = "numNotes";
+        static const Identifier numTracks = "numTracks";
+        static const Identifier loadRecacheMs = "loadRecacheMs";
+        static const Identifier editRecacheMs = "editRecacheMs";
+        static const Identifier editFullRecacheMs = "editFullRecacheMs";
+        static const Identifier timelineMs = "timelineMs";
+        static const Identifier resources = "resources";
+        static const Identifier resourceName = "resource";
+        static const Identifier numBytes = "bytes";
+        static const Identifier parseTimeUs = "parseTimeUs";
+        static const Identifier legacyParseTimeUs = "legacyParseTimeUs";
+        static const Identifier sameResult = "sameResult";
+    } // namespace Benchmarks
+
     namespace Config
     {
         static const Identifier activeWorkspace = "activeWorkspace";
@@ -184,6 +245,11 @@ namespace Serialization
         static const Identifier lastUpdatesInfo = "lastUpdatesInfo";
         static const Identifier lastUsedFont = "lastUsedFont";
 
+        static const Identifier renderBlockSize = "renderBlockSize";
+        static const Identifier renderBitDepth = "renderBitDepth";
+        static const Identifier renderDoublePrecision = "renderDoublePrecision";
+        static const Identifier renderBenchmark = "renderBenchmark";
+
         static const Identifier nativeTitleBar = "nativeTitleBar";
         static const Identifier openGLState = "openGL";
         static const Identifier enabledState = "enabled";
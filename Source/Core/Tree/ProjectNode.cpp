@@ -33,7 +33,7 @@
 #include "Document.h"
 #include "DocumentHelpers.h"
 #include "XmlSerializer.h"
-#include "BinarySerializer.h"
+#include "ChunkedSerializer.h"
 
 #include "AudioCore.h"
 #include "PlayerThread.h"
@@ -91,7 +91,8 @@ void ProjectNode::initialize()
 
     auto &orchestra = App::Workspace().getAudioCore();
     auto &audioCoreSleepTimer = App::Workspace().getAudioCore(); // yup, the same
-    this->transport = MakeUnique<Transport>(orchestra, audioCoreSleepTimer);
+    auto &timelineDispatcher = App::Workspace().getAudioCore().getTimelineDispatcher();
+    this->transport = MakeUnique<Transport>(orchestra, audioCoreSleepTimer, timelineDispatcher);
     this->addListener(this->transport.get());
 
     this->metadata = MakeUnique<ProjectMetadata>(*this);
@@ -801,7 +802,29 @@ bool ProjectNode::onDocumentSave(File &file)
 #if DEBUG
     DocumentHelpers::save<XmlSerializer>(file.withFileExtension("xml"), projectNode);
 #endif
-    return DocumentHelpers::save<BinarySerializer>(file, projectNode);
+    return DocumentHelpers::saveIncrementally<ChunkedSerializer>(file, projectNode);
+}
+
+// Only the mutable parts of the project are serialized here, on the message thread;
+// the revision items and the unchanged undo transactions are just referenced
+// (see DocumentHelpers::SnapshotScope), and the writer thread copies them into the tree
+DocumentOwner::SnapshotWriter ProjectNode::onDocumentSnapshot()
+{
+    ValueTree snapshot;
+
+    {
+        const DocumentHelpers::SnapshotScope scope;
+        snapshot = this->save();
+    }
+
+    return [snapshot](const File &file)
+    {
+        const auto projectNode(DocumentHelpers::resolveSnapshotReferences(snapshot));
+#if DEBUG
+        DocumentHelpers::save<XmlSerializer>(file.withFileExtension("xml"), projectNode);
+#endif
+        return DocumentHelpers::saveIncrementally<ChunkedSerializer>(file, projectNode);
+    };
 }
 
 void ProjectNode::onDocumentImport(File &file)
@@ -178,6 +178,7 @@ protected:
     bool onDocumentLoad(File &file) override;
     void onDocumentDidLoad(File &file) override;
     bool onDocumentSave(File &file) override;
+    SnapshotWriter onDocumentSnapshot() override;
     void onDocumentImport(File &file) override;
     bool onDocumentExport(File &file) override;
 
@@ -19,6 +19,7 @@
 #include "PianoTrackActions.h"
 #include "MidiTrackSource.h"
 #include "PianoTrackNode.h"
+#include "ColumnarSerializer.h"
 #include "SerializationKeys.h"
 
 //===----------------------------------------------------------------------===//
@@ -83,7 +84,8 @@ void PianoTrackInsertAction::deserialize(const ValueTree &tree)
 {
     this->trackName = tree.getProperty(Serialization::Undo::xPath);
     this->trackId = tree.getProperty(Serialization::Undo::trackId);
-    this->trackState = tree.getChild(0).createCopy();
+    // the loaded track may reference the notes in the loaded file
+    this->trackState = ColumnarSerializer::expandNoteColumns(tree.getChild(0));
 }
 
 void PianoTrackInsertAction::reset()
@@ -162,7 +164,7 @@ void PianoTrackRemoveAction::deserialize(const ValueTree &tree)
 {
     this->trackName = tree.getProperty(Serialization::Undo::xPath);
     this->trackId = tree.getProperty(Serialization::Undo::trackId);
-    this->serializedTreeItem = tree.getChild(0).createCopy();
+    this->serializedTreeItem = ColumnarSerializer::expandNoteColumns(tree.getChild(0));
 }
 
 void PianoTrackRemoveAction::reset()
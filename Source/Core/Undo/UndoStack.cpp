@@ -19,6 +19,7 @@
 #include "UndoStack.h"
 #include "UndoAction.h"
 #include "SerializationKeys.h"
+#include "DocumentHelpers.h"
 #include "ProjectNode.h"
 
 #include "MidiTrackActions.h"
@@ -39,6 +40,7 @@ UndoStack::ActionSet::ActionSet(ProjectNode &project, const String &transactionN
     
 bool UndoStack::ActionSet::perform() const
 {
+    this->snapshotState = {};
     for (int i = 0; i < this->actions.size(); ++i)
     {
         if (!this->actions.getUnchecked(i)->perform())
@@ -52,6 +54,7 @@ bool UndoStack::ActionSet::perform() const
     
 bool UndoStack::ActionSet::undo() const
 {
+    this->snapshotState = {};
     for (int i = this->actions.size(); --i >= 0;)
     {
         if (!this->actions.getUnchecked(i)->undo())
@@ -76,13 +79,25 @@ int UndoStack::ActionSet::getTotalSize() const
     
 ValueTree UndoStack::ActionSet::serialize() const
 {
+    const bool isSnapshot = DocumentHelpers::SnapshotScope::isActive();
+    if (isSnapshot && this->snapshotState.isValid())
+    {
+        return DocumentHelpers::createSnapshotReference(this->snapshotState);
+    }
+
     ValueTree tree(Serialization::Undo::transaction);
 
     for (int i = 0; i < this->actions.size(); ++i)
     {
         tree.appendChild(this->actions.getUnchecked(i)->serialize(), nullptr);
     }
-        
+
+    if (isSnapshot)
+    {
+        this->snapshotState = tree;
+        return DocumentHelpers::createSnapshotReference(this->snapshotState);
+    }
+
     return tree;
 }
     
@@ -102,6 +117,7 @@ void UndoStack::ActionSet::deserialize(const ValueTree &tree)
     
 void UndoStack::ActionSet::reset()
 {
+    this->snapshotState = {};
     this->actions.clear();
 }
 
@@ -219,6 +235,7 @@ bool UndoStack::perform(UndoAction *const newAction)
                             action.reset(coalescedAction);
                             this->totalUnitsStored -= lastAction->getSizeInUnits();
                             actionSet->actions.remove(i);
+                            actionSet->snapshotState = {};
                             break;
                         }
                     }
@@ -233,6 +250,7 @@ bool UndoStack::perform(UndoAction *const newAction)
             
             this->totalUnitsStored += action->getSizeInUnits();
             actionSet->actions.add(action.release());
+            actionSet->snapshotState = {};
             this->newTransaction = false;
             
             this->clearFutureTransactions();
@@ -89,6 +89,11 @@ private:
         String name;
 
         ProjectNode &project;
+
+        // the snapshots only serialize the transactions changed since the last one,
+        // so this is reset whenever the actions are changed, or performed, or undone,
+        // see DocumentHelpers::SnapshotScope
+        mutable ValueTree snapshotState;
     };
     
     OwnedArray<ActionSet> transactions;
@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "RevisionItem.h"
 #include "DiffLogic.h"
+#include "DocumentHelpers.h"
 
 namespace VCS
 {
@@ -101,6 +102,23 @@ DiffLogic *RevisionItem::getDiffLogic() const noexcept
 //===----------------------------------------------------------------------===//
 
 ValueTree RevisionItem::serialize() const
+{
+    if (DocumentHelpers::SnapshotScope::isActive())
+    {
+        // the cached tree shares nothing with the model,
+        // so that the writer thread could read it at any time
+        if (!this->snapshotState.isValid())
+        {
+            this->snapshotState = this->serializeItem(true);
+        }
+
+        return DocumentHelpers::createSnapshotReference(this->snapshotState);
+    }
+
+    return this->serializeItem(false);
+}
+
+ValueTree RevisionItem::serializeItem(bool copyAllData) const
 {
     ValueTree tree(Serialization::VCS::revisionItem);
 
@@ -118,7 +136,8 @@ ValueTree RevisionItem::serialize() const
 
         // sometimes we need to create copy since value trees cannot be shared between two parents
         // but Snapshot seems to share revision items on checkout; need to fix this someday:
-        deltaNode.appendChild(deltaData.getParent().isValid() ? deltaData.createCopy() : deltaData, nullptr);
+        const bool shouldCopy = copyAllData || deltaData.getParent().isValid();
+        deltaNode.appendChild(shouldCopy ? deltaData.createCopy() : deltaData, nullptr);
         tree.appendChild(deltaNode, nullptr);
     }
 
@@ -181,6 +200,7 @@ void RevisionItem::deserialize(const ValueTree &tree, const DeltaDataLookup &dat
 
 void RevisionItem::reset()
 {
+    this->snapshotState = {};
     this->deltas.clear();
     this->description.clear();
     this->vcsItemType = Type::Undefined;
@@ -66,10 +66,16 @@ namespace VCS
 
     private:
 
+        ValueTree serializeItem(bool copyAllData) const;
+
         OwnedArray<Delta> deltas;
         Array<ValueTree> deltasData;
         UniquePointer<DiffLogic> logic;
 
+        // the item never changes, so it's only serialized once for all snapshots,
+        // see DocumentHelpers::SnapshotScope
+        mutable ValueTree snapshotState;
+
         Type vcsItemType;
         String description;
 
@@ -108,6 +108,8 @@ int CommandIDs::getIdForName(const String &command)
         CASE_FOR(CreateNewProject)
         CASE_FOR(RenderToFLAC)
         CASE_FOR(RenderToWAV)
+        CASE_FOR(RenderStemsToFLAC)
+        CASE_FOR(RenderStemsToWAV)
         CASE_FOR(AddItemsMenu)
         CASE_FOR(AddItemsMenuBack)
         CASE_FOR(AddMidiTrack)
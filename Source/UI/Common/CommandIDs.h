@@ -132,6 +132,8 @@ namespace CommandIDs
         // ProjectMenu
         RenderToFLAC                    = 0x2030,
         RenderToWAV                     = 0x2031,
+        RenderStemsToFLAC               = 0x2032,
+        RenderStemsToWAV                = 0x2033,
 
         AddItemsMenu                    = 0x2040,
         AddItemsMenuBack                = 0x2041,
@@ -28,12 +28,22 @@
 #include "PlayerThread.h"
 #include "ProgressIndicator.h"
 #include "MenuItemComponent.h"
+#include "RendererThread.h"
 #include "CommandIDs.h"
+#include "Config.h"
+
+static const int renderDialogBitDepths[] = { 16, 24, 32 };
+static const int renderDialogBlockSizes[] = { 256, 512, 1024, 2048, 4096 };
+
+#define RENDER_DIALOG_BIT_DEPTH_GROUP 1
+#define RENDER_DIALOG_BLOCK_SIZE_GROUP 2
 //[/MiscUserDefs]
 
-RenderDialog::RenderDialog(ProjectNode &parentProject, const File &renderTo, const String &formatExtension)
+RenderDialog::RenderDialog(ProjectNode &parentProject, const File &renderTo,
+    const String &formatExtension, bool renderStems)
     : project(parentProject),
       extension(formatExtension.toLowerCase()),
+      renderStems(renderStems),
       shouldRenderAfterDialogCompletes(false)
 {
     this->background.reset(new DialogPanel());
@@ -111,9 +121,11 @@ RenderDialog::RenderDialog(ProjectNode &parentProject, const File &renderTo, con
 #if JUCE_MAC
     this->filenameEditor->setEditable(false);
 #endif
+
+    this->initRenderOptions();
     //[/UserPreSize]
 
-    this->setSize(520, 224);
+    this->setSize(520, 296);
 
     //[Constructor]
     this->updatePosition();
@@ -123,6 +135,10 @@ RenderDialog::RenderDialog(ProjectNode &parentProject, const File &renderTo, con
 RenderDialog::~RenderDialog()
 {
     //[Destructor_pre]
+    this->bitDepthButtons.clear();
+    this->blockSizeButtons.clear();
+    this->doublePrecisionButton = nullptr;
+    this->blockSizeLabel = nullptr;
     //[/Destructor_pre]
 
     background = nullptr;
@@ -175,6 +191,25 @@ void RenderDialog::resized()
     pathEditor->setBounds((getWidth() / 2) + 25 - (406 / 2), 4 + 48, 406, 24);
     separatorH->setBounds(4, getHeight() - 52 - 2, getWidth() - 8, 2);
     //[UserResized] Add your own custom resize handling here..
+    const int optionsWidth = 456;
+    const int bitDepthRowY = 164;
+    const int blockSizeRowY = 204;
+
+    Rectangle<int> bitDepthRow((getWidth() - optionsWidth) / 2, bitDepthRowY, optionsWidth, 32);
+    const int bitDepthButtonWidth = optionsWidth / (this->bitDepthButtons.size() + 1);
+    for (auto *button : this->bitDepthButtons)
+    {
+        button->setBounds(bitDepthRow.removeFromLeft(bitDepthButtonWidth));
+    }
+    this->doublePrecisionButton->setBounds(bitDepthRow);
+
+    Rectangle<int> blockSizeRow((getWidth() - optionsWidth) / 2, blockSizeRowY, optionsWidth, 32);
+    this->blockSizeLabel->setBounds(blockSizeRow.removeFromLeft(bitDepthButtonWidth));
+    const int blockSizeButtonWidth = blockSizeRow.getWidth() / this->blockSizeButtons.size();
+    for (auto *button : this->blockSizeButtons)
+    {
+        button->setBounds(blockSizeRow.removeFromLeft(blockSizeButtonWidth));
+    }
     //[/UserResized]
 }
 
@@ -198,6 +233,13 @@ void RenderDialog::buttonClicked(Button* buttonThatWasClicked)
     }
 
     //[UserbuttonClicked_Post]
+    auto *toggleButton = dynamic_cast<ToggleButton *>(buttonThatWasClicked);
+    if (toggleButton == this->doublePrecisionButton.get() ||
+        this->bitDepthButtons.contains(toggleButton) ||
+        this->blockSizeButtons.contains(toggleButton))
+    {
+        this->saveRenderOptions();
+    }
     //[/UserbuttonClicked_Post]
 }
 
@@ -302,8 +344,15 @@ void RenderDialog::startOrAbortRender()
 
     if (! transport.isRendering())
     {
-        transport.startRender(this->getFileName());
-        this->startTrackingProgress();
+        if (transport.startRender(this->getFileName(), this->renderStems))
+        {
+            this->startTrackingProgress();
+        }
+        else
+        {
+            App::Layout().showTooltip(TRANS(I18n::Dialog::renderFailed),
+                MainLayout::TooltipType::Failure);
+        }
     }
     else
     {
@@ -324,6 +373,83 @@ void RenderDialog::stopRender()
     }
 }
 
+void RenderDialog::initRenderOptions()
+{
+    const int bitDepth = RendererThread::Options::getSupportedBitDepth(
+        App::Config().getProperty(Serialization::Config::renderBitDepth,
+            String(RendererThread::Options().bitDepth)).getIntValue());
+
+    const int blockSize = App::Config().getProperty(Serialization::Config::renderBlockSize,
+        String(RendererThread::Options().blockSize)).getIntValue();
+
+    const bool doublePrecision = App::Config().getProperty(Serialization::Config::renderDoublePrecision,
+        Serialization::Config::disabledState.toString()) == Serialization::Config::enabledState.toString();
+
+    // flac has no float samples, so the renderer would write 24 bits anyway
+    const bool canWriteFloat = this->extension != "flac";
+    const int shownBitDepth = canWriteFloat ? bitDepth : jmin(bitDepth, 24);
+
+    StringArray bitDepthNames;
+    bitDepthNames.add(TRANS(I18n::Dialog::renderBitDepth16));
+    bitDepthNames.add(TRANS(I18n::Dialog::renderBitDepth24));
+    bitDepthNames.add(TRANS(I18n::Dialog::renderBitDepth32));
+
+    for (int i = 0; i < numElementsInArray(renderDialogBitDepths); ++i)
+    {
+        auto *button = this->bitDepthButtons.add(new ToggleButton(bitDepthNames[i]));
+        button->setRadioGroupId(RENDER_DIALOG_BIT_DEPTH_GROUP);
+        button->setToggleState(renderDialogBitDepths[i] == shownBitDepth, dontSendNotification);
+        button->setEnabled(canWriteFloat || renderDialogBitDepths[i] <= 24);
+        button->addListener(this);
+        this->addAndMakeVisible(button);
+    }
+
+    this->doublePrecisionButton.reset(new ToggleButton(TRANS(I18n::Dialog::renderDoublePrecision)));
+    this->doublePrecisionButton->setToggleState(doublePrecision, dontSendNotification);
+    this->doublePrecisionButton->addListener(this);
+    this->addAndMakeVisible(this->doublePrecisionButton.get());
+
+    this->blockSizeLabel.reset(new Label(String(), TRANS(I18n::Dialog::renderBlockSize)));
+    this->blockSizeLabel->setJustificationType(Justification::centredLeft);
+    this->addAndMakeVisible(this->blockSizeLabel.get());
+
+    // a custom block size from the config is kept until another one is picked
+    for (const int size : renderDialogBlockSizes)
+    {
+        auto *button = this->blockSizeButtons.add(new ToggleButton(String(size)));
+        button->setRadioGroupId(RENDER_DIALOG_BLOCK_SIZE_GROUP);
+        button->setToggleState(size == blockSize, dontSendNotification);
+        button->addListener(this);
+        this->addAndMakeVisible(button);
+    }
+}
+
+void RenderDialog::saveRenderOptions()
+{
+    for (int i = 0; i < this->bitDepthButtons.size(); ++i)
+    {
+        if (this->bitDepthButtons.getUnchecked(i)->getToggleState())
+        {
+            App::Config().setProperty(Serialization::Config::renderBitDepth,
+                renderDialogBitDepths[i]);
+        }
+    }
+
+    for (int i = 0; i < this->blockSizeButtons.size(); ++i)
+    {
+        if (this->blockSizeButtons.getUnchecked(i)->getToggleState())
+        {
+            App::Config().setProperty(Serialization::Config::renderBlockSize,
+                renderDialogBlockSizes[i]);
+        }
+    }
+
+    App::Config().setProperty(Serialization::Config::renderDoublePrecision,
+        this->doublePrecisionButton->getToggleState() ?
+            Serialization::Config::enabledState.toString() :
+            Serialization::Config::disabledState.toString());
+}
+
 String RenderDialog::getFileName() const
 {
     const String safeRenderName = File::createLegalFileName(this->filenameEditor->getText(true));
@@ -344,7 +470,12 @@ void RenderDialog::timerCallback()
     {
         this->stopTrackingProgress();
         transport.stopRender();
-        App::Layout().showTooltip({}, MainLayout::TooltipType::Success);
+
+        const auto loudness = transport.getRenderLoudnessReport();
+        const String loudnessSummary = String(loudness.integratedLoudness, 1) + " LUFS, " +
+            String(loudness.truePeakDecibels, 1) + " dBTP";
+
+        App::Layout().showTooltip(loudnessSummary, MainLayout::TooltipType::Success);
     }
 }
 
@@ -377,10 +508,10 @@ BEGIN_JUCER_METADATA
 
 <JUCER_COMPONENT documentType="Component" className="RenderDialog" template="../../Template"
                  componentName="" parentClasses="public FadingDialog, private Timer"
-                 constructorParams="ProjectNode &amp;parentProject, const File &amp;renderTo, const String &amp;formatExtension"
-                 variableInitialisers="project(parentProject),&#10;extension(formatExtension.toLowerCase()),&#10;shouldRenderAfterDialogCompletes(false)"
+                 constructorParams="ProjectNode &amp;parentProject, const File &amp;renderTo,&#10;const String &amp;formatExtension, bool renderStems = false"
+                 variableInitialisers="project(parentProject),&#10;extension(formatExtension.toLowerCase()),&#10;renderStems(renderStems),&#10;shouldRenderAfterDialogCompletes(false)"
                  snapPixels="8" snapActive="1" snapShown="1" overlayOpacity="0.330"
-                 fixedSize="1" initialWidth="520" initialHeight="224">
+                 fixedSize="1" initialWidth="520" initialHeight="296">
   <METHODS>
     <METHOD name="parentHierarchyChanged()"/>
     <METHOD name="parentSizeChanged()"/>
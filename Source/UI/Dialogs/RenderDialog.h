@@ -38,7 +38,8 @@ class RenderDialog final : public FadingDialog,
 {
 public:
 
-    RenderDialog(ProjectNode &parentProject, const File &renderTo, const String &formatExtension);
+    RenderDialog(ProjectNode &parentProject, const File &renderTo,
+        const String &formatExtension, bool renderStems = false);
     ~RenderDialog();
 
     //[UserMethods]
@@ -71,11 +72,21 @@ private:
     ProjectNode &project;
 
     String extension;
+    const bool renderStems;
     bool shouldRenderAfterDialogCompletes;
 
     void startOrAbortRender();
     void stopRender();
 
+    // render options, stored in the config and read by the transport
+    OwnedArray<ToggleButton> bitDepthButtons;
+    OwnedArray<ToggleButton> blockSizeButtons;
+    UniquePointer<ToggleButton> doublePrecisionButton;
+    UniquePointer<Label> blockSizeLabel;
+
+    void initRenderOptions();
+    void saveRenderOptions();
+
     //[/UserVariables]
 
     UniquePointer<DialogPanel> background;
@@ -56,6 +56,15 @@ MenuPanel::Menu InstrumentMenu::createDefaultMenu()
             App::Layout().showModalDialog(dialog.release());
         }));
 
+    const bool canSleep = this->instrumentNode.getInstrument()->canSleepWhenSilent();
+    menu.add(MenuItem::item(canSleep ? Icons::apply : Icons::instrument,
+        TRANS(I18n::Menu::instrumentSleepWhenSilent))->
+        withAction([this, canSleep]()
+        {
+            this->instrumentNode.getInstrument()->setCanSleepWhenSilent(!canSleep);
+            this->updateContent(this->createDefaultMenu(), MenuPanel::Fading);
+        }));
+
     // TODO:
     //menu.add(MenuItem::item(Icons::icon, TRANS(I18n::Menu::instrument::seticon)));
     //menu.add(MenuItem::item(Icons::colour, TRANS(I18n::Menu::instrument::setcolour)));
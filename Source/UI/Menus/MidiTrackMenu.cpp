@@ -38,6 +38,7 @@
 #include "AutomationTrackActions.h"
 #include "UndoStack.h"
 #include "Workspace.h"
+#include "Transport.h"
 
 MidiTrackMenu::MidiTrackMenu(MidiTrackNode &node) :
     trackNode(node)
@@ -64,6 +65,28 @@ void MidiTrackMenu::initDefaultMenu()
         }));
     }
     
+    auto *project = this->trackNode.getProject();
+    if (project != nullptr && dynamic_cast<PianoTrackNode *>(&this->trackNode) != nullptr)
+    {
+        auto &transport = project->getTransport();
+        if (transport.isTrackFrozen(&this->trackNode))
+        {
+            menu.add(MenuItem::item(Icons::render, TRANS(I18n::Menu::trackUnfreeze))->
+                closesMenu()->withAction([this, project]()
+            {
+                project->getTransport().unfreezeTrack(&this->trackNode);
+            }));
+        }
+        else
+        {
+            menu.add(MenuItem::item(Icons::render, TRANS(I18n::Menu::trackFreeze))->
+                disabledIf(transport.isRendering())->closesMenu()->withAction([this, project]()
+            {
+                project->getTransport().freezeTrack(&this->trackNode);
+            }));
+        }
+    }
+
     menu.add(MenuItem::item(Icons::ellipsis, CommandIDs::RenameTrack,
         TRANS(I18n::Menu::trackRename))->closesMenu());
         
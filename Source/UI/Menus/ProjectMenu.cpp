@@ -321,6 +321,12 @@ void ProjectMenu::showRenderMenu()
     menu.add(MenuItem::item(Icons::render, CommandIDs::RenderToFLAC,
         TRANS(I18n::Menu::Project::renderFlac))->disabledIf(noRender)->closesMenu());
 
+    menu.add(MenuItem::item(Icons::render, CommandIDs::RenderStemsToWAV,
+        TRANS(I18n::Menu::Project::renderStemsWav))->disabledIf(noRender)->closesMenu());
+
+    menu.add(MenuItem::item(Icons::render, CommandIDs::RenderStemsToFLAC,
+        TRANS(I18n::Menu::Project::renderStemsFlac))->disabledIf(noRender)->closesMenu());
+
     menu.add(MenuItem::item(Icons::commit, CommandIDs::ExportMidi,
         TRANS(I18n::Menu::Project::renderMidi))->closesMenu());
 
@@ -80,22 +80,34 @@ AudioSettings::AudioSettings(AudioCore &core)
     bufferSizeEditor->setPopupMenuEnabled (false);
     bufferSizeEditor->setText (String());
 
+    this->loadEditor.reset(new TextEditor(String()));
+    this->addAndMakeVisible(loadEditor.get());
+    loadEditor->setMultiLine (false);
+    loadEditor->setReturnKeyStartsNewLine (false);
+    loadEditor->setReadOnly (true);
+    loadEditor->setScrollbarsShown (false);
+    loadEditor->setCaretVisible (false);
+    loadEditor->setPopupMenuEnabled (false);
+    loadEditor->setText (String());
+
 
     //[UserPreSize]
     //[/UserPreSize]
 
-    this->setSize(550, 200);
+    this->setSize(550, 248);
 
     //[Constructor]
     this->deviceTypeEditor->setFont(18.f);
     this->deviceEditor->setFont(18.f);
     this->sampleRateEditor->setFont(18.f);
     this->bufferSizeEditor->setFont(18.f);
+    this->loadEditor->setFont(18.f);
 
     this->deviceTypeEditor->setInterceptsMouseClicks(false, true);
     this->deviceEditor->setInterceptsMouseClicks(false, true);
     this->sampleRateEditor->setInterceptsMouseClicks(false, true);
     this->bufferSizeEditor->setInterceptsMouseClicks(false, true);
+    this->loadEditor->setInterceptsMouseClicks(false, true);
 
     MenuPanel::Menu emptyMenu;
     this->deviceTypeComboPrimer->initWith(this->deviceTypeEditor.get(), emptyMenu);
@@ -118,6 +130,7 @@ AudioSettings::~AudioSettings()
     deviceEditor = nullptr;
     sampleRateEditor = nullptr;
     bufferSizeEditor = nullptr;
+    loadEditor = nullptr;
 
     //[Destructor]
     //[/Destructor]
@@ -149,6 +162,7 @@ void AudioSettings::resized()
     deviceEditor->setBounds(16, 60, getWidth() - 32, 32);
     sampleRateEditor->setBounds(16, 108, getWidth() - 32, 32);
     bufferSizeEditor->setBounds(16, 156, getWidth() - 32, 32);
+    loadEditor->setBounds(16, 204, getWidth() - 32, 32);
     //[UserResized] Add your own custom resize handling here..
     //[/UserResized]
 }
@@ -164,6 +178,13 @@ void AudioSettings::visibilityChanged()
         this->syncDevicesList(deviceManager);
         this->syncSampleRatesList(deviceManager);
         this->syncBufferSizesList(deviceManager);
+
+        this->timerCallback();
+        this->startTimer(1000);
+    }
+    else
+    {
+        this->stopTimer();
     }
     //[/UserCode_visibilityChanged]
 }
@@ -371,6 +392,20 @@ void AudioSettings::syncBufferSizesList(AudioDeviceManager &deviceManager)
     this->bufferSizeComboPrimer->updateMenu(menu);
 }
 
+void AudioSettings::timerCallback()
+{
+    // the mean and the max share of the block duration it takes to process all instruments,
+    // and the device's xruns, or the blocks processed for too long, if it doesn't report them
+    const auto load = this->audioCore.getLoadSummary();
+    const int numXRuns = this->audioCore.getNumXRuns();
+    const int64 numDropouts = numXRuns >= 0 ? int64(numXRuns) : load.numOverruns;
+
+    this->loadEditor->setText(TRANS(I18n::Settings::audioLoad) + ": " +
+        String(roundToInt(load.meanLoad * 100.f)) + "% - " +
+        String(roundToInt(load.maxLoad * 100.f)) + "%, " +
+        TRANS(I18n::Settings::audioDropouts) + ": " + String(numDropouts), dontSendNotification);
+}
+
 //[/MiscUserCode]
 
 #if 0
@@ -378,10 +413,10 @@ void AudioSettings::syncBufferSizesList(AudioDeviceManager &deviceManager)
 BEGIN_JUCER_METADATA
 
 <JUCER_COMPONENT documentType="Component" className="AudioSettings" template="../../../Template"
-                 componentName="" parentClasses="public Component" constructorParams="AudioCore &amp;core"
+                 componentName="" parentClasses="public Component, private Timer" constructorParams="AudioCore &amp;core"
                  variableInitialisers="audioCore(core)" snapPixels="8" snapActive="1"
                  snapShown="1" overlayOpacity="0.330" fixedSize="1" initialWidth="550"
-                 initialHeight="200">
+                 initialHeight="248">
   <METHODS>
     <METHOD name="visibilityChanged()"/>
     <METHOD name="handleCommandMessage (int commandId)"/>
@@ -411,6 +446,9 @@ BEGIN_JUCER_METADATA
   <TEXTEDITOR name="" id="42608864c0766e06" memberName="bufferSizeEditor" virtualName=""
               explicitFocusOrder="0" pos="16 156 32M 32" initialText="" multiline="0"
               retKeyStartsLine="0" readonly="1" scrollbars="0" caret="0" popupmenu="0"/>
+  <TEXTEDITOR name="" id="e3b9c2a7d4f01865" memberName="loadEditor" virtualName=""
+              explicitFocusOrder="0" pos="16 204 32M 32" initialText="" multiline="0"
+              retKeyStartsLine="0" readonly="1" scrollbars="0" caret="0" popupmenu="0"/>
 </JUCER_COMPONENT>
 
 END_JUCER_METADATA
@@ -23,7 +23,8 @@ class AudioCore;
 //[/Headers]
 
 
-class AudioSettings final : public Component
+class AudioSettings final : public Component,
+                            private Timer
 {
 public:
 
@@ -52,6 +53,9 @@ private:
     void syncSampleRatesList(AudioDeviceManager &deviceManager);
     void syncBufferSizesList(AudioDeviceManager &deviceManager);
 
+    // refreshes the load statistics while visible
+    void timerCallback() override;
+
     AudioCore &audioCore;
     //[/UserVariables]
 
@@ -63,6 +67,7 @@ private:
     UniquePointer<TextEditor> deviceEditor;
     UniquePointer<TextEditor> sampleRateEditor;
     UniquePointer<TextEditor> bufferSizeEditor;
+    UniquePointer<TextEditor> loadEditor;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSettings)
 };
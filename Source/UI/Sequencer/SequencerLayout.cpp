@@ -566,7 +566,7 @@ void SequencerLayout::resized()
 }
 
 
-void SequencerLayout::proceedToRenderDialog(const String &extension)
+void SequencerLayout::proceedToRenderDialog(const String &extension, bool renderStems)
 {
     const File initialPath = File::getSpecialLocation(File::userMusicDirectory);
     const String renderFileName = this->project.getName() + "." + extension.toLowerCase();
@@ -578,10 +578,10 @@ void SequencerLayout::proceedToRenderDialog(const String &extension)
 
     if (fc.browseForFileToSave(true))
     {
-        App::Layout().showModalDialog(new RenderDialog(this->project, fc.getResult(), extension));
+        App::Layout().showModalDialog(new RenderDialog(this->project, fc.getResult(), extension, renderStems));
     }
 #else
-    App::Layout().showModalDialog(new RenderDialog(this->project, initialPath.getChildFile(safeRenderName), extension));
+    App::Layout().showModalDialog(new RenderDialog(this->project, initialPath.getChildFile(safeRenderName), extension, renderStems));
 #endif
     }
 
@@ -611,6 +611,14 @@ void SequencerLayout::handleCommandMessage(int commandId)
     case CommandIDs::RenderToWAV:
         this->proceedToRenderDialog("WAV");
         return;
+
+    case CommandIDs::RenderStemsToFLAC:
+        this->proceedToRenderDialog("FLAC", true);
+        return;
+
+    case CommandIDs::RenderStemsToWAV:
+        this->proceedToRenderDialog("WAV", true);
+        return;
     case CommandIDs::SwitchBetweenRolls:
         if (!this->rollContainer->canAnimate(RollsSwitchingProxy::rolls))
         {
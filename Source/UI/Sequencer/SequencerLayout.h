@@ -78,7 +78,7 @@ public:
 
 private:
 
-    void proceedToRenderDialog(const String &extension);
+    void proceedToRenderDialog(const String &extension, bool renderStems = false);
 
 private:
 